@@ -8,15 +8,43 @@
 //   It can:
 //     * Add courses with names and credit hours
 //     * Add assignments to courses with earned and maximum points
+//     * Group assignments into weighted grading categories, with
+//       drop-lowest rules and extra credit
 //     * Compute each course's percentage and letter grade
 //     * Compute overall GPA on a 4.0 scale using course grades and credit hours
 //     * Run a "what-if" scenario for a hypothetical assignment
+//     * Forecast final grades and GPA from the work still pending, by
+//       simulating the rest of the term (see "GRADE FORECAST" below)
 //     * Edit course information and assignment scores
 //     * Delete courses and assignments
-//     * Show a grade distribution report (how many A/B/C/D/F)
+//     * Undo and redo changes, many steps deep (see "UNDO / REDO" below)
+//     * Show a grade distribution report (how many A/B/C/D/F), for one
+//       student or for a whole cohort grouped by course, department or term
+//       (see "COHORT GRADE DISTRIBUTION" below)
+//     * List the courses that currently have a grade, or a worse one, from
+//       an index kept up to date on every change (see "GRADE INDEX" below)
+//     * Use a plus/minus, pass/fail or custom grading scale ("--scale")
+//     * Grade with whole-number scores that give the same results on every
+//       machine and thread count ("--fixed-point", see "FIXED-POINT SCORES")
+//     * Export courses and assignments as columnar record batches for
+//       analytics tools, and import them back (see "COLUMNAR EXPORT" below)
+//     * Process a large CSV/TSV file of student records without any menus
+//       (batch mode, see "BATCH MODE" below)
+//     * Write a text or JSON transcript for every student of such a file,
+//       on all CPU cores (see "TRANSCRIPTS" below)
+//     * Rank a whole class by GPA: class rank, percentile, top students,
+//       honors and probation lists (see "CLASS RANK" below)
+//     * Count and time its own core operations ("--metrics", see
+//       "METRICS" below)
+//     * Answer one command per line from another program (script mode,
+//       see "SCRIPT MODE" below)
+//     * Stay running and answer those commands for local programs over a
+//       Unix domain socket (daemon mode, see "DAEMON MODE" below)
 //
 //   The program uses a simple text menu in the console so the user can
-//   choose what they want to do.
+//   choose what they want to do. Running it as
+//       ./gpa_calculator --batch [file]
+//   skips the menu and streams results for every student instead.
 // ============================================================================
 
 #include <iostream>   // for input and output (std::cout, std::cin)
@@ -24,30 +52,1094 @@
 #include <vector>     // for std::vector to store many courses/assignments
 #include <limits>     // for std::numeric_limits (used when clearing input)
 #include <iomanip>    // for std::setprecision and std::fixed when printing
+#include <fstream>    // for std::ifstream (reading batch input files)
+#include <sstream>    // for std::istringstream (reading grading scale files)
+#include <cstdio>     // for std::snprintf (formatting numbers in batch output)
+#include <cstdlib>    // for std::strtod (parsing numbers in batch input)
+#include <cmath>      // for std::nextafter (used by the grade solver)
+#include <cstring>    // for std::strcmp (checking command-line options)
+#include <cctype>     // for std::tolower (filtering report rows)
+#include <climits>    // for INT_MIN / INT_MAX (script mode numbers)
+#include <cerrno>     // for errno (socket calls in daemon mode)
+#include <cstdint>    // for fixed-size integers (uint32_t) used in handles
+#include <utility>    // for std::move
+#include <new>        // for std::bad_alloc (aligned score columns)
+#include <chrono>     // for timing journal group commits
+#include <thread>     // for std::thread (parallel cohort GPA)
+#include <mutex>      // for std::mutex
+#include <condition_variable> // for the transcript pipeline's queues
+#include <atomic>     // for std::atomic
+#include <deque>      // for std::deque (work-stealing queues)
+#include <functional> // for std::function
+#include <random>     // for seeded synthetic data in benchmarks
+#include <algorithm>  // for std::shuffle
+#include <set>        // for std::multiset (drop-lowest scores)
+#include <unordered_map> // for per-thread group tables (cohort distribution)
+#include <unordered_set> // for student ids already read in batch input
+
+// Memory-mapped files for snapshots (POSIX systems only; other systems read
+// the file into memory instead).
+#if defined(__unix__) || defined(__APPLE__)
+#define GPA_HAVE_MMAP 1
+#include <fcntl.h>     // for open
+#include <sys/mman.h>  // for mmap / munmap
+#include <sys/stat.h>  // for fstat
+#include <unistd.h>    // for close, fsync, truncate
+#endif
+
+// Unix domain sockets for daemon mode. The server also needs epoll, which
+// only Linux has; the client works on any of these systems.
+#if defined(__unix__) || defined(__APPLE__)
+#define GPA_HAVE_UNIX_SOCKETS 1
+#include <sys/socket.h> // for socket, bind, accept, send
+#include <sys/un.h>     // for sockaddr_un
+#include <signal.h>     // for signal (stopping the server)
+#endif
+#if defined(__linux__)
+#define GPA_HAVE_EPOLL 1
+#include <sys/epoll.h>  // for epoll_create1, epoll_wait
+#endif
+
+// Operation counters and latency histograms (see "METRICS"). Building with
+// -DGPA_NO_METRICS leaves every timer out of the program.
+#if !defined(GPA_NO_METRICS)
+#define GPA_HAVE_METRICS 1
+#endif
+
+// SIMD instructions for the score kernels. The compiler tells us which ones
+// this build may use (for example g++ -mavx2 or -march=native turns on AVX).
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 
 // ============================================================================
 // DATA STRUCTURES
 // ============================================================================
+
+// A course or assignment name stored in the name pool (see "NAME POOL").
+// The same names repeat across many records ("Exam 1", "COSC 3345"), so
+// each distinct name is stored only once and a record just holds its 4-byte
+// id. Copies share the stored text; it is freed when the last copy goes
+// away. Two PooledNames are equal exactly when their ids are.
+class PooledName {
+public:
+    PooledName() : id(0) {}
+    PooledName(const string& text);
+    PooledName(const char* text);
+    PooledName(const char* text, size_t length);
+    PooledName(const PooledName& other);
+    PooledName(PooledName&& other) noexcept : id(other.id) { other.id = 0; }
+    PooledName& operator=(const PooledName& other);
+    PooledName& operator=(PooledName&& other) noexcept;
+    ~PooledName();
+
+    uint32_t poolId() const { return id; }  // 0 is the empty name
+    const char* c_str() const;
+    size_t size() const;
+    bool empty() const { return id == 0; }
+    char operator[](size_t i) const { return c_str()[i]; }
+    string str() const { return string(c_str(), size()); }
+
+private:
+    uint32_t id;
+};
+
+inline bool operator==(const PooledName& a, const PooledName& b) {
+    return a.poolId() == b.poolId();
+}
+inline bool operator!=(const PooledName& a, const PooledName& b) {
+    return a.poolId() != b.poolId();
+}
+bool operator==(const PooledName& a, const string& b);
+ostream& operator<<(ostream& out, const PooledName& name);
+
+// Stores each distinct name once. Text lives in large arena chunks and the
+// entries in fixed pages, so neither ever moves: reading a name you hold
+// needs no lock, even while other threads add names. Adding a name and
+// dropping the last reference to one take a mutex.
+class NamePool {
+public:
+    NamePool();
+    ~NamePool();
+
+    // Id for "text" with one more reference, adding the text if it is new.
+    uint32_t intern(const char* text, size_t length);
+
+    // Looks a name up without adding it. Returns false if it is not stored.
+    bool find(const char* text, size_t length, uint32_t& id) const;
+
+    void retain(uint32_t id);
+    void release(uint32_t id);
+
+    const char* text(uint32_t id) const { return entry(id).text; }
+    size_t length(uint32_t id) const { return entry(id).length; }
+
+    size_t nameCount() const;   // distinct names stored right now
+    size_t arenaBytes() const;  // bytes reserved for name text
+
+private:
+    NamePool(const NamePool&);             // not copyable
+    NamePool& operator=(const NamePool&);
+
+    struct Entry {
+        const char* text;      // NUL-terminated, inside the arena
+        uint32_t length;
+        uint32_t hash;
+        atomic<uint32_t> refs;
+    };
+
+    static const unsigned PAGE_BITS = 12;
+    static const uint32_t PAGE_SIZE = 1u << PAGE_BITS;
+    static const uint32_t MAX_PAGES = 1u << 16;  // up to 2^28 names
+    static const size_t CHUNK_BYTES = 64 * 1024;
+    static const size_t SMALL_TEXT_BYTES = 256;  // bigger texts get their own block
+
+    Entry& entry(uint32_t id) const {
+        return pages[id >> PAGE_BITS][id & (PAGE_SIZE - 1)];
+    }
+    uint32_t newEntryId();
+    char* allocateText(size_t bytes);
+    void freeText(const char* text, size_t bytes);
+    size_t findSlot(const char* text, size_t length, uint32_t hash) const;
+    void removeSlot(uint32_t id);
+    void growSlots();
+
+    mutable mutex lock;
+    Entry** pages;                 // MAX_PAGES page pointers
+    uint32_t nextId;               // first never-used id
+    vector<uint32_t> freeIds;      // ids of freed entries, reused first
+    vector<uint32_t> slots;        // hash table of ids (0 = empty slot)
+    size_t liveNames;
+    vector<char*> chunks;          // arena chunks (and big text blocks)
+    char* chunkPos;
+    size_t chunkLeft;
+    size_t reservedBytes;
+    vector<char*> freeBlocks[SMALL_TEXT_BYTES / 8];  // freed text by size
+};
+
+NamePool& namePool();
+
 //2
 // Each assignment belongs to a single course.
 // For example: "Homework 1", 85 points earned out of 100 possible.
 struct Assignment {
-    string name;      // a short name for the assignment (e.g., "Exam 1")
+    PooledName name;  // a short name for the assignment (e.g., "Exam 1")
     double earned;    // how many points the student scored on this assignment
     double max;       // the maximum possible points for this assignment
+    int category = 0;         // which grading category of the course it is in
+    bool extraCredit = false; // extra credit: adds to the category average
+                              // without counting as an assignment
+};
+
+// Score columns are aligned to 32 bytes, the width of one AVX register.
+const size_t SCORE_ALIGNMENT = 32;
+
+// Allocator that hands out SCORE_ALIGNMENT-aligned memory for std::vector.
+template <typename T>
+struct AlignedAllocator {
+    typedef T value_type;
+
+    AlignedAllocator() {}
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U>&) {}
+
+    T* allocate(size_t count) {
+        void* memory = nullptr;
+#if defined(_WIN32)
+        memory = _aligned_malloc(count * sizeof(T), SCORE_ALIGNMENT);
+#else
+        if (posix_memalign(&memory, SCORE_ALIGNMENT, count * sizeof(T)) != 0) {
+            memory = nullptr;
+        }
+#endif
+        if (memory == nullptr) {
+            throw bad_alloc();
+        }
+        return static_cast<T*>(memory);
+    }
+
+    void deallocate(T* memory, size_t) {
+#if defined(_WIN32)
+        _aligned_free(memory);
+#else
+        free(memory);
+#endif
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const AlignedAllocator<T>&, const AlignedAllocator<U>&) {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const AlignedAllocator<T>&, const AlignedAllocator<U>&) {
+    return false;
+}
+
+typedef vector<double, AlignedAllocator<double> > ScoreColumn;
+typedef vector<int64_t, AlignedAllocator<int64_t> > FixedColumn;
+
+// Units of fixed-point mode (see "FIXED-POINT SCORES"): points are counted
+// in thousandths, credit hours in halves and percentages in billionths of
+// a percent.
+const int64_t FIXED_POINTS_PER_POINT = 1000;
+const int64_t FIXED_UNITS_PER_PERCENT = 1000000000;
+
+// The assignments of one course, stored column by column ("structure of
+// arrays"). Names live in their own column, so loops over the scores only
+// read the tightly packed earned/max numbers and never touch the strings.
+// Row i of every column belongs to the same assignment.
+struct AssignmentColumns {
+    vector<PooledName> names;  // assignment names
+    ScoreColumn earned;     // points earned, one per assignment
+    ScoreColumn max;        // maximum points, one per assignment
+    vector<unsigned char> category;     // category index, one per assignment
+    vector<unsigned char> extraCredit;  // 1 for extra credit, else 0
+    FixedColumn percentUnits;  // earned / max in fixed-point units
+
+    size_t size() const { return earned.size(); }
+    bool empty() const { return earned.empty(); }
+
+    // Copy of one assignment (row) as a plain Assignment.
+    Assignment operator[](size_t index) const;
+
+    void push_back(const Assignment& a);
+    void insert(size_t index, const Assignment& a);
+    void set(size_t index, const Assignment& a);
+    void erase(size_t index);
+};
+
+// A running sum of non-negative numbers below 2^47 (percentages and
+// points), kept as a 128-bit integer count of 2^-80 steps. Every number
+// added is cut to a whole number of steps, so adding and subtracting are
+// exact: the sum, and the double read back from it, depend only on which
+// numbers are in it, never on the order they came and went in.
+struct ExactSum {
+    uint64_t high = 0;  // top 64 bits of the count
+    uint64_t low = 0;   // bottom 64 bits of the count
+
+    void add(double number);
+    void subtract(double number);
+    void clear() { high = 0; low = 0; }
+    double value() const;
+};
+
+// Limits for grading categories (also keep category indexes in one byte).
+const int MAX_CATEGORIES = 16;
+const int MAX_DROP_LOWEST = 50;
+
+// A grading category of a course, for example "Exams" worth 50% of the
+// course grade. The category average is the average percentage of its
+// assignments after dropping the lowest "dropLowest" of them (at least one
+// score is always kept). Extra-credit percentages are added on top of the
+// kept scores without counting as assignments, so they raise the average.
+//
+// The aggregates below are kept up to date as assignments come and go, so
+// a category average is read in constant time.
+struct Category {
+    string name = "General";
+    double weight = 100.0;   // share of the course grade; weights of the
+                             // graded categories are scaled to add up to 100%
+    int dropLowest = 0;      // how many of the lowest scores are ignored
+
+    int count = 0;                  // regular (not extra-credit) assignments
+    ExactSum sumPercentages;        // sum of their percentages
+    ExactSum extraPercentages;      // sum of extra-credit percentages
+
+    // Only used when dropLowest > 0: the lowest regular percentages (at
+    // most dropLowest of them), every other regular percentage, and the
+    // sum of "lowest". "rest" stays empty until "lowest" is full.
+    multiset<double> lowest;
+    multiset<double> rest;
+    double lowestSum = 0.0;
+
+    // Sums of the same percentages in fixed-point units. Integer sums are
+    // exact, so they never depend on the order scores came and went.
+    int64_t fixedSum = 0;
+    int64_t fixedExtra = 0;
 };
 
 // Each course can have many assignments.
 // For example: "COSC 3345" with 3 credit hours and several assignments.
+//
+// The running totals below (and the aggregates in each category) always
+// describe everything in "work", so the course average can be read without
+// looping over the assignments. Only change "work" through addWorkToCourse,
+// replaceWorkInCourse and removeWorkFromCourse so the totals stay correct.
+// The sums are ExactSums, so an edit or a delete simply subtracts the old
+// score and the totals never depend on edit history.
+//
+// Every course starts with one category ("General", 100%) that holds all
+// of its assignments until more categories are added.
 struct Course {
     int id;                     // a unique id so we can select this course
-    string name;                // name of the course (e.g., "COSC 3345")
+    PooledName name;            // name of the course (e.g., "COSC 3345")
     double creditHours;         // credit hours (e.g., 3.0 or 4.0)
-    vector<Assignment> work;    // list of assignments in this course
+    PooledName term;            // term taken (e.g., "Fall 2025"); batch input only
+    AssignmentColumns work;     // list of assignments in this course
+    vector<Category> categories = vector<Category>(1);
+
+    ExactSum sumPercentages;    // sum of (earned / max * 100) over "work"
+    ExactSum sumEarned;         // total points earned over "work"
+    ExactSum sumMax;            // total points possible over "work"
+};
+
+// Course ids the user can type in the menus.
+const int MIN_COURSE_ID = 1;
+const int MAX_COURSE_ID = 1000000;
+
+// A handle names one course inside a CourseStore. Handles stay valid while
+// other courses are added or deleted. Every time a slot is reused its
+// generation goes up, so a handle to a deleted course can never find the
+// course that later took over the same slot.
+struct CourseHandle {
+    uint32_t slot;
+    uint32_t generation;  // 0 is never used by a live course
+};
+
+const CourseHandle NO_COURSE = { 0xFFFFFFFFu, 0 };
+
+// True if two handles name the same course.
+inline bool sameCourse(CourseHandle a, CourseHandle b) {
+    return a.slot == b.slot && a.generation == b.generation;
+}
+
+// Holds all courses as a "slot map":
+//   * the courses themselves sit next to each other in "dense" so loops over
+//     all courses are fast (for example when computing the GPA),
+//   * "slots" point from a handle to the course's place in "dense",
+//   * "byId" points from a course id straight to its handle.
+// Looking up, adding and deleting a course are all constant time. Deleting
+// moves the last course into the hole, so the listing order can change, and
+// the freed slot is reused by the next course that gets added.
+class CourseStore {
+public:
+    CourseStore();
+
+    bool empty() const { return dense.empty(); }
+    size_t size() const { return dense.size(); }
+
+    // Position-based access, valid until the next add or delete.
+    Course& operator[](size_t index) { return dense[index]; }
+    const Course& operator[](size_t index) const { return dense[index]; }
+
+    vector<Course>::iterator begin() { return dense.begin(); }
+    vector<Course>::iterator end() { return dense.end(); }
+    vector<Course>::const_iterator begin() const { return dense.begin(); }
+    vector<Course>::const_iterator end() const { return dense.end(); }
+
+    // Adds a course. Returns NO_COURSE if its id is out of range or taken.
+    CourseHandle insert(const Course& course);
+
+    // Returns the course for a handle, or nullptr if it was deleted.
+    Course* get(CourseHandle handle);
+    const Course* get(CourseHandle handle) const;
+
+    // Returns the handle for a course id, or NO_COURSE.
+    CourseHandle handleOf(int id) const;
+
+    // Returns the position of a course id (for operator[]), or -1.
+    int indexOf(int id) const;
+
+    // Deletes a course. Returns false if the handle is stale.
+    bool erase(CourseHandle handle);
+
+    void clear();
+
+private:
+    struct Slot {
+        uint32_t generation;  // bumped every time the slot is freed
+        uint32_t denseIndex;  // position in "dense", or next free slot
+    };
+
+    vector<Course> dense;          // live courses, packed together
+    vector<uint32_t> denseToSlot;  // slot number for each entry in "dense"
+    vector<Slot> slots;
+    uint32_t freeHead;             // first free slot, or NO_COURSE.slot
+    vector<CourseHandle> byId;     // handle for each course id
+};
+
+bool isValidCourseId(int id);
+
+// Every grade a grading scale can give. Scales use only some of them
+// (the default scale uses A, B, C, D and F).
+enum Grade {
+    GRADE_A_PLUS, GRADE_A, GRADE_A_MINUS,
+    GRADE_B_PLUS, GRADE_B, GRADE_B_MINUS,
+    GRADE_C_PLUS, GRADE_C, GRADE_C_MINUS,
+    GRADE_D_PLUS, GRADE_D, GRADE_D_MINUS,
+    GRADE_F,
+    GRADE_PASS, GRADE_NO_PASS,
+    GRADE_COUNT
+};
+
+// One row of a grading scale: the lowest course percentage that earns
+// "grade", and the grade points it is worth.
+struct GradeBand {
+    double minPercent;
+    Grade grade;
+    double points;
+    bool countsInGpa;  // false for pass/fail grades
+};
+
+// A grading scale is a short table of bands, best grade first. The last
+// band has minPercent 0 and catches everything below the others. The table
+// lives inside the struct, so looking up a grade never allocates.
+struct GradingScale {
+    GradeBand bands[GRADE_COUNT];
+    int bandCount;
+};
+
+// Today's scale: A 90, B 80, C 70, D 60, otherwise F, on a 4.0 scale.
+constexpr GradingScale DEFAULT_GRADING_SCALE = {
+    {
+        { 90.0, GRADE_A, 4.0, true },
+        { 80.0, GRADE_B, 3.0, true },
+        { 70.0, GRADE_C, 2.0, true },
+        { 60.0, GRADE_D, 1.0, true },
+        {  0.0, GRADE_F, 0.0, true },
+    },
+    5
+};
+
+// How many graded courses currently have each grade (indexed by Grade).
+struct GradeCounts {
+    int counts[GRADE_COUNT];
+    int total;
+};
+
+// The two halves of a credit-weighted GPA, kept apart so they can be
+// adjusted one course at a time.
+struct GpaTotals {
+    double qualityPoints;  // sum of (gradePoints * creditHours)
+    double credits;        // sum of credit hours of graded courses
+    long long fixedQuality;    // the same two in fixed-point units:
+    long long fixedHalfHours;  // thousandths of a point * half hours
+};
+
+// A what-if scenario laid "on top of" the real courses without copying them.
+// Each course touched by the scenario gets one small delta holding the
+// percentages of its hypothetical assignments (kept per category, because
+// drop-lowest rules need the individual scores). Course averages and the GPA are
+// worked out from the real running totals plus these deltas, so nothing is
+// copied and the extra memory only depends on how many courses are touched.
+class WhatIfOverlay {
+public:
+    explicit WhatIfOverlay(const CourseStore& courses);
+
+    // Adds one hypothetical assignment to a category of a course.
+    // Returns false if the handle or category does not exist.
+    bool addHypothetical(CourseHandle course, int category,
+                         double earned, double max);
+
+    // Adds "count" hypothetical assignments that each score "percentEach".
+    bool addHypotheticals(CourseHandle course, int category,
+                          double percentEach, int count);
+
+    // Course average including the hypothetical assignments.
+    double coursePercentage(CourseHandle course) const;
+
+    // True if the course has real or hypothetical assignments.
+    bool courseIsGraded(CourseHandle course) const;
+
+    // Overall GPA including every hypothetical assignment so far.
+    double overallGPA() const;
+
+    // Number of hypothetical assignments added so far.
+    int hypotheticalCount() const;
+
+private:
+    struct Delta {
+        CourseHandle course;
+        vector<vector<double> > added;  // per category, lowest first
+        int addedCount;
+    };
+
+    int findDelta(CourseHandle course) const;  // index in deltas, or -1
+
+    const CourseStore& courses;
+    GpaTotals baseTotals;    // GPA totals of the real courses
+    vector<Delta> deltas;    // one per touched course
+};
+
+// Builds report text in one reusable buffer and writes it with a single
+// call, instead of many small "cout <<" calls. Numbers are formatted by
+// hand (much faster than iostream formatting), so big tables print quickly
+// even when the output goes to a slow terminal or a pipe.
+class ReportBuffer {
+public:
+    void clear() { chars.clear(); }
+    size_t size() const { return chars.size(); }
+    const string& text() const { return chars; }
+
+    void append(const char* s) { chars += s; }
+    void append(const string& s) { chars += s; }
+    void append(const PooledName& s) { chars.append(s.c_str(), s.size()); }
+    void append(char c) { chars += c; }
+
+    // Whole number, e.g. 42.
+    void appendInt(long long value);
+
+    // Number with exactly "decimals" digits after the point, e.g. 87.50.
+    void appendFixed(double value, int decimals);
+
+    // Number with up to two decimals and no trailing zeros, e.g. 3 or 2.5.
+    void appendShort(double value);
+
+    // Adds spaces until the text written since "start" is "width" wide
+    // (like setw with left alignment).
+    void padFrom(size_t start, size_t width);
+
+    // Writes everything to "out" at once and empties the buffer.
+    void writeTo(ostream& out);
+
+    // Trades the text for the contents of "other", so a finished report can
+    // be handed on without copying it.
+    void swapText(string& other) { chars.swap(other); }
+
+private:
+    string chars;
+};
+
+// A whole file made readable in memory. On Linux/macOS the file is mapped
+// with mmap, so opening is instant and pages are only read when touched.
+// Elsewhere the file is simply read into a buffer.
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const string& path, string& error);
+    void close();
+
+    const unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    MappedFile(const MappedFile&);             // not copyable
+    MappedFile& operator=(const MappedFile&);
+
+    const unsigned char* bytes;
+    size_t length;
+    bool mapped;                    // true if "bytes" came from mmap
+    vector<unsigned char> fallback; // used when mmap is not available
+};
+
+// Reads a gradebook snapshot file (see "SNAPSHOT FILES") in place. Numbers
+// are used straight from the mapped file: nothing is parsed or copied, so
+// even a very large gradebook opens in about the time it takes to map it.
+class SnapshotView {
+public:
+    SnapshotView();
+
+    // Opens and checks a snapshot. Checking the checksum reads the whole
+    // file; skip it for the fastest possible open of a trusted file.
+    bool open(const string& path, bool verifyChecksum, string& error);
+
+    size_t courseCount() const { return courses; }
+    size_t categoryCount() const { return categories; }
+    size_t assignmentCount() const { return assignments; }
+    int nextCourseId() const { return nextId; }
+    uint32_t journalEpoch() const { return epoch; }
+
+    // Course columns (index 0 .. courseCount()-1).
+    int courseId(size_t i) const { return ids[i]; }
+    double courseCredits(size_t i) const { return credits[i]; }
+    double coursePercentage(size_t i) const;
+    PooledName courseName(size_t i) const;  // interned straight from the file
+    size_t firstAssignment(size_t i) const { return workBegin[i]; }
+    size_t courseAssignmentCount(size_t i) const {
+        return workBegin[i + 1] - workBegin[i];
+    }
+
+    // Category columns (index 0 .. categoryCount()-1). Version 1 files
+    // have no categories: every course gets just the default one.
+    size_t firstCategory(size_t i) const {
+        return categoryBegin == nullptr ? 0 : categoryBegin[i];
+    }
+    size_t courseCategoryCount(size_t i) const {
+        return categoryBegin == nullptr
+            ? 0 : categoryBegin[i + 1] - categoryBegin[i];
+    }
+    double categoryWeight(size_t k) const { return weights[k]; }
+    int categoryDropLowest(size_t k) const { return dropLowest[k]; }
+    string categoryName(size_t k) const;
+
+    // Assignment columns (index 0 .. assignmentCount()-1). The category
+    // columns are nullptr for version 1 files.
+    const double* earnedColumn() const { return earned; }
+    const double* maxColumn() const { return max; }
+    const unsigned char* categoryColumn() const { return assignmentCategory; }
+    const unsigned char* extraCreditColumn() const { return extraCredit; }
+    PooledName assignmentName(size_t i) const;
+
+    // Overall GPA computed directly from the mapped columns.
+    double overallGPA() const;
+
+private:
+    MappedFile file;
+    uint32_t version;
+    size_t courses;
+    size_t categories;
+    size_t assignments;
+    int nextId;
+    uint32_t epoch;
+
+    const int32_t* ids;
+    const double* credits;
+    const double* percentages;  // v1: sum of percentages, v2: course average
+    const uint64_t* workBegin;
+    const uint64_t* courseNameBegin;
+    const uint64_t* categoryBegin;
+    const double* weights;
+    const uint64_t* categoryNameBegin;
+    const uint32_t* dropLowest;
+    const double* earned;
+    const double* max;
+    const uint64_t* assignmentNameBegin;
+    const unsigned char* assignmentCategory;
+    const unsigned char* extraCredit;
+    const char* strings;
+};
+
+// Record batches in a columnar export file (see "COLUMNAR EXPORT"). The
+// column numbers below give each batch's columns in file order.
+enum ColumnarKind {
+    COLUMNAR_END = 0,           // last block of every file
+    COLUMNAR_DICTIONARY = 1,    // more names, numbered after the earlier ones
+    COLUMNAR_COURSES = 2,
+    COLUMNAR_CATEGORIES = 3,
+    COLUMNAR_ASSIGNMENTS = 4
+};
+
+enum CourseColumn {
+    COL_COURSE_CREDITS,       // double
+    COL_COURSE_PERCENT,       // double, the course average
+    COL_COURSE_ID,            // int32
+    COL_COURSE_NAME,          // uint32 name index
+    COL_COURSE_LETTER,        // uint32 name index ("N/A" if ungraded)
+    COL_COURSE_CATEGORIES,    // uint32 number of category rows
+    COL_COURSE_ASSIGNMENTS    // uint32 number of assignment rows
+};
+
+enum CategoryColumn {
+    COL_CATEGORY_WEIGHT,      // double
+    COL_CATEGORY_COURSE,      // int32 course id
+    COL_CATEGORY_NAME,        // uint32 name index
+    COL_CATEGORY_DROP         // uint32 drop-lowest count
+};
+
+enum AssignmentColumn {
+    COL_ASSIGNMENT_EARNED,    // double
+    COL_ASSIGNMENT_MAX,       // double
+    COL_ASSIGNMENT_PERCENT,   // double, earned / max * 100
+    COL_ASSIGNMENT_COURSE,    // int32 course id
+    COL_ASSIGNMENT_NAME,      // uint32 name index
+    COL_ASSIGNMENT_CATEGORY,  // uint8 category index in its course
+    COL_ASSIGNMENT_EXTRA      // uint8, 1 for extra credit
+};
+
+// Reads a columnar export file in place: every column of every record
+// batch is used straight from the mapped file, so the numbers are never
+// parsed or copied.
+class ColumnarView {
+public:
+    ColumnarView();
+
+    // Opens and checks a file. Checking the checksums reads every byte;
+    // skip it for the fastest possible open of a trusted file.
+    bool open(const string& path, bool verifyChecksum, string& error);
+
+    int nextCourseId() const { return nextId; }
+
+    // Record batches (dictionary batches are folded into the names below).
+    size_t batchCount() const { return batches.size(); }
+    ColumnarKind batchKind(size_t b) const { return batches[b].kind; }
+    size_t batchRows(size_t b) const { return batches[b].rows; }
+    const double* doubleColumn(size_t b, int column) const {
+        return reinterpret_cast<const double*>(columnData(b, column));
+    }
+    const int32_t* intColumn(size_t b, int column) const {
+        return reinterpret_cast<const int32_t*>(columnData(b, column));
+    }
+    const uint32_t* uintColumn(size_t b, int column) const {
+        return reinterpret_cast<const uint32_t*>(columnData(b, column));
+    }
+    const unsigned char* byteColumn(size_t b, int column) const {
+        return columnData(b, column);
+    }
+
+    // The name dictionary shared by every batch.
+    size_t nameCount() const { return names; }
+    PooledName name(uint32_t index) const;  // interned straight from the file
+
+private:
+    struct Batch {
+        ColumnarKind kind;
+        size_t rows;
+        const unsigned char* body;
+    };
+    struct Dictionary {
+        size_t first;               // index of its first name
+        size_t count;
+        const uint64_t* offsets;    // count + 1 entries
+        const char* text;
+    };
+
+    const unsigned char* columnData(size_t b, int column) const;
+
+    MappedFile file;
+    int nextId;
+    size_t names;
+    vector<Batch> batches;
+    vector<Dictionary> dictionaries;
+};
+
+// Every change to the gradebook is described by one Mutation. The menus
+// build a Mutation and hand it to applyMutation, which checks it, applies
+// it and records it in the journal. Replaying the journal after a crash
+// goes through exactly the same code.
+enum MutationType {
+    MUTATION_ADD_COURSE = 1,
+    MUTATION_ADD_ASSIGNMENT = 2,
+    MUTATION_RENAME_COURSE = 3,
+    MUTATION_SET_CREDIT_HOURS = 4,
+    MUTATION_EDIT_ASSIGNMENT = 5,
+    MUTATION_DELETE_ASSIGNMENT = 6,
+    MUTATION_DELETE_COURSE = 7,
+    MUTATION_ADD_CATEGORY = 8,
+    MUTATION_EDIT_CATEGORY = 9,
+    MUTATION_INSERT_ASSIGNMENT = 10,  // used to undo a delete
+    MUTATION_DELETE_CATEGORY = 11     // last category only; used to undo an add
+};
+
+struct Mutation {
+    MutationType type;
+    int courseId;
+    uint32_t index;       // assignment position (edit / insert / delete
+                          // assignment) or category position (edit /
+                          // delete category)
+    double creditHours;   // add course / set credit hours
+    double earned;        // add / edit assignment
+    double max;           // add / edit assignment
+    uint32_t category;    // add / edit assignment
+    bool extraCredit;     // add / edit assignment
+    double weight;        // add / edit category
+    uint32_t dropLowest;  // add / edit category
+    string name;          // course, assignment or category name
+};
+
+class Journal;
+
+// One student in a cohort: an id plus that student's own courses.
+struct StudentRecord {
+    string id;
+    CourseStore courses;
+};
+
+// How the cohort grade distribution puts courses together.
+enum DistributionGrouping {
+    GROUP_BY_COURSE,      // same course name
+    GROUP_BY_DEPARTMENT,  // same name prefix, e.g. "COSC" for "COSC 3345"
+    GROUP_BY_TERM         // same term, e.g. "Fall 2025"
+};
+
+// Grade counts and a percentage histogram for one group of courses.
+struct GroupDistribution {
+    PooledName group;
+    long long grades[GRADE_COUNT];  // courses with each grade (indexed by Grade)
+    long long courses;
+    double sumPercent;              // for the mean percentage
+    vector<uint32_t> bins;          // courses per percentage bin
+};
+
+// Percentage bin widths "--bin-width" accepts.
+const double MIN_BIN_WIDTH = 0.1;
+const double MAX_BIN_WIDTH = 100.0;
+
+// How "--transcripts" writes each student's transcript.
+enum TranscriptFormat {
+    TRANSCRIPT_TEXT,  // fixed-width text, like the menu screens
+    TRANSCRIPT_JSON   // one JSON object per line
+};
+
+// One step of the undo history: the change that was made (to redo it) and
+// the changes that reverse it (see "UNDO / REDO").
+struct HistoryStep {
+    Mutation change;
+    vector<Mutation> undo;
+};
+
+// Undo and redo stacks. Making a new change empties the redo stack; only
+// the newest UNDO_HISTORY_STEPS steps are kept.
+class UndoHistory {
+public:
+    void clear();
+
+    // Adds a step for a change that was just made ("undo" is taken over).
+    void record(const Mutation& change, vector<Mutation>& undo);
+
+    size_t undoCount() const { return done.size(); }
+    size_t redoCount() const { return undone.size(); }
+
+    // Moving steps between the stacks while undoing and redoing.
+    bool takeUndo(HistoryStep& step);
+    bool takeRedo(HistoryStep& step);
+    void keepUndo(HistoryStep& step);
+    void keepRedo(HistoryStep& step);
+
+private:
+    deque<HistoryStep> done;     // oldest first
+    vector<HistoryStep> undone;  // next redo last
+};
+
+// The graded courses of a gradebook sorted into one bucket per letter
+// grade (see "GRADE INDEX"). applyMutation moves a course between buckets
+// when its grade changes, so grade counts take constant time and listing
+// the courses with one grade takes time proportional to how many there are.
+class GradeIndex {
+public:
+    GradeIndex();
+
+    void clear();
+
+    // Sorts every course of "courses" into its bucket again.
+    void rebuild(const CourseStore& courses);
+
+    // Grades one course again and moves it to the right bucket (or takes
+    // it out when it has no assignments).
+    void update(const CourseStore& courses, CourseHandle handle);
+
+    // Takes a course out of the index. Call before deleting it.
+    void erase(CourseHandle handle);
+
+    GradeCounts counts() const;
+    const vector<CourseHandle>& coursesWith(Grade grade) const {
+        return members[grade];
+    }
+
+private:
+    struct Entry {
+        uint32_t position;  // index inside members[grade]
+        uint8_t grade;      // GRADE_COUNT when the course is not indexed
+    };
+
+    vector<CourseHandle> members[GRADE_COUNT];  // courses with each grade
+    vector<Entry> entries;                      // by CourseHandle slot
+    int total;
+};
+
+// Everything the menus work on: the courses plus the bookkeeping needed to
+// keep them on disk.
+struct Gradebook {
+    CourseStore courses;
+    GradeIndex grades;                 // courses by current letter grade
+    int nextCourseId = MIN_COURSE_ID;  // each new course gets a new ID
+    string dataPath;                   // snapshot file ("" = not saved)
+    uint32_t checkpointEpoch = 0;      // which journal the snapshot goes with
+    Journal* journal = nullptr;        // where changes are logged, if anywhere
+    UndoHistory* history = nullptr;    // where undo steps go, if anywhere
+    bool lastChangeUnlogged = false;   // applyMutation made its change but
+                                       // could not journal it
+};
+
+// Append-only log of Mutations (see "WRITE-AHEAD JOURNAL"). Records are
+// collected in memory and written + fsync'ed together ("group commit"),
+// either when enough are waiting or when commit() is called.
+class Journal {
+public:
+    Journal();
+    ~Journal();
+
+    // Opens "path" for appending. If the file is missing or belongs to an
+    // older checkpoint it is started over for "epoch".
+    bool open(const string& path, uint32_t epoch, string& error);
+    void close();
+
+    // Queues one record. Commits right away once the batch is full.
+    bool append(const Mutation& m);
+
+    // Writes and fsyncs everything queued so far.
+    bool commit();
+
+    // Commits if the oldest queued record has waited longer than allowed.
+    bool commitIfDue();
+
+    // Forgets the queued records without writing them (after a failed
+    // commit whose changes were reported as not saved).
+    void discardPending();
+
+    // Empties the journal after a checkpoint and starts it for "epoch".
+    bool reset(uint32_t epoch, string& error);
+
+    // Batch size and maximum wait before queued records are committed.
+    void setGroupCommit(size_t maxRecords, int maxDelayMs);
+
+    uint64_t sizeBytes() const { return fileBytes + pending.size(); }
+    size_t pendingRecords() const { return pendingCount; }
+
+    // Records appended since the journal was created, and how many of them
+    // are safely on disk (written, or covered by a checkpoint). Both only
+    // grow, except that discardPending takes the dropped ones back.
+    uint64_t appendedRecords() const { return appendedCount; }
+    uint64_t durableRecords() const { return appendedCount - pendingCount; }
+
+private:
+    Journal(const Journal&);             // not copyable
+    Journal& operator=(const Journal&);
+
+    bool writeHeader(uint32_t epoch);
+
+    FILE* file;
+    string path;
+    uint64_t fileBytes;                  // bytes already in the file
+    vector<unsigned char> pending;       // encoded records not yet written
+    size_t pendingCount;
+    uint64_t appendedCount;
+    chrono::steady_clock::time_point oldestPending;
+    size_t maxBatchRecords;
+    int maxDelayMs;
+};
+
+// Client side of daemon mode (see "DAEMON MODE"): connects to a running
+// "--serve" process and sends it script-mode commands.
+class GradebookClient {
+public:
+    GradebookClient();
+    ~GradebookClient();
+
+    bool connect(const string& socketPath, string& error);
+    void close();
+
+    // Sends one command and waits for its answer ("OK ..." or "ERR ...").
+    bool query(const string& command, string& answer);
+
+    // Sends many commands pipelined (a window at a time) and collects the
+    // answers in order. Empty and comment lines get an empty answer.
+    bool queryAll(const vector<string>& commands, vector<string>& answers);
+
+private:
+    GradebookClient(const GradebookClient&);             // not copyable
+    GradebookClient& operator=(const GradebookClient&);
+
+    bool sendAll(const string& bytes);
+    bool readLine(string& line);
+
+    int fd;
+    string request;       // reused for outgoing commands
+    string received;      // bytes read but not yet returned
+    size_t receivedPos;
+};
+
+// Ranks a population of students by GPA (see "CLASS RANK"). Students are
+// numbered 0 .. n-1 by the caller. Every query and every change of one
+// student's GPA takes O(log n) time, so an edit never needs a full re-sort.
+class GpaRankIndex {
+public:
+    GpaRankIndex();
+
+    // Forgets every student and makes room for numbers 0 .. students-1.
+    void reset(size_t students);
+
+    // Adds the student, or moves them if they are already indexed.
+    void set(size_t student, double gpa);
+    void erase(size_t student);
+
+    bool contains(size_t student) const;
+    double gpaOf(size_t student) const { return gpas[student]; }
+    size_t size() const { return count; }
+
+    size_t countAbove(double gpa) const;    // GPA higher than "gpa"
+    size_t countAtLeast(double gpa) const;  // GPA of "gpa" or higher
+    size_t countBelow(double gpa) const;    // GPA lower than "gpa"
+
+    // 1 for the best GPA; students with the same GPA share a rank.
+    size_t rankOf(size_t student) const;
+
+    // Percent of the indexed students whose GPA is "gpa" or lower.
+    double percentileOf(double gpa) const;
+
+    // The best "k" students, best first (ties by student number).
+    void topStudents(size_t k, vector<size_t>& students) const;
+
+    // Every student at or above / below a GPA, best first.
+    void studentsAtLeast(double gpa, vector<size_t>& students) const;
+    void studentsBelow(double gpa, vector<size_t>& students) const;
+
+private:
+    static size_t bucketOf(double gpa);
+    void addToBucket(size_t bucket, int delta);
+    size_t countUpTo(size_t bucket) const;    // students in buckets 0..bucket
+    size_t bucketOfNth(size_t nth) const;     // bucket of the nth lowest (1-based)
+    void appendBucket(size_t bucket, vector<size_t>& students) const;
+
+    vector<uint32_t> tree;                  // Fenwick tree over the buckets
+    vector<vector<uint32_t> > members;      // students in each bucket
+    vector<uint32_t> position;              // index inside members[bucket]
+    vector<uint16_t> bucket;                // bucket of each student
+    vector<double> gpas;                    // exact GPA of each student
+    size_t count;
+};
+
+// Operations that are counted and timed (see "METRICS"). The changes are
+// in the same order as MutationType.
+enum MetricOp {
+    METRIC_COURSE_PERCENTAGE,
+    METRIC_OVERALL_GPA,
+    METRIC_WHATIF_ADD,
+    METRIC_WHATIF_GPA,
+    METRIC_FIND_COURSE,
+    METRIC_ADD_COURSE,
+    METRIC_ADD_ASSIGNMENT,
+    METRIC_RENAME_COURSE,
+    METRIC_SET_CREDIT_HOURS,
+    METRIC_EDIT_ASSIGNMENT,
+    METRIC_DELETE_ASSIGNMENT,
+    METRIC_DELETE_COURSE,
+    METRIC_ADD_CATEGORY,
+    METRIC_EDIT_CATEGORY,
+    METRIC_INSERT_ASSIGNMENT,
+    METRIC_DELETE_CATEGORY,
+    METRIC_OTHER_CHANGE,
+    METRIC_RENDER_REPORT,
+    METRIC_WRITE_OUTPUT,
+    METRIC_COUNT
+};
+
+#if defined(GPA_HAVE_METRICS)
+uint64_t metricClock();
+uint64_t startMetric(MetricOp op);
+void recordMetric(MetricOp op, uint64_t nanoseconds);
+
+// Counts one call of "op" and, if this call is sampled, times the rest of
+// the enclosing block.
+class MetricTimer {
+public:
+    explicit MetricTimer(MetricOp op) : op(op), start(startMetric(op)) {}
+    ~MetricTimer() {
+        if (start != 0) {
+            recordMetric(op, metricClock() - start);
+        }
+    }
+
+private:
+    MetricOp op;
+    uint64_t start;
 };
 
+#define GPA_METRIC_CONCAT2(a, b) a##b
+#define GPA_METRIC_CONCAT(a, b) GPA_METRIC_CONCAT2(a, b)
+#define GPA_TIME_METRIC(op) \
+    MetricTimer GPA_METRIC_CONCAT(metricTimer, __LINE__)(op)
+#else
+#define GPA_TIME_METRIC(op) ((void)0)
+#endif
+
 // ============================================================================
 // HELPER FUNCTION DECLARATIONS (PROTOTYPES)
 // ============================================================================
@@ -60,79 +1152,641 @@ double readDoubleInRange(const string& prompt, double minValue, double maxValue)
 
 // Menus
 void showMainMenu();
-void manageCoursesAndAssignments(vector<Course>& courses);
+void manageCoursesAndAssignments(Gradebook& book);
+
+// Changes (all edits go through applyMutation)
+Mutation makeAddCourse(int id, const string& name, double creditHours);
+Mutation makeAddAssignment(int courseId, const Assignment& a);
+Mutation makeRenameCourse(int courseId, const string& name);
+Mutation makeSetCreditHours(int courseId, double creditHours);
+Mutation makeEditAssignment(int courseId, size_t index, const Assignment& a);
+Mutation makeDeleteAssignment(int courseId, size_t index);
+Mutation makeDeleteCourse(int courseId);
+Mutation makeAddCategory(int courseId, const string& name, double weight,
+                         int dropLowest);
+Mutation makeEditCategory(int courseId, int category, const string& name,
+                          double weight, int dropLowest);
+Mutation makeInsertAssignment(int courseId, size_t index, const Assignment& a);
+Mutation makeDeleteCategory(int courseId, int category);
+bool applyMutation(Gradebook& book, const Mutation& m, string& error);
+
+// Undo / redo
+bool inverseMutations(const CourseStore& courses, const Mutation& m,
+                      vector<Mutation>& undo);
+string describeMutation(const Mutation& m);
+bool undoLastChange(Gradebook& book, string& description, string& error);
+bool redoLastChange(Gradebook& book, string& description, string& error);
+void undoMenu(Gradebook& book);
+void redoMenu(Gradebook& book);
+
+// Report rendering (buffered, paginated tables)
+ReportBuffer& reportBuffer();
+bool nameMatchesFilter(const PooledName& name, const string& filter);
+void showPagedReport(const string& header, const string& footer,
+                     size_t rowCount,
+                     const function<bool(size_t, const string&)>& rowMatches,
+                     const function<void(size_t, ReportBuffer&)>& renderRow);
+
+// Grading categories
+int askCategory(const Course& c);
+void addCategoryToCourse(Gradebook& book);
+void editCategoryInCourse(Gradebook& book);
 
 // Course operations
-void addCourse(vector<Course>& courses, int& nextCourseId);
-int findCourseIndexById(const vector<Course>& courses, int id);
-void listCoursesSummary(const vector<Course>& courses);
+void addCourse(Gradebook& book);
+int findCourseIndexById(const CourseStore& courses, int id);
+void findCoursesByName(const CourseStore& courses, const string& name,
+                       vector<int>& ids);
+void listCoursesSummary(const CourseStore& courses);
 
 // Assignment operations
-void addAssignmentToCourse(vector<Course>& courses);
+void addAssignmentToCourse(Gradebook& book);
+double assignmentPercentage(const Assignment& a);
+void addWorkToCourse(Course& course, const Assignment& a);
+void insertWorkInCourse(Course& course, size_t index, const Assignment& a);
+void replaceWorkInCourse(Course& course, size_t index, const Assignment& a);
+void removeWorkFromCourse(Course& course, size_t index);
+ExactSum sumScorePercentages(const double* earned, const double* max,
+                             size_t count);
+void recalculateCourseTotals(Course& course);
+void addScoreToCategory(Category& cat, double percent, int64_t units,
+                        bool extraCredit);
+void removeScoreFromCategory(Category& cat, double percent, int64_t units,
+                             bool extraCredit);
+void clearCategoryScores(Category& cat);
+void rebuildCategory(Course& course, int category);
+double categoryPercentageWith(const Category& cat, const vector<double>* added);
+
+// Fixed-point scores
+bool fixedPointMode();
+void setFixedPointMode(bool on);
+int64_t fixedPercentUnits(double earned, double max);
+int64_t sumFixedColumn(const int64_t* values, size_t count);
+int64_t fixedCoursePercentage(const Course& course);
 
 // Grade calculations and displays
 double calculateCoursePercentage(const Course& course);
-string percentageToLetter(double percent);
-double letterToGradePoints(const string& letter);
-void showCourseDetails(const vector<Course>& courses);
-double calculateOverallGPA(const vector<Course>& courses);
-void showOverallGPA(const vector<Course>& courses);
-void showGradeDistribution(const vector<Course>& courses);
+const char* percentageToLetter(double percent);
+void showCourseDetails(const CourseStore& courses);
+double calculateOverallGPA(const CourseStore& courses);
+double coursePercentageWith(const Course& course,
+                            const vector<vector<double> >& added);
+void addCourseToTotals(GpaTotals& totals, double percent, double creditHours);
+void removeCourseFromTotals(GpaTotals& totals, double percent,
+                           double creditHours);
+GpaTotals calculateGpaTotals(const CourseStore& courses);
+double gpaFromTotals(const GpaTotals& totals);
+void showOverallGPA(const CourseStore& courses);
+void showGradeDistribution(const Gradebook& book);
+GradeCounts countGradeDistribution(const CourseStore& courses);
+bool coursesWithGrade(const Gradebook& book, Grade grade, bool worse,
+                      vector<int>& ids);
+
+// Grading scales
+const GradingScale& gradingScale();
+void setGradingScale(const GradingScale& scale);
+const GradeBand& gradeBandFor(double percent);
+Grade percentageToGrade(double percent);
+const char* gradeName(Grade grade);
+double gradePoints(Grade grade);
+bool loadGradingScale(const string& nameOrPath, GradingScale& scale,
+                      string& error);
 
 // What-if scenario
-void whatIfScenario(const vector<Course>& courses);
+void whatIfScenario(const CourseStore& courses);
+
+// Minimum-score solver
+struct BoundaryRequirement;
+void solveMinimumScores(const CourseStore& courses, CourseHandle course,
+                        int category, const vector<double>& pendingMax,
+                        vector<BoundaryRequirement>& results,
+                        vector<double>& requiredEarned);
+void minimumScoreSolver(const CourseStore& courses);
+
+// Grade forecast (Monte Carlo)
+struct PendingWork;
+struct ForecastResult;
+void fitPendingScores(const CourseStore& courses, CourseHandle course,
+                      int category, double& mean, double& spread,
+                      int& samples);
+void forecastGrades(const CourseStore& courses,
+                    const vector<PendingWork>& pending, size_t runs,
+                    unsigned threads, uint64_t seed, ForecastResult& result);
+double forecastGpaPercentile(const ForecastResult& result, double fraction);
+void forecastMenu(const CourseStore& courses);
 
 // Editing / deleting helpers
-void renameCourse(vector<Course>& courses);
-void changeCourseCreditHours(vector<Course>& courses);
-void editAssignmentInCourse(vector<Course>& courses);
-void deleteAssignmentFromCourse(vector<Course>& courses);
-void deleteCourse(vector<Course>& courses);
+void renameCourse(Gradebook& book);
+void changeCourseCreditHours(Gradebook& book);
+void editAssignmentInCourse(Gradebook& book);
+void deleteAssignmentFromCourse(Gradebook& book);
+void deleteCourse(Gradebook& book);
+
+// Batch (non-interactive) mode
+struct BatchRow;
+bool splitBatchLine(const string& line, char delimiter, vector<string>& fields);
+bool parseBatchRow(const vector<string>& fields, BatchRow& row, string& error);
+void appendBatchField(string& out, const char* field, size_t length,
+                      char delimiter);
+void writeStudentResults(const string& student, const CourseStore& courses,
+                         double gpa, char delimiter, string& out);
+long long readStudentBlocks(istream& in, char& delimiter,
+                            const function<void(vector<StudentRecord>&,
+                                                size_t)>& onBlock);
+int runBatchMode(istream& in, ostream& out, unsigned threads);
+
+// Cohort GPA (parallel)
+unsigned defaultThreadCount();
+bool parseThreadCount(const char* value, unsigned& threads);
+void parallelForWorkers(size_t count, unsigned threads, size_t grain,
+                        const function<void(unsigned, size_t, size_t)>& body);
+void parallelForRanges(size_t count, unsigned threads, size_t grain,
+                       const function<void(size_t, size_t)>& body);
+void calculateCohortGPAs(const vector<StudentRecord>& students,
+                         unsigned threads, vector<double>& gpas);
+
+// Cohort grade distribution
+class CohortDistribution;
+void writeDistribution(const vector<GroupDistribution>& groups,
+                       double binWidth, char delimiter, string& out);
+int runDistributionMode(istream& in, ostream& out,
+                        DistributionGrouping grouping, double binWidth,
+                        unsigned threads);
+
+// Transcripts (pipelined)
+void appendTranscript(const StudentRecord& student, TranscriptFormat format,
+                      ReportBuffer& out);
+int runTranscriptMode(istream& in, ostream& out, TranscriptFormat format,
+                      unsigned threads);
+
+// Snapshot files (save / load)
+bool saveSnapshot(const string& path, const Gradebook& book, string& error);
+bool loadSnapshot(const string& path, Gradebook& book, string& error);
+string askSnapshotPath(const string& defaultPath);
+void saveGradebookMenu(Gradebook& book);
+void loadGradebookMenu(Gradebook& book);
+
+// Columnar export (record batches for analytics tools)
+bool exportColumnar(const string& path, const Gradebook& book, string& error);
+bool importColumnar(const string& path, Gradebook& book, string& error);
+
+// Metrics
+MetricOp mutationMetric(MutationType type);
+void writeMetricsText(ostream& out);
+void appendMetricsJson(string& out);
+void printMetricsTextAtExit();
+void printMetricsJsonAtExit();
+
+// Class rank
+int runRankMode(istream& students, istream& queries, ostream& out,
+                unsigned threads);
+
+// Benchmarks
+struct SyntheticConfig;
+void generateSyntheticCourses(mt19937_64& rng, const SyntheticConfig& config,
+                              size_t count, CourseStore& courses);
+void generateSyntheticCohort(const SyntheticConfig& config, size_t totalCourses,
+                             vector<StudentRecord>& students);
+int runBenchmarks(int argc, char* argv[]);
+
+// Write-ahead journal
+void encodeMutation(const Mutation& m, vector<unsigned char>& out);
+bool decodeMutation(const unsigned char* data, size_t size, Mutation& m);
+long long replayJournal(const string& path, Gradebook& book, string& error);
+bool checkpointGradebook(Gradebook& book, string& error);
+bool syncGradebook(Gradebook& book);
+bool openGradebook(const string& dataPath, Gradebook& book, Journal& journal,
+                   string& error);
+
+// Script mode (one command per line, one answer per command)
+bool answerScriptLine(Gradebook& book, string& line, ReportBuffer& answers,
+                      bool& stop);
+int runScriptMode(istream& in, ostream& out, Gradebook& book);
+
+// Daemon mode (Unix domain socket server and client)
+int runServer(const string& socketPath, Gradebook& book);
+int runClient(int argc, char* argv[]);
 
 // ============================================================================
 // MAIN FUNCTION
 // ============================================================================
 //3
-int main() {
-    vector<Course> courses;   // holds all the courses
-    int nextCourseId = 1;     // each new course gets a new ID
+int main(int argc, char* argv[]) {
+    // "--scale name|file" picks the grading scale (see "GRADING SCALES").
+    // It may appear anywhere and is taken out before the other options.
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--scale") != 0) {
+            continue;
+        }
+        if (i + 1 >= argc) {
+            cerr << "--scale needs a scale name or file.\n";
+            return 1;
+        }
+
+        GradingScale scale;
+        string error;
+        if (!loadGradingScale(argv[i + 1], scale, error)) {
+            cerr << "Could not load grading scale: " << error << "\n";
+            return 1;
+        }
+        setGradingScale(scale);
+
+        for (int j = i; j + 2 <= argc; ++j) {
+            argv[j] = argv[j + 2];
+        }
+        argc -= 2;
+        --i;
+    }
+
+    // "--metrics text|json" prints the operation counters and latencies on
+    // stderr when the program ends (see "METRICS"). Like "--scale" it may
+    // appear anywhere.
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--metrics") != 0) {
+            continue;
+        }
+        if (i + 1 >= argc || (strcmp(argv[i + 1], "text") != 0 &&
+                              strcmp(argv[i + 1], "json") != 0)) {
+            cerr << "--metrics needs \"text\" or \"json\".\n";
+            return 1;
+        }
+        atexit(strcmp(argv[i + 1], "json") == 0 ? printMetricsJsonAtExit
+                                                 : printMetricsTextAtExit);
+
+        for (int j = i; j + 2 <= argc; ++j) {
+            argv[j] = argv[j + 2];
+        }
+        argc -= 2;
+        --i;
+    }
+
+    // "--fixed-point" grades with whole-number scores so results do not
+    // depend on summation order (see "FIXED-POINT SCORES"). Like "--scale"
+    // it may appear anywhere.
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--fixed-point") != 0) {
+            continue;
+        }
+        setFixedPointMode(true);
+
+        for (int j = i; j + 1 <= argc; ++j) {
+            argv[j] = argv[j + 1];
+        }
+        --argc;
+        --i;
+    }
+
+    // "--bench [options]" times the core operations (see "BENCHMARKS").
+    if (argc >= 2 && strcmp(argv[1], "--bench") == 0) {
+        return runBenchmarks(argc, argv);
+    }
+
+    // "--batch [file] [--threads N]" runs the non-interactive mode instead
+    // of the menu. Without a file name (or with "-") the rows are read from
+    // stdin. Students are graded on N threads (default: all cores).
+    if (argc >= 2 && strcmp(argv[1], "--batch") == 0) {
+        ios::sync_with_stdio(false);
+
+        const char* inputPath = "-";
+        unsigned threads = defaultThreadCount();
+        for (int i = 2; i < argc; ++i) {
+            if (strcmp(argv[i], "--threads") == 0) {
+                if (!parseThreadCount(i + 1 < argc ? argv[++i] : nullptr,
+                                      threads)) {
+                    return 1;
+                }
+            } else {
+                inputPath = argv[i];
+            }
+        }
+
+        if (strcmp(inputPath, "-") != 0) {
+            ifstream file(inputPath);
+            if (!file) {
+                cerr << "Could not open batch input file: " << inputPath << "\n";
+                return 1;
+            }
+            return runBatchMode(file, cout, threads);
+        }
+        return runBatchMode(cin, cout, threads);
+    }
+
+    // "--distribution [file] [--by course|department|term] [--bin-width W]
+    // [--threads N]" reads the same input as batch mode and writes the grade
+    // distribution of the whole cohort (see "COHORT GRADE DISTRIBUTION").
+    if (argc >= 2 && strcmp(argv[1], "--distribution") == 0) {
+        ios::sync_with_stdio(false);
+
+        const char* inputPath = "-";
+        DistributionGrouping grouping = GROUP_BY_COURSE;
+        double binWidth = 1.0;
+        unsigned threads = defaultThreadCount();
+        for (int i = 2; i < argc; ++i) {
+            if (strcmp(argv[i], "--threads") == 0) {
+                if (!parseThreadCount(i + 1 < argc ? argv[++i] : nullptr,
+                                      threads)) {
+                    return 1;
+                }
+            } else if (strcmp(argv[i], "--bin-width") == 0 && i + 1 < argc) {
+                binWidth = atof(argv[++i]);
+                if (!(binWidth >= MIN_BIN_WIDTH && binWidth <= MAX_BIN_WIDTH)) {
+                    cerr << "--bin-width must be between " << MIN_BIN_WIDTH
+                         << " and " << MAX_BIN_WIDTH << ".\n";
+                    return 1;
+                }
+            } else if (strcmp(argv[i], "--by") == 0 && i + 1 < argc) {
+                const char* by = argv[++i];
+                if (strcmp(by, "course") == 0) {
+                    grouping = GROUP_BY_COURSE;
+                } else if (strcmp(by, "department") == 0) {
+                    grouping = GROUP_BY_DEPARTMENT;
+                } else if (strcmp(by, "term") == 0) {
+                    grouping = GROUP_BY_TERM;
+                } else {
+                    cerr << "--by must be course, department or term.\n";
+                    return 1;
+                }
+            } else {
+                inputPath = argv[i];
+            }
+        }
+
+        if (strcmp(inputPath, "-") != 0) {
+            ifstream file(inputPath);
+            if (!file) {
+                cerr << "Could not open batch input file: " << inputPath << "\n";
+                return 1;
+            }
+            return runDistributionMode(file, cout, grouping, binWidth, threads);
+        }
+        return runDistributionMode(cin, cout, grouping, binWidth, threads);
+    }
+
+    // "--transcripts [file] [--format text|json] [--threads N]" reads the
+    // same input as batch mode and writes every student's transcript (see
+    // "TRANSCRIPTS").
+    if (argc >= 2 && strcmp(argv[1], "--transcripts") == 0) {
+        ios::sync_with_stdio(false);
+
+        const char* inputPath = "-";
+        TranscriptFormat format = TRANSCRIPT_TEXT;
+        unsigned threads = defaultThreadCount();
+        for (int i = 2; i < argc; ++i) {
+            if (strcmp(argv[i], "--threads") == 0) {
+                if (!parseThreadCount(i + 1 < argc ? argv[++i] : nullptr,
+                                      threads)) {
+                    return 1;
+                }
+            } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+                const char* name = argv[++i];
+                if (strcmp(name, "text") == 0) {
+                    format = TRANSCRIPT_TEXT;
+                } else if (strcmp(name, "json") == 0) {
+                    format = TRANSCRIPT_JSON;
+                } else {
+                    cerr << "--format must be text or json.\n";
+                    return 1;
+                }
+            } else {
+                inputPath = argv[i];
+            }
+        }
+
+        if (strcmp(inputPath, "-") != 0) {
+            ifstream file(inputPath);
+            if (!file) {
+                cerr << "Could not open batch input file: " << inputPath << "\n";
+                return 1;
+            }
+            return runTranscriptMode(file, cout, format, threads);
+        }
+        return runTranscriptMode(cin, cout, format, threads);
+    }
+
+    // "--rank students.csv [--threads N]" loads a cohort in the batch input
+    // format and answers class-rank queries from stdin (see "CLASS RANK").
+    if (argc >= 3 && strcmp(argv[1], "--rank") == 0) {
+        ios::sync_with_stdio(false);
+
+        unsigned threads = defaultThreadCount();
+        if (argc >= 4 && strcmp(argv[3], "--threads") == 0 &&
+            !parseThreadCount(argc >= 5 ? argv[4] : nullptr, threads)) {
+            return 1;
+        }
+
+        ifstream file(argv[2]);
+        if (!file) {
+            cerr << "Could not open batch input file: " << argv[2] << "\n";
+            return 1;
+        }
+        return runRankMode(file, cin, cout, threads);
+    }
+
+    // "--export-columns data out" writes the gradebook in "data" (snapshot
+    // plus journal) as a columnar file for analytics tools, and
+    // "--import-columns in data" makes "data" hold the courses of such a
+    // file instead (see "COLUMNAR EXPORT").
+    if (argc >= 4 && (strcmp(argv[1], "--export-columns") == 0 ||
+                      strcmp(argv[1], "--import-columns") == 0)) {
+        bool exporting = strcmp(argv[1], "--export-columns") == 0;
+        const char* dataPath = exporting ? argv[2] : argv[3];
+        const char* columnsPath = exporting ? argv[3] : argv[2];
+
+        Gradebook book;
+        Journal journal;
+        string error;
+        if (!openGradebook(dataPath, book, journal, error)) {
+            cerr << "Could not load " << dataPath << ": " << error << "\n";
+            return 1;
+        }
+
+        if (exporting) {
+            if (!exportColumnar(columnsPath, book, error)) {
+                cerr << "Export failed: " << error << "\n";
+                return 1;
+            }
+            return 0;
+        }
+
+        if (!importColumnar(columnsPath, book, error)) {
+            cerr << "Import failed: " << error << "\n";
+            return 1;
+        }
+        // The journal only describes changes to the old courses.
+        if (!checkpointGradebook(book, error)) {
+            cerr << "Save failed: " << error << "\n";
+            return 1;
+        }
+        cout << "Imported " << book.courses.size() << " course(s) into "
+             << dataPath << ".\n";
+        return 0;
+    }
+
+    // "--serve socket [--data path]" keeps the gradebook loaded and answers
+    // the same commands for local clients (see "DAEMON MODE"), and
+    // "--client socket [command ...]" sends commands to such a server.
+    if (argc >= 3 && strcmp(argv[1], "--serve") == 0) {
+        Gradebook book;
+        Journal journal;
+        UndoHistory history;
+        string error;
+        if (argc >= 5 && strcmp(argv[3], "--data") == 0 &&
+            !openGradebook(argv[4], book, journal, error)) {
+            cerr << "Could not load " << argv[4] << ": " << error << "\n";
+            return 1;
+        }
+        book.history = &history;
+
+        int status = runServer(argv[2], book);
+        // After a failed journal write the answers said ERR, so the
+        // changes behind them must not reach the snapshot either.
+        if (status != 0) {
+            return status;
+        }
+        if (!checkpointGradebook(book, error)) {
+            cerr << "Save failed: " << error << "\n";
+            return 1;
+        }
+        return status;
+    }
+    if (argc >= 2 && strcmp(argv[1], "--client") == 0) {
+        return runClient(argc, argv);
+    }
+
+    // "--script [file] [--data path]" answers one command per line instead
+    // of showing the menu (see "SCRIPT MODE"). Without a file name (or with
+    // "-") the commands are read from stdin.
+    if (argc >= 2 && strcmp(argv[1], "--script") == 0) {
+        ios::sync_with_stdio(false);
+
+        const char* inputPath = "-";
+        const char* dataPath = nullptr;
+        for (int i = 2; i < argc; ++i) {
+            if (strcmp(argv[i], "--data") == 0 && i + 1 < argc) {
+                dataPath = argv[++i];
+            } else {
+                inputPath = argv[i];
+            }
+        }
+
+        Gradebook book;
+        Journal journal;
+        UndoHistory history;
+        string error;
+        if (dataPath != nullptr &&
+            !openGradebook(dataPath, book, journal, error)) {
+            cerr << "Could not load " << dataPath << ": " << error << "\n";
+            return 1;
+        }
+        book.history = &history;
+
+        int status = 0;
+        if (strcmp(inputPath, "-") != 0) {
+            ifstream file(inputPath);
+            if (!file) {
+                cerr << "Could not open script file: " << inputPath << "\n";
+                return 1;
+            }
+            status = runScriptMode(file, cout, book);
+        } else {
+            status = runScriptMode(cin, cout, book);
+        }
+
+        // After a failed journal write the answers said ERR, so the
+        // changes behind them must not reach the snapshot either.
+        if (status == 1) {
+            return 1;
+        }
+        if (!checkpointGradebook(book, error)) {
+            cerr << "Save failed: " << error << "\n";
+            return 1;
+        }
+        return status;
+    }
+
+    Gradebook book;           // holds all the courses
+    Journal journal;          // logs every change when "--data" is used
+    UndoHistory history;      // lets the user undo and redo changes
     bool running = true;      // controls the main loop
 
+    // "--data file" loads that snapshot (plus its journal) at startup, logs
+    // every change to "file.journal" and saves the snapshot on exit.
+    if (argc >= 3 && strcmp(argv[1], "--data") == 0) {
+        string error;
+        if (!openGradebook(argv[2], book, journal, error)) {
+            cerr << "Could not load " << argv[2] << ": " << error << "\n";
+            return 1;
+        }
+        if (!book.courses.empty()) {
+            cout << "Loaded " << book.courses.size() << " course(s) from "
+                 << argv[2] << ".\n\n";
+        }
+    }
+    // Attached after loading, so replaying the journal cannot be undone.
+    book.history = &history;
+
     while (running) {
         // Show the main menu options to the user.
         showMainMenu();
 
-        // Note: max choice is now 8 because we added new features.
-        int choice = readIntInRange("Enter your choice: ", 0, 8);
+        // Note: max choice is now 14 because we added new features.
+        int choice = readIntInRange("Enter your choice: ", 0, 14);
 
         cout << "\n"; // blank line for readability
 
         switch (choice) {
             case 1:
-                addCourse(courses, nextCourseId);
+                addCourse(book);
                 break;
             case 2:
-                listCoursesSummary(courses);
+                listCoursesSummary(book.courses);
                 break;
             case 3:
-                addAssignmentToCourse(courses);
+                addAssignmentToCourse(book);
                 break;
             case 4:
-                showCourseDetails(courses);
+                showCourseDetails(book.courses);
                 break;
             case 5:
-                showOverallGPA(courses);
+                showOverallGPA(book.courses);
                 break;
             case 6:
-                whatIfScenario(courses);
+                whatIfScenario(book.courses);
                 break;
             case 7:
-                manageCoursesAndAssignments(courses);
+                manageCoursesAndAssignments(book);
                 break;
             case 8:
-                showGradeDistribution(courses);
+                showGradeDistribution(book);
+                break;
+            case 9:
+                minimumScoreSolver(book.courses);
+                break;
+            case 10:
+                saveGradebookMenu(book);
+                break;
+            case 11:
+                loadGradebookMenu(book);
+                break;
+            case 12:
+                undoMenu(book);
+                break;
+            case 13:
+                redoMenu(book);
+                break;
+            case 14:
+                forecastMenu(book.courses);
                 break;
             case 0:
+                if (!book.dataPath.empty()) {
+                    string error;
+                    if (checkpointGradebook(book, error)) {
+                        cout << "Saved " << book.courses.size()
+                             << " course(s) to " << book.dataPath << ".\n";
+                    } else {
+                        cout << "Save failed: " << error << "\n";
+                    }
+                }
                 cout << "Exiting GPA & Grade Calculator. Goodbye!\n";
                 running = false;
                 break;
@@ -142,6 +1796,9 @@ int main() {
                 break;
         }
 
+        // Make sure every change from this screen is safely on disk.
+        syncGradebook(book);
+
         if (running) {
             // Let the user read the output before showing the menu again.
             pauseForUser();
@@ -223,737 +1880,9808 @@ double readDoubleInRange(const string& prompt, double minValue, double maxValue)
 }
 
 // ============================================================================
-// MENUS
+// COURSE STORE (SLOT MAP)
 // ============================================================================
 
-// Main menu.
-void showMainMenu() {
-    cout << "==========================================\n";
-    cout << "         GPA & Grade Calculator\n";
-    cout << "==========================================\n";
-    cout << "1. Add a new course\n";
-    cout << "2. List all courses (summary)\n";
-    cout << "3. Add an assignment to a course\n";
-    cout << "4. Show details for one course\n";
-    cout << "5. Show overall GPA\n";
-    cout << "6. What-if grade scenario\n";
-    cout << "7. Manage courses & assignments (edit/delete)\n";
-    cout << "8. Grade distribution report\n";
-    cout << "0. Exit\n";
+// True if a course id is inside the range the menus accept.
+bool isValidCourseId(int id) {
+    return id >= MIN_COURSE_ID && id <= MAX_COURSE_ID;
 }
 
-// Sub-menu for editing and deleting things.
-void manageCoursesAndAssignments(vector<Course>& courses) {
-    if (courses.empty()) {
-        cout << "No courses available yet.\n";
-        return;
+CourseStore::CourseStore() : freeHead(NO_COURSE.slot) {}
+
+CourseHandle CourseStore::insert(const Course& course) {
+    if (!isValidCourseId(course.id)) {
+        return NO_COURSE;
+    }
+    size_t idIndex = static_cast<size_t>(course.id);
+    if (idIndex < byId.size() && byId[idIndex].generation != 0) {
+        return NO_COURSE; // id already in use
     }
 
-    bool inSubMenu = true;
-    while (inSubMenu) {
-        cout << "==========================================\n";
-        cout << "   Manage Courses & Assignments\n";
-        cout << "==========================================\n";
-        cout << "1. Rename a course\n";
-        cout << "2. Change course credit hours\n";
-        cout << "3. Edit an assignment's scores\n";
-        cout << "4. Delete an assignment from a course\n";
-        cout << "5. Delete a course\n";
-        cout << "0. Return to main menu\n";
-
-        int choice = readIntInRange("Enter your choice: ", 0, 5);
-        cout << "\n";
-
-        switch (choice) {
-            case 1:
-                renameCourse(courses);
-                break;
-            case 2:
-                changeCourseCreditHours(courses);
-                break;
-            case 3:
-                editAssignmentInCourse(courses);
-                break;
-            case 4:
-                deleteAssignmentFromCourse(courses);
-                break;
-            case 5:
-                deleteCourse(courses);
-                // After deleting a course, the vector changes size.
-                // That's okay; we can stay in the sub-menu.
-                break;
-            case 0:
-                inSubMenu = false;
-                break;
-            default:
-                cout << "Unknown choice.\n";
-                break;
-        }
-
-        if (inSubMenu) {
-            pauseForUser();
-            cout << "\n";
-        }
+    // Reuse a free slot if there is one, otherwise make a new slot.
+    uint32_t slotNumber;
+    if (freeHead != NO_COURSE.slot) {
+        slotNumber = freeHead;
+        freeHead = slots[slotNumber].denseIndex;
+    } else {
+        slotNumber = static_cast<uint32_t>(slots.size());
+        Slot fresh;
+        fresh.generation = 1;
+        fresh.denseIndex = 0;
+        slots.push_back(fresh);
     }
-}
-
-// ============================================================================
-// COURSE MANAGEMENT
-// ============================================================================
-//5
-// Adds a new course with name and credit hours.
-void addCourse(vector<Course>& courses, int& nextCourseId) {
-    Course c;
-
-    c.id = nextCourseId;
-    nextCourseId++;  // increment for next course
 
-    cout << "Enter course name (for example, COSC 3345): ";
-    getline(cin, c.name);
-
-    c.creditHours = readDoubleInRange(
-        "Enter credit hours (e.g., 3 or 4): ", 0.5, 6.0);
+    Slot& slot = slots[slotNumber];
+    slot.denseIndex = static_cast<uint32_t>(dense.size());
+    dense.push_back(course);
+    denseToSlot.push_back(slotNumber);
 
-    c.work = vector<Assignment>();
+    CourseHandle handle;
+    handle.slot = slotNumber;
+    handle.generation = slot.generation;
 
-    courses.push_back(c);
+    if (idIndex >= byId.size()) {
+        byId.resize(idIndex + 1, NO_COURSE);
+    }
+    byId[idIndex] = handle;
 
-    cout << "Course added with id " << c.id << ".\n";
+    return handle;
 }
 
-// Finds course index by ID, or returns -1.
-int findCourseIndexById(const vector<Course>& courses, int id) {
-    for (size_t i = 0; i < courses.size(); ++i) {
-        if (courses[i].id == id) {
-            return static_cast<int>(i);
-        }
+Course* CourseStore::get(CourseHandle handle) {
+    if (handle.slot >= slots.size() ||
+        slots[handle.slot].generation != handle.generation) {
+        return nullptr;
     }
-    return -1;
+    return &dense[slots[handle.slot].denseIndex];
 }
 
-// Lists summary info about each course.
-void listCoursesSummary(const vector<Course>& courses) {
-    if (courses.empty()) {
-        cout << "No courses have been added yet.\n";
-        return;
+const Course* CourseStore::get(CourseHandle handle) const {
+    if (handle.slot >= slots.size() ||
+        slots[handle.slot].generation != handle.generation) {
+        return nullptr;
     }
+    return &dense[slots[handle.slot].denseIndex];
+}
 
-    cout << "Courses summary:\n";
-    cout << "------------------------------------------------------------\n";
-    for (const Course& c : courses) {
-        cout << "ID: " << c.id
-             << " | Name: " << c.name
-             << " | Credits: " << c.creditHours;
-
-        if (!c.work.empty()) {
-            double percent = calculateCoursePercentage(c);
-            string letter = percentageToLetter(percent);
-
-            cout << " | Grade: " << fixed << setprecision(2)
-                 << percent << "% (" << letter << ")";
-        } else {
-            cout << " | Grade: N/A (no assignments yet)";
-        }
-
-        cout << "\n";
+CourseHandle CourseStore::handleOf(int id) const {
+    if (!isValidCourseId(id) || static_cast<size_t>(id) >= byId.size()) {
+        return NO_COURSE;
     }
-    cout << "------------------------------------------------------------\n";
+    return byId[static_cast<size_t>(id)];
 }
 
-// ============================================================================
-// ASSIGNMENT MANAGEMENT
-// ============================================================================
-
-// Adds an assignment to a specific course.
-void addAssignmentToCourse(vector<Course>& courses) {
-    if (courses.empty()) {
-        cout << "There are no courses yet. Add a course first.\n";
-        return;
+int CourseStore::indexOf(int id) const {
+    CourseHandle handle = handleOf(id);
+    if (handle.generation == 0) {
+        return -1;
     }
+    return static_cast<int>(slots[handle.slot].denseIndex);
+}
 
-    listCoursesSummary(courses);
-
-    int id = readIntInRange(
-        "Enter the ID of the course to add an assignment to: ",
-        1, 1000000);
-
-    int index = findCourseIndexById(courses, id);
-    if (index == -1) {
-        cout << "No course found with that ID.\n";
-        return;
+bool CourseStore::erase(CourseHandle handle) {
+    if (get(handle) == nullptr) {
+        return false;
     }
 
-    Course& c = courses[index];
-    Assignment a;
+    Slot& slot = slots[handle.slot];
+    uint32_t hole = slot.denseIndex;
+    uint32_t last = static_cast<uint32_t>(dense.size() - 1);
 
-    cout << "Enter assignment name (for example, Exam 1): ";
-    getline(cin, a.name);
+    byId[static_cast<size_t>(dense[hole].id)] = NO_COURSE;
 
-    a.max = readDoubleInRange(
-        "Enter maximum points for this assignment: ", 1.0, 10000.0);
+    // Move the last course into the hole so "dense" stays packed.
+    if (hole != last) {
+        dense[hole] = std::move(dense[last]);
+        denseToSlot[hole] = denseToSlot[last];
+        slots[denseToSlot[hole]].denseIndex = hole;
+    }
+    dense.pop_back();
+    denseToSlot.pop_back();
 
-    a.earned = readDoubleInRange(
-        "Enter points earned on this assignment: ", 0.0, a.max);
+    // Retire the slot: old handles stop matching and the slot is reusable.
+    slot.generation++;
+    if (slot.generation == 0) {
+        slot.generation = 1; // skip 0, it means "no course"
+    }
+    slot.denseIndex = freeHead;
+    freeHead = handle.slot;
 
-    c.work.push_back(a);
+    return true;
+}
 
-    cout << "Assignment added to course '" << c.name << "'.\n";
+void CourseStore::clear() {
+    dense.clear();
+    denseToSlot.clear();
+    slots.clear();
+    byId.clear();
+    freeHead = NO_COURSE.slot;
 }
 
 // ============================================================================
-// GRADE CALCULATIONS
+// NAME POOL
 // ============================================================================
+// Course and assignment names are interned: the pool keeps one copy of
+// each distinct name and hands out 32-bit ids with a reference count.
+//   * Text is packed into 64 KB arena chunks, each name followed by '\0'.
+//     When a name's last reference goes away its bytes go on a free list
+//     for that size and are reused by the next name of the same size, so
+//     deleting courses and assignments gives the memory back to the pool.
+//   * Entries (text pointer, length, hash, references) sit in pages of 4096
+//     that are never moved, and ids of freed entries are reused.
+//   * An open-addressing hash table (linear probing) maps text to ids.
+// Reading a name only follows pointers that never change while someone
+// holds the name, so it takes no lock.
+
+NamePool::NamePool()
+    : pages(new Entry*[MAX_PAGES]()), nextId(1), liveNames(0),
+      chunkPos(nullptr), chunkLeft(0), reservedBytes(0) {
+    // Id 0 is the empty name and is never freed.
+    pages[0] = new Entry[PAGE_SIZE];
+    pages[0][0].text = "";
+    pages[0][0].length = 0;
+    pages[0][0].hash = 0;
+    pages[0][0].refs = 1;
+    slots.assign(1024, 0);
+}
 
-// Calculates the overall percentage for a course as the average percentage
-// across its assignments.
-
-//6
-double calculateCoursePercentage(const Course& course) {
-    if (course.work.empty()) {
-        return 0.0; // caller should check emptiness
+NamePool::~NamePool() {
+    for (uint32_t p = 0; p < MAX_PAGES && pages[p] != nullptr; ++p) {
+        delete[] pages[p];
     }
-
-    double sumPercentages = 0.0;
-
-    for (const Assignment& a : course.work) {
-        double assignmentPercent = (a.earned / a.max) * 100.0;
-        sumPercentages += assignmentPercent;
+    delete[] pages;
+    for (char* chunk : chunks) {
+        delete[] chunk;
     }
+}
 
-    double averagePercent = sumPercentages /
-        static_cast<double>(course.work.size());
+// FNV-1a, the same hash the snapshot checksum uses (32-bit version).
+static uint32_t hashName(const char* text, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= static_cast<unsigned char>(text[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
 
-    return averagePercent;
+// Slot holding the name, or the empty slot where it would go.
+size_t NamePool::findSlot(const char* text, size_t length, uint32_t hash) const {
+    size_t mask = slots.size() - 1;
+    size_t slot = hash & mask;
+    while (slots[slot] != 0) {
+        const Entry& e = entry(slots[slot]);
+        if (e.hash == hash && e.length == length &&
+            memcmp(e.text, text, length) == 0) {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
 }
 
-// Maps percentage to letter grade.
-string percentageToLetter(double percent) {
-    if (percent >= 90.0) {
-        return "A";
-    } else if (percent >= 80.0) {
-        return "B";
-    } else if (percent >= 70.0) {
-        return "C";
-    } else if (percent >= 60.0) {
-        return "D";
-    } else {
-        return "F";
+void NamePool::growSlots() {
+    vector<uint32_t> old;
+    old.swap(slots);
+    slots.assign(old.size() * 2, 0);
+    size_t mask = slots.size() - 1;
+    for (uint32_t id : old) {
+        if (id != 0) {
+            size_t slot = entry(id).hash & mask;
+            while (slots[slot] != 0) {
+                slot = (slot + 1) & mask;
+            }
+            slots[slot] = id;
+        }
     }
 }
 
-// Maps letter grade to grade points on a 4.0 scale.
-double letterToGradePoints(const string& letter) {
-    if (letter == "A") {
-        return 4.0;
-    } else if (letter == "B") {
-        return 3.0;
-    } else if (letter == "C") {
-        return 2.0;
-    } else if (letter == "D") {
-        return 1.0;
-    } else {
-        return 0.0; // F or anything else
+// Takes an id out of the hash table and shifts the entries after it back
+// so every remaining name can still be reached from its home slot.
+void NamePool::removeSlot(uint32_t id) {
+    const Entry& removed = entry(id);
+    size_t mask = slots.size() - 1;
+    size_t hole = findSlot(removed.text, removed.length, removed.hash);
+    size_t next = (hole + 1) & mask;
+    while (slots[next] != 0) {
+        size_t home = entry(slots[next]).hash & mask;
+        // Move the entry into the hole unless its home lies in (hole, next].
+        bool stays = hole <= next ? (home > hole && home <= next)
+                                  : (home > hole || home <= next);
+        if (!stays) {
+            slots[hole] = slots[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
     }
+    slots[hole] = 0;
 }
 
-// ============================================================================
-// COURSE DETAILS + GPA
-// ============================================================================
+uint32_t NamePool::newEntryId() {
+    if (!freeIds.empty()) {
+        uint32_t id = freeIds.back();
+        freeIds.pop_back();
+        return id;
+    }
+    uint32_t page = nextId >> PAGE_BITS;
+    if (page >= MAX_PAGES) {
+        throw bad_alloc();
+    }
+    if (pages[page] == nullptr) {
+        pages[page] = new Entry[PAGE_SIZE];
+    }
+    return nextId++;
+}
 
-// Shows detailed information about one course.
-void showCourseDetails(const vector<Course>& courses) {
-    if (courses.empty()) {
-        cout << "No courses available.\n";
-        return;
+char* NamePool::allocateText(size_t bytes) {
+    if (bytes > SMALL_TEXT_BYTES) {
+        char* block = new char[bytes];
+        chunks.push_back(block);
+        reservedBytes += bytes;
+        return block;
     }
 
-    listCoursesSummary(courses);
+    vector<char*>& reuse = freeBlocks[bytes / 8 - 1];
+    if (!reuse.empty()) {
+        char* block = reuse.back();
+        reuse.pop_back();
+        return block;
+    }
 
-    int id = readIntInRange(
-        "Enter the ID of the course to view details: ",
-        1, 1000000);
+    if (chunkLeft < bytes) {
+        chunkPos = new char[CHUNK_BYTES];
+        chunkLeft = CHUNK_BYTES;
+        chunks.push_back(chunkPos);
+        reservedBytes += CHUNK_BYTES;
+    }
+    char* block = chunkPos;
+    chunkPos += bytes;
+    chunkLeft -= bytes;
+    return block;
+}
 
-    int index = findCourseIndexById(courses, id);
-    if (index == -1) {
-        cout << "No course found with that ID.\n";
+void NamePool::freeText(const char* text, size_t bytes) {
+    char* block = const_cast<char*>(text);
+    if (bytes <= SMALL_TEXT_BYTES) {
+        freeBlocks[bytes / 8 - 1].push_back(block);
         return;
     }
-
-    const Course& c = courses[index];
-
-    cout << "====================================================\n";
-    cout << "Course details for: " << c.name << " (ID " << c.id << ")\n";
-    cout << "Credit hours: " << c.creditHours << "\n";
-
-    if (c.work.empty()) {
-        cout << "No assignments have been added to this course yet.\n";
-    } else {
-        cout << left << setw(25) << "Name"
-             << setw(15) << "Earned"
-             << setw(15) << "Max"
-             << setw(15) << "Percent"
-             << "\n";
-
-        cout << "----------------------------------------------------\n";
-
-        for (const Assignment& a : c.work) {
-            double percent = (a.earned / a.max) * 100.0;
-            cout << left << setw(25) << a.name
-                 << setw(15) << a.earned
-                 << setw(15) << a.max
-                 << setw(15) << fixed << setprecision(2) << percent
-                 << "\n";
+    // Big blocks are given back to the system right away.
+    for (size_t i = chunks.size(); i-- > 0;) {
+        if (chunks[i] == block) {
+            chunks[i] = chunks.back();
+            chunks.pop_back();
+            break;
         }
-
-        double coursePercent = calculateCoursePercentage(c);
-        string letter = percentageToLetter(coursePercent);
-
-        cout << "----------------------------------------------------\n";
-        cout << "Course average: " << fixed << setprecision(2)
-             << coursePercent << "% (" << letter << ")\n";
     }
+    delete[] block;
+    reservedBytes -= bytes;
+}
 
-    cout << "====================================================\n";
+// Text plus its '\0', rounded up to a multiple of 8.
+static size_t nameBlockBytes(size_t length) {
+    return (length + 1 + 7) & ~static_cast<size_t>(7);
 }
 
-// Computes overall GPA across all courses using credit-hour weighting.
-double calculateOverallGPA(const vector<Course>& courses) {
-    double totalQualityPoints = 0.0;  // sum of (gradePoints * creditHours)
-    double totalCredits = 0.0;        // sum of credit hours
+uint32_t NamePool::intern(const char* text, size_t length) {
+    if (length == 0) {
+        return 0;
+    }
+    if (length > 0xFFFFFFFFu) {
+        throw bad_alloc();
+    }
 
-    for (const Course& c : courses) {
-        if (c.work.empty()) {
-            continue; // skip ungraded courses
-        }
+    uint32_t hash = hashName(text, length);
+    lock_guard<mutex> guard(lock);
 
-        double coursePercent = calculateCoursePercentage(c);
-        string letter = percentageToLetter(coursePercent);
-        double gradePoints = letterToGradePoints(letter);
+    size_t slot = findSlot(text, length, hash);
+    if (slots[slot] != 0) {
+        entry(slots[slot]).refs.fetch_add(1, memory_order_relaxed);
+        return slots[slot];
+    }
 
-        totalQualityPoints += gradePoints * c.creditHours;
-        totalCredits += c.creditHours;
+    uint32_t id = newEntryId();
+    char* copy = allocateText(nameBlockBytes(length));
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+
+    Entry& e = entry(id);
+    e.text = copy;
+    e.length = static_cast<uint32_t>(length);
+    e.hash = hash;
+    e.refs.store(1, memory_order_relaxed);
+    slots[slot] = id;
+    liveNames++;
+
+    // Keep the table at most half full so probes stay short.
+    if (liveNames * 2 > slots.size()) {
+        growSlots();
     }
+    return id;
+}
 
-    if (totalCredits == 0.0) {
-        return 0.0; // no graded courses yet
+bool NamePool::find(const char* text, size_t length, uint32_t& id) const {
+    if (length == 0) {
+        id = 0;
+        return true;
     }
+    uint32_t hash = hashName(text, length);
+    lock_guard<mutex> guard(lock);
+    id = slots[findSlot(text, length, hash)];
+    return id != 0;
+}
 
-    return totalQualityPoints / totalCredits;
+void NamePool::retain(uint32_t id) {
+    if (id != 0) {
+        entry(id).refs.fetch_add(1, memory_order_relaxed);
+    }
 }
 
-// Shows overall GPA in a user-friendly way.
-void showOverallGPA(const vector<Course>& courses) {
-    if (courses.empty()) {
-        cout << "No courses available yet.\n";
+void NamePool::release(uint32_t id) {
+    if (id == 0) {
         return;
     }
 
-    double gpa = calculateOverallGPA(courses);
-
-    // Check if there is at least one course with assignments.
-    bool hasGradedCourse = false;
-    for (const Course& c : courses) {
-        if (!c.work.empty()) {
-            hasGradedCourse = true;
-            break;
+    // Most releases are not the last one and need no lock.
+    Entry& e = entry(id);
+    uint32_t refs = e.refs.load(memory_order_relaxed);
+    while (refs > 1) {
+        if (e.refs.compare_exchange_weak(refs, refs - 1,
+                                         memory_order_acq_rel)) {
+            return;
         }
     }
 
-    if (!hasGradedCourse) {
-        cout << "No graded courses yet. Add assignments first.\n";
+    // Possibly the last reference: going to zero and freeing happen under
+    // the lock, so intern() can never hand out an entry being freed.
+    lock_guard<mutex> guard(lock);
+    if (e.refs.fetch_sub(1, memory_order_acq_rel) != 1) {
         return;
     }
-
-    cout << "==========================================\n";
-    cout << "Overall GPA (4.0 scale): " << fixed << setprecision(2)
-         << gpa << "\n";
-    cout << "==========================================\n";
+    removeSlot(id);
+    freeText(e.text, nameBlockBytes(e.length));
+    e.text = nullptr;
+    freeIds.push_back(id);
+    liveNames--;
 }
 
-// ============================================================================
-// WHAT-IF GRADE SCENARIO
-// ============================================================================
-//7
-void whatIfScenario(const vector<Course>& courses) {
-    if (courses.empty()) {
-        cout << "No courses available yet. Add a course first.\n";
-        return;
-    }
-
-    cout << "==========================================\n";
-    cout << "         WHAT-IF GRADE SCENARIO\n";
-    cout << "==========================================\n";
-    cout << "This feature lets you test a hypothetical assignment.\n";
-    cout << "The program will NOT save it. It only shows what would\n";
-    cout << "happen if that assignment existed.\n\n";
+size_t NamePool::nameCount() const {
+    lock_guard<mutex> guard(lock);
+    return liveNames;
+}
 
-    listCoursesSummary(courses);
+size_t NamePool::arenaBytes() const {
+    lock_guard<mutex> guard(lock);
+    return reservedBytes;
+}
 
-    int id = readIntInRange(
-        "Enter the ID of the course for the what-if scenario: ",
-        1, 1000000);
+// The one pool every course and assignment name lives in. It is never
+// destroyed, so names in static objects stay valid until the very end.
+NamePool& namePool() {
+    static NamePool* pool = new NamePool();
+    return *pool;
+}
 
-    int index = findCourseIndexById(courses, id);
-    if (index == -1) {
-        cout << "No course found with that ID.\n";
-        return;
-    }
+PooledName::PooledName(const string& text)
+    : id(namePool().intern(text.data(), text.size())) {}
 
-    const Course& originalCourse = courses[index];
+PooledName::PooledName(const char* text)
+    : id(namePool().intern(text, strlen(text))) {}
 
-    cout << "\nYou selected course: " << originalCourse.name
-         << " (ID " << originalCourse.id << ")\n";
-    cout << "Credit hours: " << originalCourse.creditHours << "\n\n";
+PooledName::PooledName(const char* text, size_t length)
+    : id(namePool().intern(text, length)) {}
 
-    bool hasAssignments = !originalCourse.work.empty();
-    if (hasAssignments) {
-        double currentPercent = calculateCoursePercentage(originalCourse);
-        string currentLetter = percentageToLetter(currentPercent);
+PooledName::PooledName(const PooledName& other) : id(other.id) {
+    namePool().retain(id);
+}
 
-        cout << "Current course average: " << fixed << setprecision(2)
-             << currentPercent << "% (" << currentLetter << ")\n";
-    } else {
-        cout << "This course currently has NO assignments.\n";
-        cout << "So its course average is N/A for now.\n";
+PooledName& PooledName::operator=(const PooledName& other) {
+    if (id != other.id) {
+        namePool().retain(other.id);
+        namePool().release(id);
+        id = other.id;
     }
+    return *this;
+}
 
-    double oldGPA = calculateOverallGPA(courses);
-    cout << "Current overall GPA: " << fixed << setprecision(2)
-         << oldGPA << " (on a 4.0 scale)\n\n";
-
-    Assignment hypothetical;
-
-    cout << "Enter a name for the hypothetical assignment\n";
-    cout << "(for example, \"Final Exam\" or \"Big Project\"):\n";
-    getline(cin, hypothetical.name);
-
-    hypothetical.max = readDoubleInRange(
-        "Enter MAXIMUM possible points on this hypothetical assignment: ",
-        1.0, 10000.0);
-
-    hypothetical.earned = readDoubleInRange(
-        "Enter the points you THINK you might earn: ",
-        0.0, hypothetical.max);
-
-    // Create a temporary copy of the courses.
-    vector<Course> tempCourses = courses;
-
-    // Modify only the copied course.
-    Course& tempCourse = tempCourses[index];
-    tempCourse.work.push_back(hypothetical);
-
-    double newCoursePercent = calculateCoursePercentage(tempCourse);
-    string newCourseLetter = percentageToLetter(newCoursePercent);
-    double newGPA = calculateOverallGPA(tempCourses);
+PooledName& PooledName::operator=(PooledName&& other) noexcept {
+    if (this != &other) {
+        namePool().release(id);
+        id = other.id;
+        other.id = 0;
+    }
+    return *this;
+}
 
-    cout << "\n------------------------------------------\n";
-    cout << "RESULTS OF WHAT-IF SCENARIO\n";
-    cout << "Course: " << originalCourse.name << "\n\n";
+PooledName::~PooledName() {
+    namePool().release(id);
+}
 
-    if (hasAssignments) {
-        double oldCoursePercent = calculateCoursePercentage(originalCourse);
-        string oldCourseLetter = percentageToLetter(oldCoursePercent);
+const char* PooledName::c_str() const {
+    return namePool().text(id);
+}
 
-        cout << "Old course average: " << fixed << setprecision(2)
-             << oldCoursePercent << "% (" << oldCourseLetter << ")\n";
-    } else {
-        cout << "Old course average: N/A (no assignments before what-if)\n";
-    }
+size_t PooledName::size() const {
+    return namePool().length(id);
+}
 
-    cout << "New course average WITH hypothetical assignment: "
-         << fixed << setprecision(2) << newCoursePercent
-         << "% (" << newCourseLetter << ")\n\n";
+bool operator==(const PooledName& a, const string& b) {
+    return a.size() == b.size() && memcmp(a.c_str(), b.data(), b.size()) == 0;
+}
 
-    cout << "Old overall GPA: " << fixed << setprecision(2) << oldGPA << "\n";
-    cout << "New overall GPA WITH hypothetical assignment: "
-         << fixed << setprecision(2) << newGPA << "\n";
-    cout << "------------------------------------------\n";
-    cout << "Remember: This change was NOT saved.\n";
-    cout << "It is only a simulation to help you plan.\n";
-    cout << "------------------------------------------\n";
+ostream& operator<<(ostream& out, const PooledName& name) {
+    return out.write(name.c_str(), static_cast<streamsize>(name.size()));
 }
 
 // ============================================================================
-// EDITING / DELETING COURSES AND ASSIGNMENTS
+// MENUS
 // ============================================================================
 
-// Rename a course.
-//8
-void renameCourse(vector<Course>& courses) {
-    if (courses.empty()) {
-        cout << "No courses available.\n";
-        return;
-    }
-
-    listCoursesSummary(courses);
-
-    int id = readIntInRange(
-        "Enter the ID of the course you want to rename: ",
-        1, 1000000);
+// Main menu.
+void showMainMenu() {
+    cout << "==========================================\n";
+    cout << "         GPA & Grade Calculator\n";
+    cout << "==========================================\n";
+    cout << "1. Add a new course\n";
+    cout << "2. List all courses (summary)\n";
+    cout << "3. Add an assignment to a course\n";
+    cout << "4. Show details for one course\n";
+    cout << "5. Show overall GPA\n";
+    cout << "6. What-if grade scenario\n";
+    cout << "7. Manage courses & assignments (edit/delete)\n";
+    cout << "8. Grade distribution report\n";
+    cout << "9. Minimum score needed for each letter grade\n";
+    cout << "10. Save gradebook to a snapshot file\n";
+    cout << "11. Load gradebook from a snapshot file\n";
+    cout << "12. Undo the last change\n";
+    cout << "13. Redo the last undone change\n";
+    cout << "14. Forecast final grades (simulation)\n";
+    cout << "0. Exit\n";
+}
 
-    int index = findCourseIndexById(courses, id);
-    if (index == -1) {
-        cout << "No course found with that ID.\n";
+// Sub-menu for editing and deleting things.
+void manageCoursesAndAssignments(Gradebook& book) {
+    if (book.courses.empty()) {
+        cout << "No courses available yet.\n";
         return;
     }
 
-    Course& c = courses[index];
+    bool inSubMenu = true;
+    while (inSubMenu) {
+        cout << "==========================================\n";
+        cout << "   Manage Courses & Assignments\n";
+        cout << "==========================================\n";
+        cout << "1. Rename a course\n";
+        cout << "2. Change course credit hours\n";
+        cout << "3. Edit an assignment's scores\n";
+        cout << "4. Delete an assignment from a course\n";
+        cout << "5. Delete a course\n";
+        cout << "6. Add a grading category to a course\n";
+        cout << "7. Edit a grading category (name, weight, drops)\n";
+        cout << "8. Undo the last change\n";
+        cout << "9. Redo the last undone change\n";
+        cout << "0. Return to main menu\n";
+
+        int choice = readIntInRange("Enter your choice: ", 0, 9);
+        cout << "\n";
+
+        switch (choice) {
+            case 1:
+                renameCourse(book);
+                break;
+            case 2:
+                changeCourseCreditHours(book);
+                break;
+            case 3:
+                editAssignmentInCourse(book);
+                break;
+            case 4:
+                deleteAssignmentFromCourse(book);
+                break;
+            case 5:
+                deleteCourse(book);
+                // After deleting a course, the store changes size.
+                // That's okay; we can stay in the sub-menu.
+                break;
+            case 6:
+                addCategoryToCourse(book);
+                break;
+            case 7:
+                editCategoryInCourse(book);
+                break;
+            case 8:
+                undoMenu(book);
+                break;
+            case 9:
+                redoMenu(book);
+                break;
+            case 0:
+                inSubMenu = false;
+                break;
+            default:
+                cout << "Unknown choice.\n";
+                break;
+        }
+
+        syncGradebook(book);
+
+        if (inSubMenu) {
+            pauseForUser();
+            cout << "\n";
+        }
+    }
+}
+
+// ============================================================================
+// MUTATIONS
+// ============================================================================
+// The only place where courses and assignments are changed. Each function
+// below just fills in a Mutation; applyMutation does the work.
+
+Mutation makeAddCourse(int id, const string& name, double creditHours) {
+    Mutation m;
+    m.type = MUTATION_ADD_COURSE;
+    m.courseId = id;
+    m.index = 0;
+    m.creditHours = creditHours;
+    m.earned = 0.0;
+    m.max = 0.0;
+    m.category = 0;
+    m.extraCredit = false;
+    m.weight = 0.0;
+    m.dropLowest = 0;
+    m.name = name;
+    return m;
+}
+
+Mutation makeAddAssignment(int courseId, const Assignment& a) {
+    Mutation m = makeAddCourse(courseId, a.name.str(), 0.0);
+    m.type = MUTATION_ADD_ASSIGNMENT;
+    m.earned = a.earned;
+    m.max = a.max;
+    m.category = static_cast<uint32_t>(a.category);
+    m.extraCredit = a.extraCredit;
+    return m;
+}
+
+Mutation makeRenameCourse(int courseId, const string& name) {
+    Mutation m = makeAddCourse(courseId, name, 0.0);
+    m.type = MUTATION_RENAME_COURSE;
+    return m;
+}
+
+Mutation makeSetCreditHours(int courseId, double creditHours) {
+    Mutation m = makeAddCourse(courseId, "", creditHours);
+    m.type = MUTATION_SET_CREDIT_HOURS;
+    return m;
+}
+
+Mutation makeEditAssignment(int courseId, size_t index, const Assignment& a) {
+    Mutation m = makeAddAssignment(courseId, a);
+    m.type = MUTATION_EDIT_ASSIGNMENT;
+    m.index = static_cast<uint32_t>(index);
+    return m;
+}
+
+Mutation makeDeleteAssignment(int courseId, size_t index) {
+    Mutation m = makeAddCourse(courseId, "", 0.0);
+    m.type = MUTATION_DELETE_ASSIGNMENT;
+    m.index = static_cast<uint32_t>(index);
+    return m;
+}
+
+Mutation makeDeleteCourse(int courseId) {
+    Mutation m = makeAddCourse(courseId, "", 0.0);
+    m.type = MUTATION_DELETE_COURSE;
+    return m;
+}
+
+Mutation makeAddCategory(int courseId, const string& name, double weight,
+                         int dropLowest) {
+    Mutation m = makeAddCourse(courseId, name, 0.0);
+    m.type = MUTATION_ADD_CATEGORY;
+    m.weight = weight;
+    m.dropLowest = static_cast<uint32_t>(dropLowest);
+    return m;
+}
+
+Mutation makeEditCategory(int courseId, int category, const string& name,
+                          double weight, int dropLowest) {
+    Mutation m = makeAddCategory(courseId, name, weight, dropLowest);
+    m.type = MUTATION_EDIT_CATEGORY;
+    m.index = static_cast<uint32_t>(category);
+    return m;
+}
+
+Mutation makeInsertAssignment(int courseId, size_t index, const Assignment& a) {
+    Mutation m = makeEditAssignment(courseId, index, a);
+    m.type = MUTATION_INSERT_ASSIGNMENT;
+    return m;
+}
+
+Mutation makeDeleteCategory(int courseId, int category) {
+    Mutation m = makeAddCourse(courseId, "", 0.0);
+    m.type = MUTATION_DELETE_CATEGORY;
+    m.index = static_cast<uint32_t>(category);
+    return m;
+}
+
+// True when an assignment change would leave a category with extra credit
+// but no regular score. Extra credit is added on top of the regular
+// average, so on its own it would grade the category as if it were empty
+// (and a course with nothing else at 0%). "m" must already be checked.
+static bool strandsExtraCredit(const Course& c, const Mutation& m) {
+    bool removes = m.type == MUTATION_EDIT_ASSIGNMENT ||
+                   m.type == MUTATION_DELETE_ASSIGNMENT;
+    bool adds = m.type != MUTATION_DELETE_ASSIGNMENT;
+    size_t oldCategory = removes ? c.work.category[m.index] : m.category;
+    size_t touched[2] = {oldCategory, adds ? m.category : oldCategory};
+
+    for (size_t k : touched) {
+        int regular = c.categories[k].count;
+        if (removes && oldCategory == k && c.work.extraCredit[m.index] == 0) {
+            regular--;
+        }
+        if (adds && m.category == k && !m.extraCredit) {
+            regular++;
+        }
+        if (regular > 0) {
+            continue;
+        }
+
+        int extra = adds && m.category == k && m.extraCredit ? 1 : 0;
+        for (size_t i = 0; i < c.work.size(); ++i) {
+            if (c.work.category[i] == k && c.work.extraCredit[i] != 0 &&
+                !(removes && i == m.index)) {
+                extra++;
+            }
+        }
+        if (extra > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// True when a loaded course has extra credit in a category without any
+// regular score, which strandsExtraCredit never lets a change do. The
+// course's totals must be up to date.
+static bool hasStrandedExtraCredit(const Course& c) {
+    for (size_t i = 0; i < c.work.size(); ++i) {
+        if (c.work.extraCredit[i] != 0 &&
+            c.categories[c.work.category[i]].count == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Checks a Mutation against the same limits the menus use, applies it and
+// logs it to the journal (if one is attached). With an undo history
+// attached, the change is also recorded there. On failure "error" says
+// why, and nothing changes - unless the journal could not be written: then
+// the change is made in memory only and book.lastChangeUnlogged is set.
+bool applyMutation(Gradebook& book, const Mutation& m, string& error) {
+    GPA_TIME_METRIC(mutationMetric(m.type));
+    CourseStore& courses = book.courses;
+    book.lastChangeUnlogged = false;
+
+    // Work out how to reverse the change while the old values are here.
+    vector<Mutation> undo;
+    if (book.history != nullptr) {
+        inverseMutations(courses, m, undo);
+    }
+
+    if (m.type == MUTATION_ADD_COURSE) {
+        if (!isValidCourseId(m.courseId)) {
+            error = "course id out of range";
+            return false;
+        }
+        if (!(m.creditHours >= 0.5 && m.creditHours <= 6.0)) {
+            error = "credit hours must be between 0.5 and 6";
+            return false;
+        }
+
+        Course c;
+        c.id = m.courseId;
+        c.name = m.name;
+        c.creditHours = m.creditHours;
+        if (courses.insert(c).generation == 0) {
+            error = "a course with that id already exists";
+            return false;
+        }
+        if (m.courseId >= book.nextCourseId) {
+            book.nextCourseId = m.courseId + 1;
+        }
+    } else {
+        CourseHandle handle = courses.handleOf(m.courseId);
+        Course* c = courses.get(handle);
+        if (c == nullptr) {
+            error = "no course found with that id";
+            return false;
+        }
+
+        bool needsScores = m.type == MUTATION_ADD_ASSIGNMENT ||
+                           m.type == MUTATION_EDIT_ASSIGNMENT ||
+                           m.type == MUTATION_INSERT_ASSIGNMENT;
+        bool needsIndex = m.type == MUTATION_EDIT_ASSIGNMENT ||
+                          m.type == MUTATION_DELETE_ASSIGNMENT;
+
+        if (needsScores && !(m.max >= 1.0 && m.max <= 10000.0)) {
+            error = "max points must be between 1 and 10000";
+            return false;
+        }
+        if (needsScores && !(m.earned >= 0.0 && m.earned <= m.max)) {
+            error = "earned points must be between 0 and max";
+            return false;
+        }
+        if ((needsIndex && m.index >= c->work.size()) ||
+            (m.type == MUTATION_INSERT_ASSIGNMENT && m.index > c->work.size())) {
+            error = "no assignment with that number";
+            return false;
+        }
+        if (needsScores && m.category >= c->categories.size()) {
+            error = "no category with that number";
+            return false;
+        }
+        if ((needsScores || m.type == MUTATION_DELETE_ASSIGNMENT) &&
+            strandsExtraCredit(*c, m)) {
+            error = "extra credit needs a regular assignment in its category";
+            return false;
+        }
+
+        bool isCategory = m.type == MUTATION_ADD_CATEGORY ||
+                          m.type == MUTATION_EDIT_CATEGORY;
+        if (isCategory && m.name.empty()) {
+            error = "category name must not be empty";
+            return false;
+        }
+        if (isCategory && !(m.weight > 0.0 && m.weight <= 100.0)) {
+            error = "category weight must be above 0 and at most 100";
+            return false;
+        }
+        if (isCategory && m.dropLowest > static_cast<uint32_t>(MAX_DROP_LOWEST)) {
+            error = "at most " + to_string(MAX_DROP_LOWEST) +
+                " scores can be dropped";
+            return false;
+        }
+
+        Assignment a;
+        a.name = m.name;
+        a.earned = m.earned;
+        a.max = m.max;
+        a.category = static_cast<int>(m.category);
+        a.extraCredit = m.extraCredit;
+
+        switch (m.type) {
+            case MUTATION_ADD_ASSIGNMENT:
+                addWorkToCourse(*c, a);
+                break;
+            case MUTATION_RENAME_COURSE:
+                if (m.name.empty()) {
+                    error = "course name must not be empty";
+                    return false;
+                }
+                c->name = m.name;
+                break;
+            case MUTATION_SET_CREDIT_HOURS:
+                if (!(m.creditHours >= 0.5 && m.creditHours <= 6.0)) {
+                    error = "credit hours must be between 0.5 and 6";
+                    return false;
+                }
+                c->creditHours = m.creditHours;
+                break;
+            case MUTATION_EDIT_ASSIGNMENT:
+                replaceWorkInCourse(*c, m.index, a);
+                break;
+            case MUTATION_INSERT_ASSIGNMENT:
+                insertWorkInCourse(*c, m.index, a);
+                break;
+            case MUTATION_DELETE_ASSIGNMENT:
+                removeWorkFromCourse(*c, m.index);
+                break;
+            case MUTATION_DELETE_COURSE:
+                book.grades.erase(handle);
+                courses.erase(handle);
+                break;
+            case MUTATION_ADD_CATEGORY: {
+                if (c->categories.size() >= static_cast<size_t>(MAX_CATEGORIES)) {
+                    error = "a course can have at most " +
+                        to_string(MAX_CATEGORIES) + " categories";
+                    return false;
+                }
+                Category cat;
+                cat.name = m.name;
+                cat.weight = m.weight;
+                cat.dropLowest = static_cast<int>(m.dropLowest);
+                c->categories.push_back(cat);
+                break;
+            }
+            case MUTATION_EDIT_CATEGORY: {
+                if (m.index >= c->categories.size()) {
+                    error = "no category with that number";
+                    return false;
+                }
+                Category& cat = c->categories[m.index];
+                bool dropChanged = cat.dropLowest !=
+                    static_cast<int>(m.dropLowest);
+                cat.name = m.name;
+                cat.weight = m.weight;
+                cat.dropLowest = static_cast<int>(m.dropLowest);
+                if (dropChanged) {
+                    rebuildCategory(*c, static_cast<int>(m.index));
+                }
+                break;
+            }
+            case MUTATION_DELETE_CATEGORY: {
+                // Only the newest category can go, so no assignment has to
+                // be renumbered.
+                if (m.index == 0 || m.index + 1 != c->categories.size()) {
+                    error = "only the last added category can be removed";
+                    return false;
+                }
+                for (size_t i = 0; i < c->work.size(); ++i) {
+                    if (c->work.category[i] == m.index) {
+                        error = "that category still has assignments";
+                        return false;
+                    }
+                }
+                c->categories.pop_back();
+                break;
+            }
+            default:
+                error = "unknown change type";
+                return false;
+        }
+
+        // Names and credit hours never change a course's grade.
+        if (m.type != MUTATION_DELETE_COURSE &&
+            m.type != MUTATION_RENAME_COURSE &&
+            m.type != MUTATION_SET_CREDIT_HOURS) {
+            book.grades.update(courses, handle);
+        }
+    }
+
+    // The step is recorded even if logging fails below: the change is in
+    // memory, and later steps are worked out against it.
+    if (book.history != nullptr && !undo.empty()) {
+        book.history->record(m, undo);
+    }
+    if (book.journal != nullptr && !book.journal->append(m)) {
+        book.lastChangeUnlogged = true;
+        error = "the change was made in memory but could not be written "
+                "to the journal";
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// UNDO / REDO
+// ============================================================================
+// Every change made through applyMutation (with an UndoHistory attached)
+// can be undone and redone, many steps deep. Instead of copying the
+// gradebook, each step keeps the change itself plus the changes that
+// reverse it, worked out from the old values just before the change:
+//     add course         -> delete course
+//     add assignment     -> delete that (last) assignment
+//     edit assignment    -> edit it back to the old scores
+//     delete assignment  -> insert the old assignment at the same place
+//     rename / credits / edit category -> set the old value again
+//     add category       -> delete that (last) category
+//     delete course      -> add the course, its categories and assignments
+// So a step costs memory for the change only: one small record for most
+// changes, and the deleted course's own contents for a course delete.
+// Undo and redo go through applyMutation as well, so they are journaled
+// like any other change and survive a crash.
+
+// Steps kept before the oldest ones are forgotten.
+const size_t UNDO_HISTORY_STEPS = 10000;
+
+void UndoHistory::clear() {
+    done.clear();
+    undone.clear();
+}
+
+void UndoHistory::record(const Mutation& change, vector<Mutation>& undo) {
+    done.push_back(HistoryStep());
+    done.back().change = change;
+    done.back().undo.swap(undo);
+    undone.clear();
+    if (done.size() > UNDO_HISTORY_STEPS) {
+        done.pop_front();
+    }
+}
+
+bool UndoHistory::takeUndo(HistoryStep& step) {
+    if (done.empty()) {
+        return false;
+    }
+    step = move(done.back());
+    done.pop_back();
+    return true;
+}
+
+bool UndoHistory::takeRedo(HistoryStep& step) {
+    if (undone.empty()) {
+        return false;
+    }
+    step = move(undone.back());
+    undone.pop_back();
+    return true;
+}
+
+void UndoHistory::keepUndo(HistoryStep& step) {
+    done.push_back(move(step));
+}
+
+void UndoHistory::keepRedo(HistoryStep& step) {
+    undone.push_back(move(step));
+}
+
+// Fills "undo" with the changes that reverse "m" on the courses as they
+// are now. Returns false (and leaves "undo" empty) if "m" cannot apply.
+bool inverseMutations(const CourseStore& courses, const Mutation& m,
+                      vector<Mutation>& undo) {
+    undo.clear();
+    if (m.type == MUTATION_ADD_COURSE) {
+        undo.push_back(makeDeleteCourse(m.courseId));
+        return true;
+    }
+
+    const Course* c = courses.get(courses.handleOf(m.courseId));
+    if (c == nullptr) {
+        return false;
+    }
+
+    switch (m.type) {
+        case MUTATION_ADD_ASSIGNMENT:
+            undo.push_back(makeDeleteAssignment(m.courseId, c->work.size()));
+            break;
+        case MUTATION_RENAME_COURSE:
+            undo.push_back(makeRenameCourse(m.courseId, c->name.str()));
+            break;
+        case MUTATION_SET_CREDIT_HOURS:
+            undo.push_back(makeSetCreditHours(m.courseId, c->creditHours));
+            break;
+        case MUTATION_EDIT_ASSIGNMENT:
+            if (m.index >= c->work.size()) {
+                return false;
+            }
+            undo.push_back(makeEditAssignment(m.courseId, m.index,
+                                              c->work[m.index]));
+            break;
+        case MUTATION_INSERT_ASSIGNMENT:
+            undo.push_back(makeDeleteAssignment(m.courseId, m.index));
+            break;
+        case MUTATION_DELETE_ASSIGNMENT:
+            if (m.index >= c->work.size()) {
+                return false;
+            }
+            undo.push_back(makeInsertAssignment(m.courseId, m.index,
+                                                c->work[m.index]));
+            break;
+        case MUTATION_DELETE_COURSE: {
+            // Rebuild the course from scratch: the course itself, its first
+            // category as it is now, the other categories, then the
+            // regular assignments in their current order. Extra credit
+            // needs a regular score in its category first, so it is
+            // inserted back at its old place afterwards (in ascending
+            // order, so each lands where it was).
+            undo.push_back(makeAddCourse(c->id, c->name.str(), c->creditHours));
+            for (size_t i = 0; i < c->categories.size(); ++i) {
+                const Category& cat = c->categories[i];
+                if (i == 0) {
+                    undo.push_back(makeEditCategory(c->id, 0, cat.name,
+                                                    cat.weight, cat.dropLowest));
+                } else {
+                    undo.push_back(makeAddCategory(c->id, cat.name, cat.weight,
+                                                   cat.dropLowest));
+                }
+            }
+            for (size_t i = 0; i < c->work.size(); ++i) {
+                if (c->work.extraCredit[i] == 0) {
+                    undo.push_back(makeAddAssignment(c->id, c->work[i]));
+                }
+            }
+            for (size_t i = 0; i < c->work.size(); ++i) {
+                if (c->work.extraCredit[i] != 0) {
+                    undo.push_back(makeInsertAssignment(c->id, i, c->work[i]));
+                }
+            }
+            break;
+        }
+        case MUTATION_ADD_CATEGORY:
+            undo.push_back(makeDeleteCategory(
+                m.courseId, static_cast<int>(c->categories.size())));
+            break;
+        case MUTATION_EDIT_CATEGORY: {
+            if (m.index >= c->categories.size()) {
+                return false;
+            }
+            const Category& cat = c->categories[m.index];
+            undo.push_back(makeEditCategory(m.courseId, static_cast<int>(m.index),
+                                            cat.name, cat.weight,
+                                            cat.dropLowest));
+            break;
+        }
+        case MUTATION_DELETE_CATEGORY: {
+            if (m.index >= c->categories.size()) {
+                return false;
+            }
+            const Category& cat = c->categories[m.index];
+            undo.push_back(makeAddCategory(m.courseId, cat.name, cat.weight,
+                                           cat.dropLowest));
+            break;
+        }
+        default:
+            return false;
+    }
+    return true;
+}
+
+// A short description of a change, e.g. "delete course 3".
+string describeMutation(const Mutation& m) {
+    string course = "course " + to_string(m.courseId);
+    string item = to_string(m.index + 1);
+    switch (m.type) {
+        case MUTATION_ADD_COURSE:
+            return "add " + course + " (" + m.name + ")";
+        case MUTATION_ADD_ASSIGNMENT:
+            return "add assignment " + m.name + " to " + course;
+        case MUTATION_RENAME_COURSE:
+            return "rename " + course + " to " + m.name;
+        case MUTATION_SET_CREDIT_HOURS:
+            return "change credit hours of " + course;
+        case MUTATION_EDIT_ASSIGNMENT:
+            return "edit assignment " + item + " of " + course;
+        case MUTATION_INSERT_ASSIGNMENT:
+            return "insert assignment " + item + " into " + course;
+        case MUTATION_DELETE_ASSIGNMENT:
+            return "delete assignment " + item + " of " + course;
+        case MUTATION_DELETE_COURSE:
+            return "delete " + course;
+        case MUTATION_ADD_CATEGORY:
+            return "add category " + m.name + " to " + course;
+        case MUTATION_EDIT_CATEGORY:
+            return "edit category " + item + " of " + course;
+        case MUTATION_DELETE_CATEGORY:
+            return "delete category " + item + " of " + course;
+    }
+    return "change " + course;
+}
+
+// Applies a list of changes without recording them in the history, all
+// or nothing: if one fails, the ones already made are reversed again and
+// "error" says why the list could not be applied.
+static bool applyWithoutHistory(Gradebook& book,
+                                const vector<Mutation>& changes,
+                                string& error) {
+    UndoHistory* history = book.history;
+    book.history = nullptr;
+
+    // A change that could not be journaled is still made, so it is
+    // reversed like the others.
+    vector<vector<Mutation> > made;  // the reversing changes, in order
+    bool ok = true;
+    for (size_t i = 0; ok && i < changes.size(); ++i) {
+        made.push_back(vector<Mutation>());
+        inverseMutations(book.courses, changes[i], made.back());
+        ok = applyMutation(book, changes[i], error);
+        if (!ok && !book.lastChangeUnlogged) {
+            made.pop_back();
+        }
+    }
+
+    string rollbackError;
+    for (size_t i = made.size(); !ok && i > 0; --i) {
+        const vector<Mutation>& reverse = made[i - 1];
+        for (size_t j = 0; j < reverse.size(); ++j) {
+            if (!applyMutation(book, reverse[j], rollbackError) &&
+                !book.lastChangeUnlogged) {
+                error += " (and the changes made so far could not be "
+                         "reversed: " + rollbackError + ")";
+                i = 1;  // give up on the rest
+                break;
+            }
+        }
+    }
+
+    book.history = history;
+    return ok;
+}
+
+// Reverses the newest step. "description" names the change that was undone.
+bool undoLastChange(Gradebook& book, string& description, string& error) {
+    HistoryStep step;
+    if (book.history == nullptr || !book.history->takeUndo(step)) {
+        error = "nothing to undo";
+        return false;
+    }
+    if (!applyWithoutHistory(book, step.undo, error)) {
+        book.history->keepUndo(step);  // nothing changed; it stays undoable
+        return false;
+    }
+    description = describeMutation(step.change);
+    book.history->keepRedo(step);
+    return true;
+}
+
+// Makes the most recently undone change again.
+bool redoLastChange(Gradebook& book, string& description, string& error) {
+    HistoryStep step;
+    if (book.history == nullptr || !book.history->takeRedo(step)) {
+        error = "nothing to redo";
+        return false;
+    }
+    vector<Mutation> change(1, step.change);
+    if (!applyWithoutHistory(book, change, error)) {
+        book.history->keepRedo(step);  // nothing changed; it stays redoable
+        return false;
+    }
+    description = describeMutation(step.change);
+    book.history->keepUndo(step);
+    return true;
+}
+
+// Menu screens for undo and redo.
+void undoMenu(Gradebook& book) {
+    string description;
+    string error;
+    if (undoLastChange(book, description, error)) {
+        cout << "Undone: " << description << ".\n";
+    } else {
+        cout << "Could not undo: " << error << ".\n";
+    }
+}
+
+void redoMenu(Gradebook& book) {
+    string description;
+    string error;
+    if (redoLastChange(book, description, error)) {
+        cout << "Redone: " << description << ".\n";
+    } else {
+        cout << "Could not redo: " << error << ".\n";
+    }
+}
+
+// ============================================================================
+// REPORT RENDERER
+// ============================================================================
+// Course tables are built in a ReportBuffer and written in one go. Tables
+// longer than one page are shown a page at a time, and the rows can be
+// filtered by name, so picking a course from thousands does not scroll
+// them all past the user.
+
+const size_t REPORT_PAGE_ROWS = 20;
+
+void ReportBuffer::appendInt(long long value) {
+    char digits[24];
+    int count = 0;
+    unsigned long long magnitude = value < 0
+        ? 0ULL - static_cast<unsigned long long>(value)
+        : static_cast<unsigned long long>(value);
+
+    do {
+        digits[count++] = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+
+    if (value < 0) {
+        chars += '-';
+    }
+    while (count > 0) {
+        chars += digits[--count];
+    }
+}
+
+void ReportBuffer::appendFixed(double value, int decimals) {
+    static const double SCALE[] = { 1.0, 10.0, 100.0, 1000.0, 10000.0,
+                                    100000.0, 1000000.0 };
+    if (decimals < 0) {
+        decimals = 0;
+    } else if (decimals > 6) {
+        decimals = 6;
+    }
+
+    // Very large values, infinities and NaN take the slow path. So do
+    // values that land on half a printed unit, give or take the rounding
+    // of the multiplication: only printf looks at the exact binary value,
+    // which decides the way they go (3.125 is exact and rounds to even,
+    // "3.12"; 59.995 is stored a hair below and rounds down, "59.99").
+    double scaled = fabs(value) * SCALE[decimals];
+    double below = floor(scaled);
+    if (!(scaled < 1e15) || fabs(scaled - below - 0.5) <= scaled * 1e-15) {
+        char fallback[64];
+        snprintf(fallback, sizeof(fallback), "%.*f", decimals, value);
+        // Like the fast path, print no sign when every digit is zero.
+        const char* text = fallback;
+        if (text[0] == '-' && strspn(text + 1, "0.") == strlen(text + 1)) {
+            ++text;
+        }
+        chars += text;
+        return;
+    }
+
+    // Round once to an integer number of the smallest printed units, then
+    // print the integer part, the point and the fraction digits.
+    unsigned long long units = static_cast<unsigned long long>(below);
+    if (scaled - below > 0.5) {
+        ++units;
+    }
+    unsigned long long scale = static_cast<unsigned long long>(SCALE[decimals]);
+
+    if (value < 0 && units != 0) {
+        chars += '-';
+    }
+    appendInt(static_cast<long long>(units / scale));
+
+    if (decimals > 0) {
+        chars += '.';
+        unsigned long long fraction = units % scale;
+        size_t start = chars.size();
+        chars.append(static_cast<size_t>(decimals), '0');
+        for (int i = decimals - 1; i >= 0; --i) {
+            chars[start + static_cast<size_t>(i)] =
+                static_cast<char>('0' + fraction % 10);
+            fraction /= 10;
+        }
+    }
+}
+
+void ReportBuffer::appendShort(double value) {
+    size_t start = chars.size();
+    appendFixed(value, 2);
+
+    size_t point = chars.find('.', start);
+    if (point == string::npos) {
+        return;
+    }
+    size_t end = chars.size();
+    while (end > point + 1 && chars[end - 1] == '0') {
+        --end;
+    }
+    if (end == point + 1) {
+        end = point;  // nothing left after the point
+    }
+    chars.resize(end);
+}
+
+void ReportBuffer::padFrom(size_t start, size_t width) {
+    size_t used = chars.size() - start;
+    if (used < width) {
+        chars.append(width - used, ' ');
+    }
+}
+
+void ReportBuffer::writeTo(ostream& out) {
+    GPA_TIME_METRIC(METRIC_WRITE_OUTPUT);
+    out.write(chars.data(), static_cast<streamsize>(chars.size()));
+    out.flush();
+    chars.clear();
+}
+
+// The buffer shared by the menu screens (kept so its memory is reused).
+ReportBuffer& reportBuffer() {
+    static ReportBuffer buffer;
+    return buffer;
+}
+
+// True if "name" contains "filter", ignoring upper/lower case.
+bool nameMatchesFilter(const PooledName& name, const string& filter) {
+    if (filter.size() > name.size()) {
+        return false;
+    }
+    for (size_t start = 0; start + filter.size() <= name.size(); ++start) {
+        size_t i = 0;
+        while (i < filter.size() &&
+               tolower(static_cast<unsigned char>(name[start + i])) ==
+               tolower(static_cast<unsigned char>(filter[i]))) {
+            ++i;
+        }
+        if (i == filter.size()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Shows "rowCount" rows between a header and a footer. Short tables are
+// printed in one piece. Longer ones are shown REPORT_PAGE_ROWS at a time
+// and the user can move between pages or filter the rows:
+//     Enter    done (go on to the next prompt)
+//     n / p    next / previous page
+//     /text    only rows whose name contains "text"
+//     /        show all rows again
+void showPagedReport(const string& header, const string& footer,
+                     size_t rowCount,
+                     const function<bool(size_t, const string&)>& rowMatches,
+                     const function<void(size_t, ReportBuffer&)>& renderRow) {
+    ReportBuffer& out = reportBuffer();
+    string filter;
+    vector<size_t> matching;
+    size_t page = 0;
+    bool refilter = true;
+
+    while (true) {
+        if (refilter) {
+            matching.clear();
+            for (size_t row = 0; row < rowCount; ++row) {
+                if (filter.empty() || rowMatches(row, filter)) {
+                    matching.push_back(row);
+                }
+            }
+            page = 0;
+            refilter = false;
+        }
+
+        size_t first = page * REPORT_PAGE_ROWS;
+        size_t last = first + REPORT_PAGE_ROWS;
+        if (last > matching.size()) {
+            last = matching.size();
+        }
+
+        {
+            GPA_TIME_METRIC(METRIC_RENDER_REPORT);
+            out.clear();
+            out.append(header);
+            for (size_t i = first; i < last; ++i) {
+                renderRow(matching[i], out);
+            }
+            if (matching.empty()) {
+                out.append("(no rows match \"");
+                out.append(filter);
+                out.append("\")\n");
+            }
+            out.append(footer);
+        }
+
+        if (rowCount <= REPORT_PAGE_ROWS) {
+            out.writeTo(cout);
+            return;
+        }
+
+        size_t pageCount = (matching.size() + REPORT_PAGE_ROWS - 1) /
+            REPORT_PAGE_ROWS;
+        if (pageCount == 0) {
+            pageCount = 1;
+        }
+
+        out.append("Rows ");
+        out.appendInt(static_cast<long long>(matching.empty() ? 0 : first + 1));
+        out.append('-');
+        out.appendInt(static_cast<long long>(last));
+        out.append(" of ");
+        out.appendInt(static_cast<long long>(matching.size()));
+        if (!filter.empty()) {
+            out.append(" matching \"");
+            out.append(filter);
+            out.append('"');
+        }
+        out.append(" (page ");
+        out.appendInt(static_cast<long long>(page + 1));
+        out.append(" of ");
+        out.appendInt(static_cast<long long>(pageCount));
+        out.append(")\n");
+        out.append("[Enter] done, n = next, p = previous, /text = filter, "
+                   "/ = show all: ");
+        out.writeTo(cout);
+
+        string command;
+        if (!getline(cin, command) || command.empty()) {
+            return;
+        }
+
+        if (command == "n") {
+            if (page + 1 < pageCount) {
+                ++page;
+            }
+        } else if (command == "p") {
+            if (page > 0) {
+                --page;
+            }
+        } else if (command[0] == '/') {
+            filter = command.substr(1);
+            refilter = true;
+        } else {
+            cout << "Unknown command.\n";
+        }
+    }
+}
+
+// ============================================================================
+// COURSE MANAGEMENT
+// ============================================================================
+//5
+// Adds a new course with name and credit hours.
+void addCourse(Gradebook& book) {
+    if (!isValidCourseId(book.nextCourseId)) {
+        cout << "The maximum number of course ids (" << MAX_COURSE_ID
+             << ") has been used up. No more courses can be added.\n";
+        return;
+    }
+
+    int id = book.nextCourseId;  // applyMutation moves nextCourseId on
+
+    cout << "Enter course name (for example, COSC 3345): ";
+    string name;
+    getline(cin, name);
+
+    double creditHours = readDoubleInRange(
+        "Enter credit hours (e.g., 3 or 4): ", 0.5, 6.0);
+
+    string error;
+    if (!applyMutation(book, makeAddCourse(id, name, creditHours), error)) {
+        cout << "Course not added: " << error << ".\n";
+        return;
+    }
+
+    cout << "Course added with id " << id << ".\n";
+}
+
+// Finds course index by ID, or returns -1. Constant time (see CourseStore).
+int findCourseIndexById(const CourseStore& courses, int id) {
+    GPA_TIME_METRIC(METRIC_FIND_COURSE);
+    return courses.indexOf(id);
+}
+
+// Ids of the courses called exactly "name". Names are interned, so a name
+// that is not in the pool is answered without looking at any course, and
+// otherwise each course costs one 4-byte id compare.
+void findCoursesByName(const CourseStore& courses, const string& name,
+                       vector<int>& ids) {
+    ids.clear();
+    uint32_t nameId = 0;
+    if (!namePool().find(name.data(), name.size(), nameId)) {
+        return;
+    }
+    for (const Course& c : courses) {
+        if (c.name.poolId() == nameId) {
+            ids.push_back(c.id);
+        }
+    }
+}
+
+// Lists summary info about each course.
+void listCoursesSummary(const CourseStore& courses) {
+    if (courses.empty()) {
+        cout << "No courses have been added yet.\n";
+        return;
+    }
+
+    // Filtering matches a course by part of its name or by its exact ID.
+    showPagedReport(
+        "Courses summary:\n"
+        "------------------------------------------------------------\n",
+        "------------------------------------------------------------\n",
+        courses.size(),
+        [&courses](size_t row, const string& filter) {
+            const Course& c = courses[row];
+            return nameMatchesFilter(c.name, filter) ||
+                   to_string(c.id) == filter;
+        },
+        [&courses](size_t row, ReportBuffer& out) {
+            const Course& c = courses[row];
+            out.append("ID: ");
+            out.appendInt(c.id);
+            out.append(" | Name: ");
+            out.append(c.name);
+            out.append(" | Credits: ");
+            out.appendShort(c.creditHours);
+
+            if (!c.work.empty()) {
+                double percent = calculateCoursePercentage(c);
+                out.append(" | Grade: ");
+                out.appendFixed(percent, 2);
+                out.append("% (");
+                out.append(percentageToLetter(percent));
+                out.append(')');
+            } else {
+                out.append(" | Grade: N/A (no assignments yet)");
+            }
+
+            out.append('\n');
+        });
+}
+
+// ============================================================================
+// GRADING CATEGORIES
+// ============================================================================
+
+// Lets the user pick one of a course's grading categories. Courses with a
+// single category skip the question.
+int askCategory(const Course& c) {
+    if (c.categories.size() == 1) {
+        return 0;
+    }
+
+    cout << "Grading categories of " << c.name << ":\n";
+    for (size_t i = 0; i < c.categories.size(); ++i) {
+        cout << (i + 1) << ". " << c.categories[i].name << " ("
+             << c.categories[i].weight << "%)\n";
+    }
+    return readIntInRange("Enter the category number: ", 1,
+                          static_cast<int>(c.categories.size())) - 1;
+}
+
+// Adds a grading category (name, weight, drop-lowest rule) to a course.
+void addCategoryToCourse(Gradebook& book) {
+    const CourseStore& courses = book.courses;
+    if (courses.empty()) {
+        cout << "No courses available.\n";
+        return;
+    }
+
+    listCoursesSummary(courses);
+
+    int id = readIntInRange(
+        "Enter the ID of the course to add a grading category to: ",
+        MIN_COURSE_ID, MAX_COURSE_ID);
+
+    int index = findCourseIndexById(courses, id);
+    if (index == -1) {
+        cout << "No course found with that ID.\n";
+        return;
+    }
+
+    string name;
+    cout << "Enter the category name (for example, Homework): ";
+    getline(cin, name);
+
+    double weight = readDoubleInRange(
+        "Enter its weight in percent of the course grade: ", 0.01, 100.0);
+
+    int dropLowest = readIntInRange(
+        "How many of the lowest scores should be dropped? ",
+        0, MAX_DROP_LOWEST);
+
+    string error;
+    if (!applyMutation(book, makeAddCategory(id, name, weight, dropLowest),
+                       error)) {
+        cout << "Category not added: " << error << ".\n";
+        return;
+    }
+
+    cout << "Category '" << name << "' added to '" << courses[index].name
+         << "'.\n";
+    if (courses[index].categories.size() == 2) {
+        cout << "Note: the course still has its 'General' category ("
+             << courses[index].categories[0].weight << "%). It only counts\n"
+             << "once it has assignments; edit it to change its weight.\n";
+    }
+}
+
+// Changes the name, weight or drop-lowest rule of a grading category.
+void editCategoryInCourse(Gradebook& book) {
+    const CourseStore& courses = book.courses;
+    if (courses.empty()) {
+        cout << "No courses available.\n";
+        return;
+    }
+
+    listCoursesSummary(courses);
+
+    int id = readIntInRange(
+        "Enter the ID of the course whose category you want to edit: ",
+        MIN_COURSE_ID, MAX_COURSE_ID);
+
+    int index = findCourseIndexById(courses, id);
+    if (index == -1) {
+        cout << "No course found with that ID.\n";
+        return;
+    }
+
+    const Course& c = courses[index];
+    int category = askCategory(c);
+    const Category& cat = c.categories[category];
+
+    cout << "Current name: " << cat.name << "\n";
+    cout << "Enter a new name, or just press Enter to keep it: ";
+    string name;
+    getline(cin, name);
+    if (name.empty()) {
+        name = cat.name;
+    }
+
+    cout << "Current weight: " << cat.weight << "%\n";
+    double weight = readDoubleInRange(
+        "Enter NEW weight in percent of the course grade: ", 0.01, 100.0);
+
+    cout << "Currently dropping the lowest " << cat.dropLowest << " score(s).\n";
+    int dropLowest = readIntInRange(
+        "Enter NEW number of lowest scores to drop: ", 0, MAX_DROP_LOWEST);
+
+    string error;
+    if (!applyMutation(book, makeEditCategory(id, category, name, weight,
+                                              dropLowest), error)) {
+        cout << "Category not updated: " << error << ".\n";
+        return;
+    }
+
+    cout << "Category updated.\n";
+}
+
+// ============================================================================
+// ASSIGNMENT MANAGEMENT
+// ============================================================================
+
+// Adds an assignment to a specific course.
+void addAssignmentToCourse(Gradebook& book) {
+    const CourseStore& courses = book.courses;
+    if (courses.empty()) {
+        cout << "There are no courses yet. Add a course first.\n";
+        return;
+    }
+
+    listCoursesSummary(courses);
+
+    int id = readIntInRange(
+        "Enter the ID of the course to add an assignment to: ",
+        MIN_COURSE_ID, MAX_COURSE_ID);
+
+    int index = findCourseIndexById(courses, id);
+    if (index == -1) {
+        cout << "No course found with that ID.\n";
+        return;
+    }
+
+    const Course& c = courses[index];
+    PooledName courseName = c.name;
+    Assignment a;
+
+    cout << "Enter assignment name (for example, Exam 1): ";
+    string name;
+    getline(cin, name);
+    a.name = name;
+
+    a.max = readDoubleInRange(
+        "Enter maximum points for this assignment: ", 1.0, 10000.0);
+
+    a.earned = readDoubleInRange(
+        "Enter points earned on this assignment: ", 0.0, a.max);
+
+    // Courses that use grading categories also ask where the assignment
+    // goes and whether it is extra credit.
+    if (c.categories.size() > 1) {
+        a.category = askCategory(c);
+        a.extraCredit = readIntInRange(
+            "Is this extra credit? (1 = Yes, 0 = No): ", 0, 1) == 1;
+    }
+
+    string error;
+    if (!applyMutation(book, makeAddAssignment(id, a), error)) {
+        cout << "Assignment not added: " << error << ".\n";
+        return;
+    }
+
+    cout << "Assignment added to course '" << courseName << "'.\n";
+}
+
+// Percentage (0-100) scored on a single assignment.
+double assignmentPercentage(const Assignment& a) {
+    return (a.earned / a.max) * 100.0;
+}
+
+// Splits number * 2^80 into its top and bottom 64 bits, cutting off what
+// is left below one step. Scaling by a power of two is exact, so both
+// parts are too.
+static void exactSumParts(double number, uint64_t& high, uint64_t& low) {
+    double scaled = number * 65536.0;  // 2^16
+    double whole = floor(scaled);
+    high = static_cast<uint64_t>(whole);
+    low = static_cast<uint64_t>((scaled - whole) * 18446744073709551616.0);
+}
+
+void ExactSum::add(double number) {
+    uint64_t addHigh;
+    uint64_t addLow;
+    exactSumParts(number, addHigh, addLow);
+    low += addLow;
+    high += addHigh + (low < addLow ? 1 : 0);
+}
+
+void ExactSum::subtract(double number) {
+    uint64_t subHigh;
+    uint64_t subLow;
+    exactSumParts(number, subHigh, subLow);
+    uint64_t borrow = low < subLow ? 1 : 0;
+    low -= subLow;
+    high -= subHigh + borrow;
+}
+
+double ExactSum::value() const {
+    return static_cast<double>(high) / 65536.0 +
+           static_cast<double>(low) / 1208925819614629174706176.0;  // 2^80
+}
+
+// Re-adds the (at most MAX_DROP_LOWEST) scores in "lowest" so rounding
+// leftovers never build up in lowestSum.
+static void resumLowest(Category& cat) {
+    cat.lowestSum = 0.0;
+    for (double p : cat.lowest) {
+        cat.lowestSum += p;
+    }
+}
+
+// Adds one assignment percentage (and the same in fixed-point units) to a
+// category's aggregates.
+void addScoreToCategory(Category& cat, double percent, int64_t units,
+                        bool extraCredit) {
+    if (extraCredit) {
+        cat.extraPercentages.add(percent);
+        cat.fixedExtra += units;
+        return;
+    }
+
+    cat.count++;
+    cat.sumPercentages.add(percent);
+    cat.fixedSum += units;
+    if (cat.dropLowest == 0) {
+        return;
+    }
+
+    if (static_cast<int>(cat.lowest.size()) < cat.dropLowest) {
+        cat.lowest.insert(percent);
+    } else if (percent < *cat.lowest.rbegin()) {
+        // The new score is one of the lowest; the highest "lowest" score
+        // moves over to "rest".
+        multiset<double>::iterator top = --cat.lowest.end();
+        cat.rest.insert(*top);
+        cat.lowest.erase(top);
+        cat.lowest.insert(percent);
+    } else {
+        cat.rest.insert(percent);
+        return;
+    }
+    resumLowest(cat);
+}
+
+// Takes one assignment percentage back out of a category's aggregates.
+void removeScoreFromCategory(Category& cat, double percent, int64_t units,
+                             bool extraCredit) {
+    if (extraCredit) {
+        cat.extraPercentages.subtract(percent);
+        cat.fixedExtra -= units;
+        return;
+    }
+
+    cat.count--;
+    cat.sumPercentages.subtract(percent);
+    cat.fixedSum -= units;
+    if (cat.dropLowest == 0) {
+        return;
+    }
+
+    multiset<double>::iterator it = cat.lowest.find(percent);
+    if (it != cat.lowest.end()) {
+        // Refill "lowest" with the smallest remaining score.
+        cat.lowest.erase(it);
+        if (!cat.rest.empty()) {
+            cat.lowest.insert(*cat.rest.begin());
+            cat.rest.erase(cat.rest.begin());
+        }
+        resumLowest(cat);
+    } else {
+        it = cat.rest.find(percent);
+        if (it != cat.rest.end()) {
+            cat.rest.erase(it);
+        }
+    }
+}
+
+// Empties a category's aggregates (its settings are kept).
+void clearCategoryScores(Category& cat) {
+    cat.count = 0;
+    cat.sumPercentages.clear();
+    cat.extraPercentages.clear();
+    cat.lowest.clear();
+    cat.rest.clear();
+    cat.lowestSum = 0.0;
+    cat.fixedSum = 0;
+    cat.fixedExtra = 0;
+}
+
+// Rebuilds the aggregates of one category from the course's assignments
+// (used when its drop-lowest rule changes).
+void rebuildCategory(Course& course, int category) {
+    Category& cat = course.categories[category];
+    clearCategoryScores(cat);
+    for (size_t i = 0; i < course.work.size(); ++i) {
+        if (course.work.category[i] == category) {
+            addScoreToCategory(cat,
+                               (course.work.earned[i] / course.work.max[i]) * 100.0,
+                               course.work.percentUnits[i],
+                               course.work.extraCredit[i] != 0);
+        }
+    }
+}
+
+// Adds one score to (or takes it out of) a course's own totals.
+static void addCourseTotals(Course& course, double earned, double max) {
+    course.sumPercentages.add((earned / max) * 100.0);
+    course.sumEarned.add(earned);
+    course.sumMax.add(max);
+}
+
+static void removeCourseTotals(Course& course, double earned, double max) {
+    course.sumPercentages.subtract((earned / max) * 100.0);
+    course.sumEarned.subtract(earned);
+    course.sumMax.subtract(max);
+}
+
+// Appends an assignment and adds it to the course's running totals.
+void addWorkToCourse(Course& course, const Assignment& a) {
+    course.work.push_back(a);
+    addCourseTotals(course, a.earned, a.max);
+    addScoreToCategory(course.categories[a.category], assignmentPercentage(a),
+                       course.work.percentUnits.back(), a.extraCredit);
+}
+
+// Inserts an assignment at "index" (the later ones move up by one) and
+// adds it to the course's running totals.
+void insertWorkInCourse(Course& course, size_t index, const Assignment& a) {
+    course.work.insert(index, a);
+    addCourseTotals(course, a.earned, a.max);
+    addScoreToCategory(course.categories[a.category], assignmentPercentage(a),
+                       course.work.percentUnits[index], a.extraCredit);
+}
+
+// Overwrites the assignment at "index" and swaps its share of the totals.
+void replaceWorkInCourse(Course& course, size_t index, const Assignment& a) {
+    double oldEarned = course.work.earned[index];
+    double oldMax = course.work.max[index];
+
+    removeCourseTotals(course, oldEarned, oldMax);
+    removeScoreFromCategory(course.categories[course.work.category[index]],
+                            (oldEarned / oldMax) * 100.0,
+                            course.work.percentUnits[index],
+                            course.work.extraCredit[index] != 0);
+
+    course.work.set(index, a);
+    addCourseTotals(course, a.earned, a.max);
+    addScoreToCategory(course.categories[a.category], assignmentPercentage(a),
+                       course.work.percentUnits[index], a.extraCredit);
+}
+
+// Removes the assignment at "index" and takes it out of the totals.
+void removeWorkFromCourse(Course& course, size_t index) {
+    double oldEarned = course.work.earned[index];
+    double oldMax = course.work.max[index];
+
+    removeCourseTotals(course, oldEarned, oldMax);
+    removeScoreFromCategory(course.categories[course.work.category[index]],
+                            (oldEarned / oldMax) * 100.0,
+                            course.work.percentUnits[index],
+                            course.work.extraCredit[index] != 0);
+
+    course.work.erase(index);
+}
+
+// ============================================================================
+// ASSIGNMENT COLUMNS + SCORE KERNELS
+// ============================================================================
+
+Assignment AssignmentColumns::operator[](size_t index) const {
+    Assignment a;
+    a.name = names[index];
+    a.earned = earned[index];
+    a.max = max[index];
+    a.category = category[index];
+    a.extraCredit = extraCredit[index] != 0;
+    return a;
+}
+
+void AssignmentColumns::push_back(const Assignment& a) {
+    names.push_back(a.name);
+    earned.push_back(a.earned);
+    max.push_back(a.max);
+    category.push_back(static_cast<unsigned char>(a.category));
+    extraCredit.push_back(a.extraCredit ? 1 : 0);
+    percentUnits.push_back(fixedPercentUnits(a.earned, a.max));
+}
+
+void AssignmentColumns::insert(size_t index, const Assignment& a) {
+    names.insert(names.begin() + index, a.name);
+    earned.insert(earned.begin() + index, a.earned);
+    max.insert(max.begin() + index, a.max);
+    category.insert(category.begin() + index,
+                    static_cast<unsigned char>(a.category));
+    extraCredit.insert(extraCredit.begin() + index,
+                       static_cast<unsigned char>(a.extraCredit ? 1 : 0));
+    percentUnits.insert(percentUnits.begin() + index,
+                        fixedPercentUnits(a.earned, a.max));
+}
+
+void AssignmentColumns::set(size_t index, const Assignment& a) {
+    names[index] = a.name;
+    earned[index] = a.earned;
+    max[index] = a.max;
+    category[index] = static_cast<unsigned char>(a.category);
+    extraCredit[index] = a.extraCredit ? 1 : 0;
+    percentUnits[index] = fixedPercentUnits(a.earned, a.max);
+}
+
+void AssignmentColumns::erase(size_t index) {
+    names.erase(names.begin() + index);
+    earned.erase(earned.begin() + index);
+    max.erase(max.begin() + index);
+    category.erase(category.begin() + index);
+    extraCredit.erase(extraCredit.begin() + index);
+    percentUnits.erase(percentUnits.begin() + index);
+}
+
+// Returns the sum of (earned[i] / max[i]) * 100 for i in [0, count). Each
+// percentage rounds exactly like addWorkToCourse works it out, and the sum
+// is an ExactSum, so a course loaded in bulk gets bit-for-bit the totals
+// (and letters) it gets when its scores are entered. AVX (4 doubles at a
+// time) or SSE2 (2 at a time) does the divisions when the build allows it.
+ExactSum sumScorePercentages(const double* earned, const double* max,
+                             size_t count) {
+    size_t i = 0;
+    ExactSum total;
+
+#if defined(__AVX__)
+    const __m256d hundred = _mm256_set1_pd(100.0);
+    double lanes[4];
+    for (; i + 4 <= count; i += 4) {
+        _mm256_storeu_pd(lanes, _mm256_mul_pd(
+            _mm256_div_pd(_mm256_loadu_pd(earned + i), _mm256_loadu_pd(max + i)),
+            hundred));
+        total.add(lanes[0]);
+        total.add(lanes[1]);
+        total.add(lanes[2]);
+        total.add(lanes[3]);
+    }
+#elif defined(__SSE2__)
+    const __m128d hundred = _mm_set1_pd(100.0);
+    double lanes[2];
+    for (; i + 2 <= count; i += 2) {
+        _mm_storeu_pd(lanes, _mm_mul_pd(
+            _mm_div_pd(_mm_loadu_pd(earned + i), _mm_loadu_pd(max + i)),
+            hundred));
+        total.add(lanes[0]);
+        total.add(lanes[1]);
+    }
+#endif
+
+    // Leftover items (or everything, without SIMD).
+    for (; i < count; ++i) {
+        total.add((earned[i] / max[i]) * 100.0);
+    }
+    return total;
+}
+
+// Rebuilds a course's running totals from its score columns in one pass.
+// Used when many assignments are loaded at once, instead of updating the
+// totals row by row.
+void recalculateCourseTotals(Course& course) {
+    size_t count = course.work.size();
+    const double* earned = course.work.earned.data();
+    const double* max = course.work.max.data();
+
+    // Loaders that fill the earned/max columns directly leave the
+    // fixed-point column behind; convert all of it in one go.
+    FixedColumn& units = course.work.percentUnits;
+    if (units.size() != count) {
+        units.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            units[i] = fixedPercentUnits(earned[i], max[i]);
+        }
+    }
+
+    course.sumPercentages = sumScorePercentages(earned, max, count);
+    course.sumEarned.clear();
+    course.sumMax.clear();
+    for (size_t i = 0; i < count; ++i) {
+        course.sumEarned.add(earned[i]);
+        course.sumMax.add(max[i]);
+    }
+
+    // Usual case: one category, no drops, no extra credit. Its aggregates
+    // are the course totals just computed.
+    const unsigned char* extra = course.work.extraCredit.data();
+    if (course.categories.size() == 1 && course.categories[0].dropLowest == 0 &&
+        find(extra, extra + count, 1) == extra + count) {
+        Category& cat = course.categories[0];
+        clearCategoryScores(cat);
+        cat.count = static_cast<int>(count);
+        cat.sumPercentages = course.sumPercentages;
+        cat.fixedSum = sumFixedColumn(units.data(), count);
+        return;
+    }
+
+    for (Category& cat : course.categories) {
+        clearCategoryScores(cat);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        addScoreToCategory(course.categories[course.work.category[i]],
+                           (earned[i] / max[i]) * 100.0, units[i],
+                           extra[i] != 0);
+    }
+}
+
+// ============================================================================
+// FIXED-POINT SCORES
+// ============================================================================
+// "--fixed-point" grades with integers instead of floating point, so the
+// same scores give bit-identical percentages, letters and GPAs on every
+// machine, on any number of threads, and after any history of edits.
+//
+// Each assignment keeps its percentage in billionths of a percent
+// (percentUnits, worked out from its points counted in thousandths and
+// rounded to the nearest unit), and every category keeps the integer sums
+// of those, so adding and removing scores never leaves rounding behind.
+// A course average is then computed with integers only: each category
+// average, and the weighted average of those (weights counted in
+// thousandths of a percent), is cut - not rounded - to whole units. The
+// rounding of each assignment can still leave the result up to about one
+// unit per assignment away from the true average. So when it lands that
+// close to a grade boundary, the course's points are compared with the
+// boundary exactly (as fractions in 128-bit integers), and the result is
+// moved to the right side of it. Because a whole number of units converts
+// to the one double closest to it, comparing that double with a boundary
+// then gives the same answer as the exact comparison.
+//
+// The GPA adds up grade points in thousandths times credit hours in halves
+// (credits are rounded to the nearest half hour) and divides once at the
+// end.
+//
+// The units are kept up to date in both modes, so the mode can be picked
+// when the program starts without converting anything. What-if scenarios,
+// forecasts and the minimum-score solver still work out the courses they
+// change in floating point.
+
+static bool fixedPointScores = false;
+
+bool fixedPointMode() {
+    return fixedPointScores;
+}
+
+void setFixedPointMode(bool on) {
+    fixedPointScores = on;
+}
+
+// Points whose thousandths times 100% in units would not fit in 64 bits.
+// Validated scores (at most 10000 points) stay far below it.
+const int64_t FIXED_MAX_EXACT_POINTS = 90000000;
+
+// One assignment's percentage in fixed-point units, rounded to the nearest
+// unit (halves up).
+int64_t fixedPercentUnits(double earned, double max) {
+    int64_t e = llround(earned * FIXED_POINTS_PER_POINT);
+    int64_t m = llround(max * FIXED_POINTS_PER_POINT);
+    if (m <= 0 || e < 0) {
+        return 0;
+    }
+    if (e > FIXED_MAX_EXACT_POINTS) {
+        return llround(static_cast<double>(e) / static_cast<double>(m) *
+                       100.0 * FIXED_UNITS_PER_PERCENT);
+    }
+    return (e * 100 * FIXED_UNITS_PER_PERCENT + m / 2) / m;
+}
+
+// Returns the sum of values[i] for i in [0, count). Uses AVX2 (4 integers
+// at a time) or SSE2 (2 at a time) when the build allows it. Integer
+// addition is exact, so the result is the same in any order.
+int64_t sumFixedColumn(const int64_t* values, size_t count) {
+    size_t i = 0;
+    int64_t total = 0;
+
+#if defined(__AVX2__)
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    for (; i + 8 <= count; i += 8) {
+        acc0 = _mm256_add_epi64(acc0, _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(values + i)));
+        acc1 = _mm256_add_epi64(acc1, _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(values + i + 4)));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes),
+                        _mm256_add_epi64(acc0, acc1));
+    total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(__SSE2__)
+    __m128i acc0 = _mm_setzero_si128();
+    __m128i acc1 = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        acc0 = _mm_add_epi64(acc0, _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(values + i)));
+        acc1 = _mm_add_epi64(acc1, _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(values + i + 2)));
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes),
+                     _mm_add_epi64(acc0, acc1));
+    total = lanes[0] + lanes[1];
+#endif
+
+    for (; i < count; ++i) {
+        total += values[i];
+    }
+    return total;
+}
+
+// A category's average in fixed-point units (cut to whole units). With a
+// drop-lowest rule the lowest scores are picked from the course's column,
+// so the result only depends on the scores themselves.
+static int64_t fixedCategoryAverage(const Course& course, size_t k) {
+    const Category& cat = course.categories[k];
+    int drop = cat.dropLowest < cat.count - 1 ? cat.dropLowest : cat.count - 1;
+    if (drop <= 0) {
+        return (cat.fixedSum + cat.fixedExtra) / cat.count;
+    }
+
+    static thread_local vector<int64_t> scores;  // reused, so no allocations
+    scores.clear();
+    for (size_t i = 0; i < course.work.size(); ++i) {
+        if (course.work.category[i] == k && course.work.extraCredit[i] == 0) {
+            scores.push_back(course.work.percentUnits[i]);
+        }
+    }
+    nth_element(scores.begin(), scores.begin() + drop, scores.end());
+    int64_t dropped = 0;
+    for (int i = 0; i < drop; ++i) {
+        dropped += scores[i];
+    }
+    return (cat.fixedSum - dropped + cat.fixedExtra) / (cat.count - drop);
+}
+
+#if defined(__SIZEOF_INT128__)
+typedef unsigned __int128 FixedWide;
+
+// A fraction kept in lowest terms, with both parts below 2^63 so any
+// product of two of them fits in 128 bits.
+struct ExactFraction {
+    uint64_t num = 0;
+    uint64_t den = 1;
+};
+
+// Stores num/den in lowest terms. Returns false if it does not fit.
+static bool fitFraction(FixedWide num, FixedWide den, ExactFraction& out) {
+    FixedWide a = num;
+    FixedWide b = den;
+    while (b != 0) {
+        FixedWide t = a % b;
+        a = b;
+        b = t;
+    }
+    num /= a;
+    den /= a;
+
+    const FixedWide limit = static_cast<FixedWide>(1) << 63;
+    if (num >= limit || den >= limit) {
+        return false;
+    }
+    out.num = static_cast<uint64_t>(num);
+    out.den = static_cast<uint64_t>(den);
+    return true;
+}
+
+// Points counted in thousandths, as fixedPercentUnits counts them.
+static uint64_t exactPoints(double points) {
+    return static_cast<uint64_t>(llround(points * FIXED_POINTS_PER_POINT));
+}
+
+static bool addFraction(ExactFraction& f, uint64_t num, uint64_t den) {
+    return fitFraction(static_cast<FixedWide>(f.num) * den +
+                       static_cast<FixedWide>(num) * f.den,
+                       static_cast<FixedWide>(f.den) * den, f);
+}
+
+static bool scaleFraction(ExactFraction& f, uint64_t num, uint64_t den) {
+    return fitFraction(static_cast<FixedWide>(f.num) * num,
+                       static_cast<FixedWide>(f.den) * den, f);
+}
+
+// The exact course average (as a fraction of 100%) of the points counted
+// in thousandths, following the same steps as fixedCoursePercentage but
+// without cutting anything. Returns false if the fractions grow too big
+// for 128 bits (many unrelated maximums), and the caller keeps the cut
+// value.
+static bool exactCourseFraction(const Course& course, ExactFraction& out) {
+    const AssignmentColumns& work = course.work;
+    ExactFraction total;
+    ExactFraction only;
+    uint64_t weights = 0;
+    int graded = 0;
+
+    static thread_local vector<size_t> regular;  // reused, so no allocations
+    for (size_t k = 0; k < course.categories.size(); ++k) {
+        const Category& cat = course.categories[k];
+        if (cat.count == 0) {
+            continue;
+        }
+
+        ExactFraction average;
+        regular.clear();
+        for (size_t i = 0; i < work.size(); ++i) {
+            if (work.category[i] != k) {
+                continue;
+            }
+            if (work.extraCredit[i] != 0) {
+                if (!addFraction(average, exactPoints(work.earned[i]),
+                                 exactPoints(work.max[i]))) {
+                    return false;
+                }
+            } else {
+                regular.push_back(i);
+            }
+        }
+
+        // Drop the lowest scores, compared exactly (cross-multiplied).
+        int drop = cat.dropLowest < cat.count - 1 ? cat.dropLowest : cat.count - 1;
+        if (drop > 0) {
+            nth_element(regular.begin(), regular.begin() + drop, regular.end(),
+                        [&work](size_t a, size_t b) {
+                return static_cast<FixedWide>(exactPoints(work.earned[a])) *
+                           exactPoints(work.max[b]) <
+                       static_cast<FixedWide>(exactPoints(work.earned[b])) *
+                           exactPoints(work.max[a]);
+            });
+        } else {
+            drop = 0;
+        }
+        for (size_t j = drop; j < regular.size(); ++j) {
+            size_t i = regular[j];
+            if (!addFraction(average, exactPoints(work.earned[i]),
+                             exactPoints(work.max[i]))) {
+                return false;
+            }
+        }
+        if (!scaleFraction(average, 1, cat.count - drop)) {
+            return false;
+        }
+
+        uint64_t weight = llround(cat.weight * FIXED_POINTS_PER_POINT);
+        only = average;
+        if (!scaleFraction(average, weight, 1) ||
+            !addFraction(total, average.num, average.den)) {
+            return false;
+        }
+        weights += weight;
+        graded++;
+    }
+
+    if (graded == 0) {
+        out = ExactFraction();
+        return true;
+    }
+    if (graded == 1 || weights == 0) {
+        out = only;
+        return true;
+    }
+    out = total;
+    return scaleFraction(out, 1, weights);
+}
+#endif
+
+// Moves a cut course average to the right side of any grade boundary it
+// is close enough to for rounding to matter (see above).
+static int64_t settleAtBoundary(const Course& course, int64_t units) {
+#if defined(__SIZEOF_INT128__)
+    // Each assignment is off by at most half a unit, and each of the two
+    // averages cuts off less than one more.
+    int64_t slack = static_cast<int64_t>(course.work.size()) + 2;
+    const GradingScale& scale = gradingScale();
+    for (int i = 0; i < scale.bandCount - 1; ++i) {
+        int64_t boundary = llround(scale.bands[i].minPercent *
+                                   FIXED_UNITS_PER_PERCENT);
+        if (units < boundary - slack || units > boundary + slack) {
+            continue;
+        }
+
+        ExactFraction exact;
+        if (boundary < 0 || !exactCourseFraction(course, exact)) {
+            return units;
+        }
+        bool reaches = static_cast<FixedWide>(exact.num) *
+                           (100 * FIXED_UNITS_PER_PERCENT) >=
+                       static_cast<FixedWide>(boundary) * exact.den;
+        if (reaches && units < boundary) {
+            return boundary;
+        }
+        if (!reaches && units >= boundary) {
+            return boundary - 1;
+        }
+        return units;
+    }
+#else
+    (void)course;
+#endif
+    return units;
+}
+
+// A course's average in fixed-point units: the weighted average of its
+// graded categories, computed with integers only (see above). Courses
+// without assignments give 0.
+int64_t fixedCoursePercentage(const Course& course) {
+    int64_t weighted = 0;
+    int64_t weights = 0;
+    int64_t onlyAverage = 0;
+    int graded = 0;
+
+    for (size_t k = 0; k < course.categories.size(); ++k) {
+        const Category& cat = course.categories[k];
+        if (cat.count == 0) {
+            continue;  // nothing graded in this category yet
+        }
+        int64_t weight = llround(cat.weight * FIXED_POINTS_PER_POINT);
+        onlyAverage = fixedCategoryAverage(course, k);
+        weighted += weight * onlyAverage;
+        weights += weight;
+        graded++;
+    }
+
+    if (graded == 0) {
+        return 0;
+    }
+    if (graded == 1 || weights == 0) {
+        return settleAtBoundary(course, onlyAverage);
+    }
+    return settleAtBoundary(course, weighted / weights);
+}
+
+// ============================================================================
+// GRADE CALCULATIONS
+// ============================================================================
+
+// Average of one category after its drops, plus extra credit. "added" is
+// an optional list of extra regular percentages (lowest first) to include,
+// as the what-if tools do. The category must have at least one regular
+// score once "added" is counted.
+double categoryPercentageWith(const Category& cat, const vector<double>* added) {
+    size_t addedCount = added == nullptr ? 0 : added->size();
+    double sum = cat.sumPercentages.value();
+    for (size_t i = 0; i < addedCount; ++i) {
+        sum += (*added)[i];
+    }
+
+    int count = cat.count + static_cast<int>(addedCount);
+    int drop = cat.dropLowest < count - 1 ? cat.dropLowest : count - 1;
+    if (drop <= 0) {
+        return (sum + cat.extraPercentages.value()) /
+            static_cast<double>(count);
+    }
+
+    // The lowest "drop" scores. Without additions they are (nearly) the
+    // stored "lowest" set; otherwise both sorted lists are merged, and only
+    // their first "drop" entries can be among the lowest.
+    double dropped = 0.0;
+    if (addedCount == 0) {
+        dropped = cat.lowestSum;
+        if (drop < static_cast<int>(cat.lowest.size())) {
+            dropped -= *cat.lowest.rbegin();  // the best score is kept
+        }
+    } else {
+        multiset<double>::const_iterator mine = cat.lowest.begin();
+        size_t next = 0;
+        for (int taken = 0; taken < drop; ++taken) {
+            if (next == addedCount ||
+                (mine != cat.lowest.end() && *mine <= (*added)[next])) {
+                dropped += *mine++;
+            } else {
+                dropped += (*added)[next++];
+            }
+        }
+    }
+
+    return (sum - dropped + cat.extraPercentages.value()) /
+        static_cast<double>(count - drop);
+}
+
+// Weighted average over the categories that have regular scores. When
+// only one category is graded its average is returned as is, so a course
+// without extra categories gives exactly the plain average of before.
+// "added" (one list per category, or nullptr) works as in
+// categoryPercentageWith.
+static double weightedCourseAverage(const Course& course,
+                                    const vector<vector<double> >* added) {
+    double weighted = 0.0;
+    double weights = 0.0;
+    double onlyPercent = 0.0;
+    int graded = 0;
+
+    for (size_t i = 0; i < course.categories.size(); ++i) {
+        const Category& cat = course.categories[i];
+        const vector<double>* extra = nullptr;
+        if (added != nullptr && i < added->size() && !(*added)[i].empty()) {
+            extra = &(*added)[i];
+        }
+        if (cat.count == 0 && extra == nullptr) {
+            continue;  // nothing graded in this category yet
+        }
+
+        onlyPercent = categoryPercentageWith(cat, extra);
+        weighted += cat.weight * onlyPercent;
+        weights += cat.weight;
+        graded++;
+    }
+
+    if (graded == 0) {
+        return 0.0;
+    }
+    if (graded == 1) {
+        return onlyPercent;
+    }
+    return weighted / weights;
+}
+
+// Calculates the overall percentage for a course: the weighted average of
+// its category averages (just the average percentage of its assignments
+// when it has a single category). Uses the running category aggregates, so
+// this costs one step per category no matter how many assignments there are.
+
+//6
+double calculateCoursePercentage(const Course& course) {
+    GPA_TIME_METRIC(METRIC_COURSE_PERCENTAGE);
+    if (course.work.empty()) {
+        return 0.0; // caller should check emptiness
+    }
+    if (fixedPointMode()) {
+        return static_cast<double>(fixedCoursePercentage(course)) /
+            FIXED_UNITS_PER_PERCENT;
+    }
+
+    return weightedCourseAverage(course, nullptr);
+}
+
+// ============================================================================
+// GRADING SCALES
+// ============================================================================
+// Grades are looked up in the active GradingScale (the default one unless
+// "--scale" picked another). Built-in scales:
+//     standard      A 90, B 80, C 70, D 60, F (the default)
+//     plusminus     A+ 97 ... D- 60 and F, with A+ worth 4.0
+//     plusminus433  the same, but A+ is worth 4.33
+//     passfail      P at 70% or more, otherwise NP; not counted in the GPA
+// "--scale file" reads a scale from a text file with one band per line:
+//     # grade  min%  points
+//     A+       97    4.33
+//     A        93    4.0
+//     ...
+//     F        0     0
+// Bands must be listed best grade first and the last one must start at 0.
+// P and NP bands never count in the GPA.
+
+// Short names printed for each grade (indexed by Grade).
+const char* const GRADE_NAMES[GRADE_COUNT] = {
+    "A+", "A", "A-", "B+", "B", "B-", "C+", "C", "C-",
+    "D+", "D", "D-", "F", "P", "NP"
+};
+
+// Plus/minus scale; A+ is worth "topPoints" (4.0 or 4.33).
+static GradingScale plusMinusScale(double topPoints) {
+    GradingScale scale = {
+        {
+            { 97.0, GRADE_A_PLUS,  topPoints, true },
+            { 93.0, GRADE_A,       4.0, true },
+            { 90.0, GRADE_A_MINUS, 3.7, true },
+            { 87.0, GRADE_B_PLUS,  3.3, true },
+            { 83.0, GRADE_B,       3.0, true },
+            { 80.0, GRADE_B_MINUS, 2.7, true },
+            { 77.0, GRADE_C_PLUS,  2.3, true },
+            { 73.0, GRADE_C,       2.0, true },
+            { 70.0, GRADE_C_MINUS, 1.7, true },
+            { 67.0, GRADE_D_PLUS,  1.3, true },
+            { 63.0, GRADE_D,       1.0, true },
+            { 60.0, GRADE_D_MINUS, 0.7, true },
+            {  0.0, GRADE_F,       0.0, true },
+        },
+        13
+    };
+    return scale;
+}
+
+// The scale every grade lookup uses. Only changed at startup, before any
+// threads are started.
+static GradingScale activeScale = DEFAULT_GRADING_SCALE;
+
+const GradingScale& gradingScale() {
+    return activeScale;
+}
+
+void setGradingScale(const GradingScale& scale) {
+    activeScale = scale;
+}
+
+// The band of the active scale that a course percentage falls in.
+const GradeBand& gradeBandFor(double percent) {
+    const GradingScale& scale = activeScale;
+    for (int i = 0; i < scale.bandCount - 1; ++i) {
+        if (percent >= scale.bands[i].minPercent) {
+            return scale.bands[i];
+        }
+    }
+    return scale.bands[scale.bandCount - 1];
+}
+
+// Maps a percentage to a grade using the active scale.
+Grade percentageToGrade(double percent) {
+    return gradeBandFor(percent).grade;
+}
+
+// Printable name of a grade, e.g. "B+".
+const char* gradeName(Grade grade) {
+    return GRADE_NAMES[grade];
+}
+
+// Maps percentage to letter grade (a short name such as "A" or "B+").
+const char* percentageToLetter(double percent) {
+    return gradeName(percentageToGrade(percent));
+}
+
+// Grade points of a grade on the active scale (0 if the scale lacks it).
+double gradePoints(Grade grade) {
+    const GradingScale& scale = activeScale;
+    for (int i = 0; i < scale.bandCount; ++i) {
+        if (scale.bands[i].grade == grade) {
+            return scale.bands[i].points;
+        }
+    }
+    return 0.0;
+}
+
+// Looks a grade up by its printed name. Returns false if there is none.
+static bool gradeFromName(const string& name, Grade& grade) {
+    for (int g = 0; g < GRADE_COUNT; ++g) {
+        if (name == GRADE_NAMES[g]) {
+            grade = static_cast<Grade>(g);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Fills "scale" from a built-in scale name or a scale file.
+bool loadGradingScale(const string& nameOrPath, GradingScale& scale,
+                      string& error) {
+    if (nameOrPath == "standard") {
+        scale = DEFAULT_GRADING_SCALE;
+        return true;
+    }
+    if (nameOrPath == "plusminus") {
+        scale = plusMinusScale(4.0);
+        return true;
+    }
+    if (nameOrPath == "plusminus433") {
+        scale = plusMinusScale(4.33);
+        return true;
+    }
+    if (nameOrPath == "passfail") {
+        GradingScale passFail = {
+            {
+                { 70.0, GRADE_PASS,    0.0, false },
+                {  0.0, GRADE_NO_PASS, 0.0, false },
+            },
+            2
+        };
+        scale = passFail;
+        return true;
+    }
+
+    ifstream file(nameOrPath.c_str());
+    if (!file) {
+        error = "no built-in scale or file named \"" + nameOrPath + "\"";
+        return false;
+    }
+
+    GradingScale loaded;
+    loaded.bandCount = 0;
+    string line;
+    int lineNumber = 0;
+    while (getline(file, line)) {
+        ++lineNumber;
+        size_t hash = line.find('#');
+        if (hash != string::npos) {
+            line.erase(hash);
+        }
+
+        istringstream fields(line);
+        string name;
+        if (!(fields >> name)) {
+            continue;  // blank or comment line
+        }
+
+        GradeBand band;
+        string extra;
+        if (!gradeFromName(name, band.grade) ||
+            !(fields >> band.minPercent >> band.points) || (fields >> extra)) {
+            error = "line " + to_string(lineNumber) +
+                " should be: grade min-percent points";
+            return false;
+        }
+        band.countsInGpa = band.grade != GRADE_PASS &&
+            band.grade != GRADE_NO_PASS;
+
+        if (loaded.bandCount == GRADE_COUNT) {
+            error = "too many grades";
+            return false;
+        }
+        if (band.points < 0.0 || band.points > 5.0 ||
+            band.minPercent < 0.0 || band.minPercent > 100.0 ||
+            (loaded.bandCount > 0 &&
+             band.minPercent >= loaded.bands[loaded.bandCount - 1].minPercent)) {
+            error = "line " + to_string(lineNumber) +
+                ": percentages must go down from 100 to 0 and points must"
+                " be between 0 and 5";
+            return false;
+        }
+        loaded.bands[loaded.bandCount++] = band;
+    }
+
+    if (loaded.bandCount == 0 ||
+        loaded.bands[loaded.bandCount - 1].minPercent != 0.0) {
+        error = "the last grade must start at 0%";
+        return false;
+    }
+
+    scale = loaded;
+    return true;
+}
+
+// ============================================================================
+// COURSE DETAILS + GPA
+// ============================================================================
+
+// Shows detailed information about one course.
+void showCourseDetails(const CourseStore& courses) {
+    if (courses.empty()) {
+        cout << "No courses available.\n";
+        return;
+    }
+
+    listCoursesSummary(courses);
+
+    int id = readIntInRange(
+        "Enter the ID of the course to view details: ",
+        MIN_COURSE_ID, MAX_COURSE_ID);
+
+    int index = findCourseIndexById(courses, id);
+    if (index == -1) {
+        cout << "No course found with that ID.\n";
+        return;
+    }
+
+    const Course& c = courses[index];
+
+    ReportBuffer& out = reportBuffer();
+    out.clear();
+    out.append("====================================================\n");
+    out.append("Course details for: ");
+    out.append(c.name);
+    out.append(" (ID ");
+    out.appendInt(c.id);
+    out.append(")\nCredit hours: ");
+    out.appendShort(c.creditHours);
+    out.append('\n');
+
+    // Grading categories, for courses that have more than the default.
+    const bool showCategories = c.categories.size() > 1 ||
+                                c.categories[0].dropLowest > 0;
+    if (showCategories) {
+        out.append("Grading categories:\n");
+        for (const Category& cat : c.categories) {
+            out.append("  ");
+            out.append(cat.name);
+            out.append(": weight ");
+            out.appendShort(cat.weight);
+            out.append('%');
+            if (cat.dropLowest > 0) {
+                out.append(", drop lowest ");
+                out.appendInt(cat.dropLowest);
+            }
+            out.append(", average ");
+            if (cat.count > 0) {
+                out.appendFixed(categoryPercentageWith(cat, nullptr), 2);
+                out.append("%\n");
+            } else {
+                out.append("N/A\n");
+            }
+        }
+    }
+
+    if (c.work.empty()) {
+        out.append("No assignments have been added to this course yet.\n");
+        out.append("====================================================\n");
+        out.writeTo(cout);
+        return;
+    }
+
+    // Table header, same columns as before: Name, Earned, Max, Percent.
+    size_t start = out.size();
+    out.append("Name");
+    out.padFrom(start, 25);
+    out.append("Earned");
+    out.padFrom(start, 40);
+    out.append("Max");
+    out.padFrom(start, 55);
+    out.append("Percent");
+    out.padFrom(start, 70);
+    if (showCategories) {
+        out.append("Category");
+    }
+    out.append("\n----------------------------------------------------\n");
+    string header = out.text();
+
+    double coursePercent = calculateCoursePercentage(c);
+    out.clear();
+    out.append("----------------------------------------------------\n");
+    out.append("Course average: ");
+    out.appendFixed(coursePercent, 2);
+    out.append("% (");
+    out.append(percentageToLetter(coursePercent));
+    out.append(")\n====================================================\n");
+    string footer = out.text();
+
+    showPagedReport(
+        header, footer, c.work.size(),
+        [&c](size_t row, const string& filter) {
+            return nameMatchesFilter(c.work.names[row], filter);
+        },
+        [&c, showCategories](size_t row, ReportBuffer& out) {
+            double earned = c.work.earned[row];
+            double max = c.work.max[row];
+            size_t start = out.size();
+            out.append(c.work.names[row]);
+            out.padFrom(start, 25);
+            out.appendShort(earned);
+            out.padFrom(start, 40);
+            out.appendShort(max);
+            out.padFrom(start, 55);
+            out.appendFixed((earned / max) * 100.0, 2);
+            out.padFrom(start, 70);
+            if (showCategories) {
+                out.append(c.categories[c.work.category[row]].name);
+            }
+            if (c.work.extraCredit[row] != 0) {
+                out.append(" (extra credit)");
+            }
+            out.append('\n');
+        });
+}
+
+// Course average as if some extra regular assignments were also in the
+// course: added[c] holds their percentages for category c, lowest first.
+double coursePercentageWith(const Course& course,
+                            const vector<vector<double> >& added) {
+    return weightedCourseAverage(course, &added);
+}
+
+// Adds one graded course to GPA totals. Pass/fail grades are left out.
+void addCourseToTotals(GpaTotals& totals, double percent, double creditHours) {
+    const GradeBand& band = gradeBandFor(percent);
+    if (band.countsInGpa) {
+        totals.qualityPoints += band.points * creditHours;
+        totals.credits += creditHours;
+        long long halfHours = llround(creditHours * 2.0);
+        totals.fixedQuality +=
+            llround(band.points * FIXED_POINTS_PER_POINT) * halfHours;
+        totals.fixedHalfHours += halfHours;
+    }
+}
+
+// Takes a course that addCourseToTotals added back out of the totals.
+void removeCourseFromTotals(GpaTotals& totals, double percent,
+                           double creditHours) {
+    const GradeBand& band = gradeBandFor(percent);
+    if (band.countsInGpa) {
+        totals.qualityPoints -= band.points * creditHours;
+        totals.credits -= creditHours;
+        long long halfHours = llround(creditHours * 2.0);
+        totals.fixedQuality -=
+            llround(band.points * FIXED_POINTS_PER_POINT) * halfHours;
+        totals.fixedHalfHours -= halfHours;
+    }
+}
+
+// Adds up quality points and credit hours over all graded courses.
+GpaTotals calculateGpaTotals(const CourseStore& courses) {
+    GpaTotals totals;
+    totals.qualityPoints = 0.0;
+    totals.credits = 0.0;
+    totals.fixedQuality = 0;
+    totals.fixedHalfHours = 0;
+
+    for (const Course& c : courses) {
+        if (c.work.empty()) {
+            continue; // skip ungraded courses
+        }
+
+        addCourseToTotals(totals, calculateCoursePercentage(c), c.creditHours);
+    }
+
+    return totals;
+}
+
+// Turns GPA totals into a GPA (0 if nothing is graded yet).
+double gpaFromTotals(const GpaTotals& totals) {
+    if (fixedPointMode()) {
+        // Whole numbers up to the last step, so the same courses always
+        // give the same GPA however the sums were grouped.
+        if (totals.fixedHalfHours == 0) {
+            return 0.0;
+        }
+        return static_cast<double>(totals.fixedQuality) /
+            static_cast<double>(totals.fixedHalfHours *
+                                FIXED_POINTS_PER_POINT);
+    }
+    if (totals.credits == 0.0) {
+        return 0.0; // no graded courses yet
+    }
+
+    return totals.qualityPoints / totals.credits;
+}
+
+// Computes overall GPA across all courses using credit-hour weighting.
+double calculateOverallGPA(const CourseStore& courses) {
+    GPA_TIME_METRIC(METRIC_OVERALL_GPA);
+    return gpaFromTotals(calculateGpaTotals(courses));
+}
+
+// Shows overall GPA in a user-friendly way.
+void showOverallGPA(const CourseStore& courses) {
+    if (courses.empty()) {
+        cout << "No courses available yet.\n";
+        return;
+    }
+
+    double gpa = calculateOverallGPA(courses);
+
+    // Check if there is at least one course with assignments.
+    bool hasGradedCourse = false;
+    for (const Course& c : courses) {
+        if (!c.work.empty()) {
+            hasGradedCourse = true;
+            break;
+        }
+    }
+
+    if (!hasGradedCourse) {
+        cout << "No graded courses yet. Add assignments first.\n";
+        return;
+    }
+
+    cout << "==========================================\n";
+    cout << "Overall GPA (4.0 scale): " << fixed << setprecision(2)
+         << gpa << "\n";
+    cout << "==========================================\n";
+}
+
+// ============================================================================
+// WHAT-IF GRADE SCENARIO
+// ============================================================================
+WhatIfOverlay::WhatIfOverlay(const CourseStore& courses)
+    : courses(courses), baseTotals(calculateGpaTotals(courses)) {}
+
+int WhatIfOverlay::findDelta(CourseHandle course) const {
+    // A scenario only touches a few courses, so a short search is enough.
+    for (size_t i = 0; i < deltas.size(); ++i) {
+        if (sameCourse(deltas[i].course, course)) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+bool WhatIfOverlay::addHypothetical(CourseHandle course, int category,
+                                    double earned, double max) {
+    GPA_TIME_METRIC(METRIC_WHATIF_ADD);
+    return addHypotheticals(course, category, (earned / max) * 100.0, 1);
+}
+
+bool WhatIfOverlay::addHypotheticals(CourseHandle course, int category,
+                                     double percentEach, int count) {
+    const Course* c = courses.get(course);
+    if (c == nullptr || count <= 0 || category < 0 ||
+        category >= static_cast<int>(c->categories.size())) {
+        return false;
+    }
+
+    int index = findDelta(course);
+    if (index == -1) {
+        Delta fresh;
+        fresh.course = course;
+        fresh.added.resize(c->categories.size());
+        fresh.addedCount = 0;
+        deltas.push_back(fresh);
+        index = static_cast<int>(deltas.size()) - 1;
+    }
+
+    vector<double>& list = deltas[index].added[category];
+    list.insert(upper_bound(list.begin(), list.end(), percentEach),
+                static_cast<size_t>(count), percentEach);
+    deltas[index].addedCount += count;
+    return true;
+}
+
+double WhatIfOverlay::coursePercentage(CourseHandle course) const {
+    const Course* c = courses.get(course);
+    if (c == nullptr) {
+        return 0.0;
+    }
+
+    int index = findDelta(course);
+    if (index == -1) {
+        return calculateCoursePercentage(*c);
+    }
+    return coursePercentageWith(*c, deltas[index].added);
+}
+
+bool WhatIfOverlay::courseIsGraded(CourseHandle course) const {
+    const Course* c = courses.get(course);
+    if (c == nullptr) {
+        return false;
+    }
+    return !c->work.empty() || findDelta(course) != -1;
+}
+
+double WhatIfOverlay::overallGPA() const {
+    GPA_TIME_METRIC(METRIC_WHATIF_GPA);
+    GpaTotals totals = baseTotals;
+
+    // Swap each touched course's real contribution for its what-if one.
+    for (const Delta& d : deltas) {
+        const Course& c = *courses.get(d.course);
+
+        if (!c.work.empty()) {
+            removeCourseFromTotals(totals, calculateCoursePercentage(c),
+                                   c.creditHours);
+        }
+
+        double newPercent = coursePercentageWith(c, d.added);
+        addCourseToTotals(totals, newPercent, c.creditHours);
+    }
+
+    return gpaFromTotals(totals);
+}
+
+int WhatIfOverlay::hypotheticalCount() const {
+    int count = 0;
+    for (const Delta& d : deltas) {
+        count += d.addedCount;
+    }
+    return count;
+}
+
+//7
+void whatIfScenario(const CourseStore& courses) {
+    if (courses.empty()) {
+        cout << "No courses available yet. Add a course first.\n";
+        return;
+    }
+
+    cout << "==========================================\n";
+    cout << "         WHAT-IF GRADE SCENARIO\n";
+    cout << "==========================================\n";
+    cout << "This feature lets you test hypothetical assignments.\n";
+    cout << "The program will NOT save them. It only shows what would\n";
+    cout << "happen if those assignments existed. You can stack several\n";
+    cout << "hypothetical assignments, in one or more courses.\n\n";
+
+    double oldGPA = calculateOverallGPA(courses);
+    WhatIfOverlay overlay(courses);
+    vector<CourseHandle> touched;   // courses in this scenario, in order
+
+    bool addMore = true;
+    while (addMore) {
+        listCoursesSummary(courses);
+
+        int id = readIntInRange(
+            "Enter the ID of the course for the what-if scenario: ",
+            MIN_COURSE_ID, MAX_COURSE_ID);
+
+        CourseHandle handle = courses.handleOf(id);
+        const Course* selected = courses.get(handle);
+        if (selected == nullptr) {
+            cout << "No course found with that ID.\n";
+        } else {
+            cout << "\nYou selected course: " << selected->name
+                 << " (ID " << selected->id << ")\n";
+            cout << "Credit hours: " << selected->creditHours << "\n\n";
+
+            if (overlay.courseIsGraded(handle)) {
+                double currentPercent = overlay.coursePercentage(handle);
+                const char* currentLetter = percentageToLetter(currentPercent);
+
+                cout << "Course average so far in this scenario: "
+                     << fixed << setprecision(2)
+                     << currentPercent << "% (" << currentLetter << ")\n";
+            } else {
+                cout << "This course currently has NO assignments.\n";
+                cout << "So its course average is N/A for now.\n";
+            }
+
+            cout << "Overall GPA so far in this scenario: "
+                 << fixed << setprecision(2)
+                 << overlay.overallGPA() << " (on a 4.0 scale)\n\n";
+
+            string hypotheticalName;
+            cout << "Enter a name for the hypothetical assignment\n";
+            cout << "(for example, \"Final Exam\" or \"Big Project\"):\n";
+            getline(cin, hypotheticalName);
+
+            double max = readDoubleInRange(
+                "Enter MAXIMUM possible points on this hypothetical assignment: ",
+                1.0, 10000.0);
+
+            double earned = readDoubleInRange(
+                "Enter the points you THINK you might earn: ",
+                0.0, max);
+
+            bool seenBefore = false;
+            for (const CourseHandle& h : touched) {
+                if (sameCourse(h, handle)) {
+                    seenBefore = true;
+                    break;
+                }
+            }
+            if (!seenBefore) {
+                touched.push_back(handle);
+            }
+
+            int category = askCategory(*selected);
+            overlay.addHypothetical(handle, category, earned, max);
+            cout << "Added '" << hypotheticalName << "' to the scenario.\n";
+        }
+
+        int more = readIntInRange(
+            "Add another hypothetical assignment? (1 = Yes, 0 = No): ", 0, 1);
+        addMore = (more == 1);
+        cout << "\n";
+    }
+
+    if (overlay.hypotheticalCount() == 0) {
+        cout << "No hypothetical assignments were entered.\n";
+        return;
+    }
+
+    cout << "------------------------------------------\n";
+    cout << "RESULTS OF WHAT-IF SCENARIO\n";
+    cout << "Hypothetical assignments: " << overlay.hypotheticalCount()
+         << "\n\n";
+
+    for (const CourseHandle& handle : touched) {
+        const Course& c = *courses.get(handle);
+        cout << "Course: " << c.name << "\n";
+
+        if (!c.work.empty()) {
+            double oldCoursePercent = calculateCoursePercentage(c);
+            const char* oldCourseLetter = percentageToLetter(oldCoursePercent);
+
+            cout << "  Old course average: " << fixed << setprecision(2)
+                 << oldCoursePercent << "% (" << oldCourseLetter << ")\n";
+        } else {
+            cout << "  Old course average: N/A (no assignments before what-if)\n";
+        }
+
+        double newCoursePercent = overlay.coursePercentage(handle);
+        const char* newCourseLetter = percentageToLetter(newCoursePercent);
+
+        cout << "  New course average WITH hypothetical assignments: "
+             << fixed << setprecision(2) << newCoursePercent
+             << "% (" << newCourseLetter << ")\n\n";
+    }
+
+    cout << "Old overall GPA: " << fixed << setprecision(2) << oldGPA << "\n";
+    cout << "New overall GPA WITH hypothetical assignments: "
+         << fixed << setprecision(2) << overlay.overallGPA() << "\n";
+    cout << "------------------------------------------\n";
+    cout << "Remember: These changes were NOT saved.\n";
+    cout << "It is only a simulation to help you plan.\n";
+    cout << "------------------------------------------\n";
+}
+
+// ============================================================================
+// MINIMUM-SCORE SOLVER
+// ============================================================================
+// Answers "what do I need on the rest of my work to get a B?" in one step.
+//
+// The k pending assignments all go into one category, and the student is
+// assumed to score the same fraction f (0..1) on each of them. Without a
+// drop-lowest rule in that category every assignment counts the same in
+// the category average, so the course average is a straight line in f:
+//     average(f) = average(0) + (average(1) - average(0)) * f
+// and solving average(f) = boundary gives the required f directly. With
+// drops the line bends (low scores stop counting), but the average still
+// never goes down as f goes up, so f is found by bisection instead. The
+// points needed on pending assignment i are f * max_i.
+
+// What it takes to reach one grade boundary.
+struct BoundaryRequirement {
+    Grade grade;
+    double boundary;         // lowest course percentage for this letter
+    double requiredPercent;  // percent needed on every pending assignment
+    bool alreadySecured;     // reached even with 0 on all pending work
+    bool reachable;          // false if more than 100% would be needed
+    double resultingGPA;     // overall GPA when exactly the minimum is earned
+};
+
+// Fills "results" with one entry per grade boundary of the active grading
+// scale (A, B, C, D on the default scale) and
+// "requiredEarned" with the points needed on each pending assignment, row
+// by row: requiredEarned[b * pendingMax.size() + i] is for boundary b and
+// pending assignment i. Unreachable boundaries get 0 points. The pending
+// assignments belong to "category" of the course.
+void solveMinimumScores(const CourseStore& courses, CourseHandle course,
+                        int category, const vector<double>& pendingMax,
+                        vector<BoundaryRequirement>& results,
+                        vector<double>& requiredEarned) {
+    results.clear();
+    // Every band except the last (which starts at 0%) has a boundary.
+    const GradingScale& scale = gradingScale();
+    const int boundaryCount = scale.bandCount - 1;
+    requiredEarned.assign(pendingMax.size() * boundaryCount, 0.0);
+
+    const Course* c = courses.get(course);
+    if (c == nullptr || pendingMax.empty() || category < 0 ||
+        category >= static_cast<int>(c->categories.size())) {
+        return;
+    }
+
+    const int k = static_cast<int>(pendingMax.size());
+    const bool hasDrops = c->categories[category].dropLowest > 0;
+
+    // Course average when every pending assignment scores "fraction".
+    vector<vector<double> > added(c->categories.size());
+    auto averageAt = [&](double fraction) {
+        added[category].assign(static_cast<size_t>(k), 100.0 * fraction);
+        return coursePercentageWith(*c, added);
+    };
+    const double averageAtZero = averageAt(0.0);
+    const double averageAtOne = averageAt(1.0);
+
+    for (int b = 0; b < boundaryCount; ++b) {
+        BoundaryRequirement r;
+        r.grade = scale.bands[b].grade;
+        r.boundary = scale.bands[b].minPercent;
+
+        double fraction;
+        r.alreadySecured = averageAtZero >= r.boundary;
+        if (r.alreadySecured) {
+            fraction = 0.0;
+        } else if (averageAtOne < r.boundary) {
+            fraction = 2.0;  // not reachable
+        } else if (!hasDrops) {
+            // Straight line: fraction needed on every pending assignment.
+            fraction = (r.boundary - averageAtZero) /
+                (averageAtOne - averageAtZero);
+            if (fraction < 0.0) {
+                fraction = 0.0;
+            }
+
+            // Rounding can leave the average a hair under the boundary,
+            // which gradeBandFor would round down to the next grade. Nudge
+            // the fraction up until the grade is really reached.
+            while (fraction <= 1.0 && averageAt(fraction) < r.boundary) {
+                fraction = nextafter(fraction, 2.0);
+            }
+        } else {
+            // Bisection: averageAt(low) < boundary <= averageAt(high).
+            double low = 0.0;
+            double high = 1.0;
+            for (int step = 0; step < 100; ++step) {
+                double middle = low + (high - low) / 2.0;
+                if (middle <= low || middle >= high) {
+                    break;  // low and high are neighboring doubles
+                }
+                if (averageAt(middle) >= r.boundary) {
+                    high = middle;
+                } else {
+                    low = middle;
+                }
+            }
+            fraction = high;
+        }
+
+        r.reachable = fraction <= 1.0;
+        r.requiredPercent = fraction * 100.0;
+        r.resultingGPA = 0.0;
+
+        if (r.reachable) {
+            // Same fraction of every pending assignment's max points. This
+            // simple loop over a contiguous array is easy for the compiler
+            // to vectorize, so many pending assignments cost very little.
+            double* row = &requiredEarned[static_cast<size_t>(b) * k];
+            const double* maxPoints = pendingMax.data();
+            for (int i = 0; i < k; ++i) {
+                row[i] = fraction * maxPoints[i];
+            }
+
+            WhatIfOverlay overlay(courses);
+            overlay.addHypotheticals(course, category, 100.0 * fraction, k);
+            r.resultingGPA = overlay.overallGPA();
+        }
+
+        results.push_back(r);
+    }
+}
+
+// Menu screen for the solver.
+void minimumScoreSolver(const CourseStore& courses) {
+    if (courses.empty()) {
+        cout << "No courses available yet. Add a course first.\n";
+        return;
+    }
+
+    cout << "==========================================\n";
+    cout << "   MINIMUM SCORE NEEDED FOR EACH GRADE\n";
+    cout << "==========================================\n";
+    cout << "Enter the assignments you still have to turn in, and the\n";
+    cout << "program shows the lowest score you need on them to reach\n";
+    cout << "each letter grade (assuming the same percentage on each).\n\n";
+
+    listCoursesSummary(courses);
+
+    int id = readIntInRange(
+        "Enter the ID of the course: ",
+        MIN_COURSE_ID, MAX_COURSE_ID);
+
+    CourseHandle handle = courses.handleOf(id);
+    const Course* c = courses.get(handle);
+    if (c == nullptr) {
+        cout << "No course found with that ID.\n";
+        return;
+    }
+
+    int category = askCategory(*c);
+
+    int pendingCount = readIntInRange(
+        "How many assignments are still pending? ", 1, 1000);
+
+    vector<double> pendingMax;
+    pendingMax.reserve(pendingCount);
+    for (int i = 0; i < pendingCount; ++i) {
+        cout << "Pending assignment " << (i + 1) << ": ";
+        pendingMax.push_back(readDoubleInRange(
+            "enter its MAXIMUM possible points: ", 1.0, 10000.0));
+    }
+
+    vector<BoundaryRequirement> results;
+    vector<double> requiredEarned;
+    solveMinimumScores(courses, handle, category, pendingMax, results,
+                       requiredEarned);
+
+    cout << "\n------------------------------------------\n";
+    cout << "Course: " << c->name << "\n";
+    if (!c->work.empty()) {
+        double percent = calculateCoursePercentage(*c);
+        cout << "Current course average: " << fixed << setprecision(2)
+             << percent << "% (" << percentageToLetter(percent) << ")\n";
+    } else {
+        cout << "Current course average: N/A (no assignments yet)\n";
+    }
+    cout << "------------------------------------------\n";
+
+    for (size_t b = 0; b < results.size(); ++b) {
+        const BoundaryRequirement& r = results[b];
+
+        cout << gradeName(r.grade) << " (" << fixed << setprecision(2)
+             << r.boundary << "% or higher): ";
+
+        if (!r.reachable) {
+            cout << "not reachable, even with full points.\n";
+            continue;
+        }
+
+        if (r.alreadySecured) {
+            cout << "already secured, even with 0 points.\n";
+        } else {
+            cout << "need " << fixed << setprecision(2)
+                 << r.requiredPercent << "% on each pending assignment.\n";
+        }
+
+        // Only list every assignment when there are just a few of them.
+        if (!r.alreadySecured && pendingMax.size() <= 10) {
+            for (size_t i = 0; i < pendingMax.size(); ++i) {
+                cout << "    Pending assignment " << (i + 1) << ": "
+                     << fixed << setprecision(2)
+                     << requiredEarned[b * pendingMax.size() + i]
+                     << " / " << pendingMax[i] << " points\n";
+            }
+        }
+
+        cout << "    Overall GPA with this grade: " << fixed
+             << setprecision(2) << r.resultingGPA << "\n";
+    }
+
+    cout << "------------------------------------------\n";
+}
+
+// ============================================================================
+// GRADE FORECAST (MONTE CARLO)
+// ============================================================================
+// Answers "how likely am I to end up with an A, and where will my GPA
+// land?" while some work is still to come.
+//
+// Every pending assignment gets a score distribution: a normal curve, cut
+// off at 0% and 100%, whose mean and spread are fitted from the scores the
+// student already has - in the same category if there are at least
+// FORECAST_MIN_SAMPLES of them, else in the same course, else in every
+// course, else FORECAST_DEFAULT_MEAN and FORECAST_DEFAULT_SPREAD. The rest
+// of the term is then played out many times. Each run draws a score for
+// every pending assignment, works out the final course averages the same
+// way the what-if scenario does (drop-lowest rules included) and counts
+// the letter grades and the GPA it ends with.
+//
+// Runs are handed out in chunks of FORECAST_CHUNK_RUNS. Every chunk has
+// its own random stream, seeded from the forecast seed and the chunk
+// number, so a forecast only depends on its seed and run count and not on
+// how many threads share the chunks. The normal scores are made in blocks
+// (all draws of one run at a time) with the Box-Muller transform, and each
+// thread sizes its scratch lists before the first run, so the runs never
+// allocate.
+
+const int FORECAST_MIN_SAMPLES = 3;
+const double FORECAST_DEFAULT_MEAN = 85.0;
+const double FORECAST_DEFAULT_SPREAD = 10.0;
+const double FORECAST_MIN_SPREAD = 3.0;    // no score is ever a sure thing
+const size_t FORECAST_CHUNK_RUNS = 4096;
+const size_t FORECAST_DEFAULT_RUNS = 100000;
+const size_t FORECAST_MAX_RUNS = 100000000;
+const uint64_t FORECAST_SEED = 2436;
+
+// One assignment that is still to come and its score distribution, in
+// percent of its maximum points.
+struct PendingWork {
+    CourseHandle course;
+    int category;     // category index in that course
+    double mean;      // expected percentage
+    double spread;    // standard deviation of the percentage
+};
+
+// What a forecast found. Courses are listed in the order they first appear
+// in the pending work.
+struct ForecastResult {
+    size_t runs;
+    vector<CourseHandle> courses;    // the courses with pending work
+    vector<long long> gradeCounts;   // GRADE_COUNT per course: runs ending
+                                     // with each grade (indexed by Grade)
+    vector<double> meanPercent;      // average final percentage per course
+    vector<long long> gpaBins;       // runs by final GPA, 0.01 per bin
+    double meanGpa;
+};
+
+// Bins of 0.01 from 0 up to 5 grade points (the highest any scale gives).
+const size_t FORECAST_GPA_BINS = 501;
+
+namespace {
+
+// xoshiro256** (Blackman and Vigna): a small, fast generator that is more
+// than good enough for simulation. The state is filled through splitmix64,
+// so nearby seeds still give unrelated streams.
+class ForecastRandom {
+public:
+    explicit ForecastRandom(uint64_t seed) {
+        for (int i = 0; i < 4; ++i) {
+            seed += 0x9E3779B97F4A7C15ull;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            state[i] = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t next() {
+        uint64_t result = rotate(state[1] * 5, 7) * 9;
+        uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotate(state[3], 45);
+        return result;
+    }
+
+    // Fills out[0 .. count) with standard normal values; "count" must be
+    // even. The uniforms come first and the transform runs over the whole
+    // block, so that loop has no dependency from one pair to the next.
+    void normals(double* out, size_t count) {
+        const double toUnit = 1.0 / 9007199254740992.0;  // 2^-53
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = static_cast<double>((next() >> 11) + 1) * toUnit;
+        }
+        const double twoPi = 6.283185307179586;
+        for (size_t i = 0; i < count; i += 2) {
+            double radius = sqrt(-2.0 * log(out[i]));
+            double angle = twoPi * out[i + 1];
+            out[i] = radius * cos(angle);
+            out[i + 1] = radius * sin(angle);
+        }
+    }
+
+private:
+    static uint64_t rotate(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    uint64_t state[4];
+};
+
+// Running count, sum and sum of squares of some percentages.
+struct ScoreMoments {
+    int count = 0;
+    double sum = 0.0;
+    double sumSquares = 0.0;
+
+    void add(double percent) {
+        count++;
+        sum += percent;
+        sumSquares += percent * percent;
+    }
+};
+
+// One thread's scratch space and partial counts.
+struct ForecastWorker {
+    vector<double> draws;                      // normal values of one run
+    vector<vector<vector<double> > > added;    // per course, per category
+    vector<long long> gradeCounts;
+    vector<long long> gpaBins;
+};
+
+} // namespace
+
+// Fits the score distribution of pending work in "category" of "course"
+// from the scores the student already has (see above). "samples" is the
+// number of scores it was fitted from, or 0 for the default.
+void fitPendingScores(const CourseStore& courses, CourseHandle course,
+                      int category, double& mean, double& spread,
+                      int& samples) {
+    ScoreMoments inCategory;
+    ScoreMoments inCourse;
+    ScoreMoments everywhere;
+    const Course* target = courses.get(course);
+
+    for (const Course& c : courses) {
+        bool isTarget = &c == target;
+        for (size_t i = 0; i < c.work.size(); ++i) {
+            if (c.work.extraCredit[i] != 0) {
+                continue;  // extra credit says little about regular work
+            }
+            double percent = c.work.earned[i] / c.work.max[i] * 100.0;
+            everywhere.add(percent);
+            if (isTarget) {
+                inCourse.add(percent);
+                if (c.work.category[i] == category) {
+                    inCategory.add(percent);
+                }
+            }
+        }
+    }
+
+    const ScoreMoments* fit = nullptr;
+    if (inCategory.count >= FORECAST_MIN_SAMPLES) {
+        fit = &inCategory;
+    } else if (inCourse.count >= FORECAST_MIN_SAMPLES) {
+        fit = &inCourse;
+    } else if (everywhere.count >= FORECAST_MIN_SAMPLES) {
+        fit = &everywhere;
+    }
+
+    if (fit == nullptr) {
+        mean = FORECAST_DEFAULT_MEAN;
+        spread = FORECAST_DEFAULT_SPREAD;
+        samples = 0;
+        return;
+    }
+
+    mean = fit->sum / fit->count;
+    double variance = (fit->sumSquares - fit->sum * mean) / (fit->count - 1);
+    spread = variance > 0.0 ? sqrt(variance) : 0.0;
+    if (spread < FORECAST_MIN_SPREAD) {
+        spread = FORECAST_MIN_SPREAD;
+    }
+    samples = fit->count;
+}
+
+// Plays out the rest of the term "runs" times on "threads" threads and
+// fills "result". Pending work for courses that no longer exist (or with a
+// bad category) is ignored. The same seed and run count always give the
+// same result.
+void forecastGrades(const CourseStore& courses,
+                    const vector<PendingWork>& pending, size_t runs,
+                    unsigned threads, uint64_t seed, ForecastResult& result) {
+    result.runs = runs;
+    result.courses.clear();
+    result.meanPercent.clear();
+    result.gpaBins.assign(FORECAST_GPA_BINS, 0);
+    result.meanGpa = 0.0;
+
+    // Group the pending work by course: pending[order[first[c] ..
+    // first[c + 1])] belongs to result.courses[c].
+    vector<const Course*> forecastCourses;
+    vector<vector<size_t> > byCourse;
+    for (size_t i = 0; i < pending.size(); ++i) {
+        const Course* c = courses.get(pending[i].course);
+        if (c == nullptr || pending[i].category < 0 ||
+            pending[i].category >= static_cast<int>(c->categories.size())) {
+            continue;
+        }
+        size_t slot = 0;
+        while (slot < forecastCourses.size() && forecastCourses[slot] != c) {
+            slot++;
+        }
+        if (slot == forecastCourses.size()) {
+            forecastCourses.push_back(c);
+            result.courses.push_back(pending[i].course);
+            byCourse.push_back(vector<size_t>());
+        }
+        byCourse[slot].push_back(i);
+    }
+    vector<size_t> order;
+    vector<size_t> first(1, 0);
+    for (const vector<size_t>& list : byCourse) {
+        order.insert(order.end(), list.begin(), list.end());
+        first.push_back(order.size());
+    }
+
+    const size_t courseCount = forecastCourses.size();
+    result.gradeCounts.assign(courseCount * GRADE_COUNT, 0);
+    result.meanPercent.assign(courseCount, 0.0);
+    if (runs == 0) {
+        return;
+    }
+
+    // The courses without pending work end the same way in every run.
+    GpaTotals fixedTotals;
+    fixedTotals.qualityPoints = 0.0;
+    fixedTotals.credits = 0.0;
+    fixedTotals.fixedQuality = 0;
+    fixedTotals.fixedHalfHours = 0;
+    for (const Course& c : courses) {
+        bool forecast = false;
+        for (const Course* f : forecastCourses) {
+            forecast = forecast || f == &c;
+        }
+        if (!forecast && !c.work.empty()) {
+            addCourseToTotals(fixedTotals, calculateCoursePercentage(c),
+                              c.creditHours);
+        }
+    }
+
+    // Per-chunk sums, added up in chunk order at the end so the averages
+    // do not depend on the thread count either.
+    const size_t chunks = (runs + FORECAST_CHUNK_RUNS - 1) / FORECAST_CHUNK_RUNS;
+    vector<double> chunkGpa(chunks, 0.0);
+    vector<double> chunkPercent(chunks * courseCount, 0.0);
+
+    if (threads == 0) {
+        threads = 1;
+    }
+    const size_t drawCount = (order.size() + 1) & ~static_cast<size_t>(1);
+    vector<ForecastWorker> workers(threads);
+    for (ForecastWorker& w : workers) {
+        w.draws.assign(drawCount, 0.0);
+        w.added.resize(courseCount);
+        for (size_t c = 0; c < courseCount; ++c) {
+            w.added[c].resize(forecastCourses[c]->categories.size());
+            for (size_t k = first[c]; k < first[c + 1]; ++k) {
+                w.added[c][pending[order[k]].category].reserve(
+                    first[c + 1] - first[c]);
+            }
+        }
+        w.gradeCounts.assign(courseCount * GRADE_COUNT, 0);
+        w.gpaBins.assign(FORECAST_GPA_BINS, 0);
+    }
+
+    parallelForWorkers(chunks, threads, 1,
+                       [&](unsigned self, size_t begin, size_t end) {
+        ForecastWorker& w = workers[self];
+        for (size_t chunk = begin; chunk < end; ++chunk) {
+            ForecastRandom random(seed ^ (chunk * 0xD1B54A32D192ED03ull));
+            size_t chunkEnd = (chunk + 1) * FORECAST_CHUNK_RUNS;
+            if (chunkEnd > runs) {
+                chunkEnd = runs;
+            }
+
+            double gpaSum = 0.0;
+            double* percentSums = courseCount == 0
+                ? nullptr : &chunkPercent[chunk * courseCount];
+            for (size_t run = chunk * FORECAST_CHUNK_RUNS; run < chunkEnd;
+                 ++run) {
+                random.normals(w.draws.data(), drawCount);
+
+                GpaTotals totals = fixedTotals;
+                for (size_t c = 0; c < courseCount; ++c) {
+                    const Course& course = *forecastCourses[c];
+                    vector<vector<double> >& added = w.added[c];
+                    for (vector<double>& list : added) {
+                        list.clear();
+                    }
+                    for (size_t k = first[c]; k < first[c + 1]; ++k) {
+                        const PendingWork& p = pending[order[k]];
+                        double percent = p.mean + p.spread * w.draws[k];
+                        percent = percent < 0.0 ? 0.0
+                                : percent > 100.0 ? 100.0 : percent;
+                        added[p.category].push_back(percent);
+                    }
+                    // Drop-lowest merging wants the added scores sorted.
+                    for (size_t k = 0; k < added.size(); ++k) {
+                        if (course.categories[k].dropLowest > 0 &&
+                            added[k].size() > 1) {
+                            sort(added[k].begin(), added[k].end());
+                        }
+                    }
+
+                    double percent = coursePercentageWith(course, added);
+                    const GradeBand& band = gradeBandFor(percent);
+                    w.gradeCounts[c * GRADE_COUNT + band.grade]++;
+                    percentSums[c] += percent;
+                    addCourseToTotals(totals, percent, course.creditHours);
+                }
+
+                double gpa = gpaFromTotals(totals);
+                gpaSum += gpa;
+                size_t bin = static_cast<size_t>(floor(gpa * 100.0 + 0.5));
+                w.gpaBins[bin < FORECAST_GPA_BINS ? bin
+                                                  : FORECAST_GPA_BINS - 1]++;
+            }
+            chunkGpa[chunk] = gpaSum;
+        }
+    });
+
+    for (const ForecastWorker& w : workers) {
+        for (size_t i = 0; i < w.gradeCounts.size(); ++i) {
+            result.gradeCounts[i] += w.gradeCounts[i];
+        }
+        for (size_t i = 0; i < FORECAST_GPA_BINS; ++i) {
+            result.gpaBins[i] += w.gpaBins[i];
+        }
+    }
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        result.meanGpa += chunkGpa[chunk];
+        for (size_t c = 0; c < courseCount; ++c) {
+            result.meanPercent[c] += chunkPercent[chunk * courseCount + c];
+        }
+    }
+    result.meanGpa /= static_cast<double>(runs);
+    for (double& mean : result.meanPercent) {
+        mean /= static_cast<double>(runs);
+    }
+}
+
+// The GPA that "fraction" (0..1) of the runs stayed at or under, to the
+// nearest 0.01.
+double forecastGpaPercentile(const ForecastResult& result, double fraction) {
+    long long target = static_cast<long long>(
+        ceil(fraction * static_cast<double>(result.runs)));
+    if (target < 1) {
+        target = 1;
+    }
+    long long seen = 0;
+    for (size_t i = 0; i < result.gpaBins.size(); ++i) {
+        seen += result.gpaBins[i];
+        if (seen >= target) {
+            return static_cast<double>(i) / 100.0;
+        }
+    }
+    return static_cast<double>(result.gpaBins.size() - 1) / 100.0;
+}
+
+// Menu front end: asks for the pending work of one or more courses, runs
+// the forecast on every core and prints the chance of each letter grade
+// and the spread of the final GPA.
+void forecastMenu(const CourseStore& courses) {
+    if (courses.empty()) {
+        cout << "No courses available yet. Add a course first.\n";
+        return;
+    }
+
+    cout << "==========================================\n";
+    cout << "   FORECAST FINAL GRADES (SIMULATION)\n";
+    cout << "==========================================\n";
+    cout << "Enter the assignments you still have to turn in. The program\n";
+    cout << "plays out the rest of the term many times, with scores like\n";
+    cout << "the ones you already have, and shows how likely each final\n";
+    cout << "grade is.\n\n";
+
+    listCoursesSummary(courses);
+
+    vector<PendingWork> pending;
+    while (true) {
+        int id = readIntInRange(
+            "Enter the ID of a course with pending work (0 when done): ",
+            0, MAX_COURSE_ID);
+        if (id == 0) {
+            break;
+        }
+
+        CourseHandle handle = courses.handleOf(id);
+        const Course* c = courses.get(handle);
+        if (c == nullptr) {
+            cout << "No course found with that ID.\n";
+            continue;
+        }
+
+        PendingWork work;
+        work.course = handle;
+        work.category = askCategory(*c);
+        int count = readIntInRange(
+            "How many assignments are still pending? ", 1, 1000);
+
+        int samples = 0;
+        fitPendingScores(courses, handle, work.category, work.mean,
+                         work.spread, samples);
+        if (samples > 0) {
+            cout << "From your " << samples << " earlier score(s), each "
+                 << "pending score is expected around " << fixed
+                 << setprecision(1) << work.mean << "% (give or take "
+                 << work.spread << "%).\n";
+        } else {
+            cout << "Not enough earlier scores; assuming about " << fixed
+                 << setprecision(1) << work.mean << "% (give or take "
+                 << work.spread << "%).\n";
+        }
+        int own = readIntInRange(
+            "Enter 1 to use this, or 2 to enter your own: ", 1, 2);
+        if (own == 2) {
+            work.mean = readDoubleInRange(
+                "Expected score on each (percent): ", 0.0, 100.0);
+            work.spread = readDoubleInRange(
+                "Give or take how many percent? ", 0.0, 50.0);
+        }
+
+        pending.insert(pending.end(), static_cast<size_t>(count), work);
+        cout << "\n";
+    }
+
+    if (pending.empty()) {
+        cout << "No pending work entered.\n";
+        return;
+    }
+
+    int runs = readIntInRange("How many simulated terms? (1000 - 10000000): ",
+                              1000, 10000000);
+
+    ForecastResult result;
+    auto start = chrono::steady_clock::now();
+    forecastGrades(courses, pending, static_cast<size_t>(runs),
+                   defaultThreadCount(), FORECAST_SEED, result);
+    double seconds = chrono::duration<double>(
+        chrono::steady_clock::now() - start).count();
+
+    const GradingScale& scale = gradingScale();
+    cout << "\n------------------------------------------\n";
+    cout << "Simulated " << runs << " terms in " << fixed << setprecision(2)
+         << seconds << " s.\n";
+    cout << "------------------------------------------\n";
+    for (size_t c = 0; c < result.courses.size(); ++c) {
+        const Course* course = courses.get(result.courses[c]);
+        cout << course->name << ": expected final average " << fixed
+             << setprecision(2) << result.meanPercent[c] << "%\n";
+        for (int i = 0; i < scale.bandCount; ++i) {
+            Grade grade = scale.bands[i].grade;
+            long long count = result.gradeCounts[c * GRADE_COUNT + grade];
+            if (count == 0) {
+                continue;
+            }
+            cout << "    " << gradeName(grade) << ": " << fixed
+                 << setprecision(1)
+                 << 100.0 * static_cast<double>(count) / runs << "%\n";
+        }
+    }
+    cout << "Overall GPA: expected " << fixed << setprecision(2)
+         << result.meanGpa << "\n";
+    cout << "    90% of the runs ended between "
+         << forecastGpaPercentile(result, 0.05) << " and "
+         << forecastGpaPercentile(result, 0.95) << " (median "
+         << forecastGpaPercentile(result, 0.5) << ")\n";
+    cout << "------------------------------------------\n";
+}
+
+// ============================================================================
+// EDITING / DELETING COURSES AND ASSIGNMENTS
+// ============================================================================
+
+// Rename a course.
+//8
+void renameCourse(Gradebook& book) {
+    const CourseStore& courses = book.courses;
+    if (courses.empty()) {
+        cout << "No courses available.\n";
+        return;
+    }
+
+    listCoursesSummary(courses);
+
+    int id = readIntInRange(
+        "Enter the ID of the course you want to rename: ",
+        MIN_COURSE_ID, MAX_COURSE_ID);
+
+    int index = findCourseIndexById(courses, id);
+    if (index == -1) {
+        cout << "No course found with that ID.\n";
+        return;
+    }
+
+    const Course& c = courses[index];
 
     cout << "Current name: " << c.name << "\n";
     cout << "Enter new course name: ";
     string newName;
     getline(cin, newName);
 
-    if (newName.empty()) {
-        cout << "Name not changed (empty name entered).\n";
+    if (newName.empty()) {
+        cout << "Name not changed (empty name entered).\n";
+        return;
+    }
+
+    string error;
+    if (!applyMutation(book, makeRenameCourse(id, newName), error)) {
+        cout << "Name not changed: " << error << ".\n";
+        return;
+    }
+    cout << "Course name updated.\n";
+}
+
+// Change course credit hours.
+void changeCourseCreditHours(Gradebook& book) {
+    const CourseStore& courses = book.courses;
+    if (courses.empty()) {
+        cout << "No courses available.\n";
+        return;
+    }
+
+    listCoursesSummary(courses);
+
+    int id = readIntInRange(
+        "Enter the ID of the course whose credit hours you want to change: ",
+        MIN_COURSE_ID, MAX_COURSE_ID);
+
+    int index = findCourseIndexById(courses, id);
+    if (index == -1) {
+        cout << "No course found with that ID.\n";
+        return;
+    }
+
+    const Course& c = courses[index];
+
+    cout << "Current credit hours for " << c.name
+         << ": " << c.creditHours << "\n";
+
+    double newCredits = readDoubleInRange(
+        "Enter new credit hours (0.5 to 6.0): ", 0.5, 6.0);
+
+    string error;
+    if (!applyMutation(book, makeSetCreditHours(id, newCredits), error)) {
+        cout << "Credit hours not changed: " << error << ".\n";
+        return;
+    }
+    cout << "Credit hours updated.\n";
+}
+
+// Edit an assignment's scores in a chosen course.
+void editAssignmentInCourse(Gradebook& book) {
+    const CourseStore& courses = book.courses;
+    if (courses.empty()) {
+        cout << "No courses available.\n";
+        return;
+    }
+
+    listCoursesSummary(courses);
+
+    int id = readIntInRange(
+        "Enter the ID of the course containing the assignment: ",
+        MIN_COURSE_ID, MAX_COURSE_ID);
+
+    int index = findCourseIndexById(courses, id);
+    if (index == -1) {
+        cout << "No course found with that ID.\n";
+        return;
+    }
+
+    const Course& c = courses[index];
+
+    if (c.work.empty()) {
+        cout << "This course has no assignments to edit.\n";
+        return;
+    }
+
+    cout << "Assignments for course: " << c.name << "\n";
+    for (size_t i = 0; i < c.work.size(); ++i) {
+        cout << (i + 1) << ". " << c.work.names[i]
+             << " (earned " << c.work.earned[i] << " / "
+             << c.work.max[i] << ")\n";
+    }
+
+    int choice = readIntInRange(
+        "Enter the number of the assignment to edit: ",
+        1, static_cast<int>(c.work.size()));
+
+    Assignment a = c.work[choice - 1];
+
+    cout << "Editing assignment: " << a.name << "\n";
+
+    // Let user either keep the name or change it
+    cout << "Current name: " << a.name << "\n";
+    cout << "Enter a new name, or just press Enter to keep it: ";
+    string newName;
+    getline(cin, newName);
+    if (!newName.empty()) {
+        a.name = newName;
+    }
+
+    double newMax = readDoubleInRange(
+        "Enter NEW maximum points: ", 1.0, 10000.0);
+
+    double newEarned = readDoubleInRange(
+        "Enter NEW points earned: ", 0.0, newMax);
+
+    a.max = newMax;
+    a.earned = newEarned;
+
+    string error;
+    if (!applyMutation(book, makeEditAssignment(id, choice - 1, a), error)) {
+        cout << "Assignment not updated: " << error << ".\n";
+        return;
+    }
+
+    cout << "Assignment updated.\n";
+}
+
+// Delete an assignment from a course.
+void deleteAssignmentFromCourse(Gradebook& book) {
+    const CourseStore& courses = book.courses;
+    if (courses.empty()) {
+        cout << "No courses available.\n";
+        return;
+    }
+
+    listCoursesSummary(courses);
+
+    int id = readIntInRange(
+        "Enter the ID of the course containing the assignment to delete: ",
+        MIN_COURSE_ID, MAX_COURSE_ID);
+
+    int index = findCourseIndexById(courses, id);
+    if (index == -1) {
+        cout << "No course found with that ID.\n";
+        return;
+    }
+
+    const Course& c = courses[index];
+
+    if (c.work.empty()) {
+        cout << "This course has no assignments to delete.\n";
+        return;
+    }
+
+    cout << "Assignments for course: " << c.name << "\n";
+    for (size_t i = 0; i < c.work.size(); ++i) {
+        cout << (i + 1) << ". " << c.work.names[i]
+             << " (earned " << c.work.earned[i] << " / "
+             << c.work.max[i] << ")\n";
+    }
+
+    int choice = readIntInRange(
+        "Enter the number of the assignment to DELETE: ",
+        1, static_cast<int>(c.work.size()));
+
+    cout << "Are you sure you want to delete assignment '"
+         << c.work.names[choice - 1] << "'? (1 = Yes, 0 = No): ";
+    int confirm;
+    cin >> confirm;
+    if (cin.fail()) {
+        cin.clear();
+    }
+    clearInputLine();
+
+    if (confirm != 1) {
+        cout << "Deletion cancelled.\n";
+        return;
+    }
+
+    string error;
+    if (!applyMutation(book, makeDeleteAssignment(id, choice - 1), error)) {
+        cout << "Assignment not deleted: " << error << ".\n";
+        return;
+    }
+    cout << "Assignment deleted.\n";
+}
+
+// Delete a course completely.
+void deleteCourse(Gradebook& book) {
+    const CourseStore& courses = book.courses;
+    if (courses.empty()) {
+        cout << "No courses available.\n";
+        return;
+    }
+
+    listCoursesSummary(courses);
+
+    int id = readIntInRange(
+        "Enter the ID of the course to DELETE: ",
+        MIN_COURSE_ID, MAX_COURSE_ID);
+
+    int index = findCourseIndexById(courses, id);
+    if (index == -1) {
+        cout << "No course found with that ID.\n";
+        return;
+    }
+
+    const Course& c = courses[index];
+
+    cout << "Are you sure you want to delete the entire course '"
+         << c.name << "' and all its assignments? (1 = Yes, 0 = No): ";
+    int confirm;
+    cin >> confirm;
+    if (cin.fail()) {
+        cin.clear();
+    }
+    clearInputLine();
+
+    if (confirm != 1) {
+        cout << "Course deletion cancelled.\n";
+        return;
+    }
+
+    string error;
+    if (!applyMutation(book, makeDeleteCourse(id), error)) {
+        cout << "Course not deleted: " << error << ".\n";
+        return;
+    }
+    cout << "Course deleted.\n";
+}
+
+// ============================================================================
+// GRADE DISTRIBUTION REPORT
+// ============================================================================
+
+// Shows how many courses currently have each grade of the grading scale
+// (A, B, C, D, or F on the default scale).
+void showGradeDistribution(const Gradebook& book) {
+    if (book.courses.empty()) {
+        cout << "No courses available.\n";
+        return;
+    }
+
+    GradeCounts counts = book.grades.counts();
+
+    if (counts.total == 0) {
+        cout << "No graded courses yet. Add assignments first.\n";
+        return;
+    }
+
+    const GradingScale& scale = gradingScale();
+
+    cout << "==========================================\n";
+    cout << "         GRADE DISTRIBUTION REPORT\n";
+    cout << "==========================================\n";
+    cout << "Total graded courses: " << counts.total << "\n";
+    for (int b = 0; b < scale.bandCount; ++b) {
+        Grade grade = scale.bands[b].grade;
+        cout << gradeName(grade) << ": " << counts.counts[grade] << "\n";
+    }
+    cout << "==========================================\n";
+}
+
+// Counts the graded courses (at least one assignment) per grade by grading
+// every course; a Gradebook keeps the same counts in its GradeIndex.
+GradeCounts countGradeDistribution(const CourseStore& courses) {
+    GradeCounts counts = {};
+
+    for (const Course& c : courses) {
+        if (c.work.empty()) {
+            continue;
+        }
+
+        counts.counts[percentageToGrade(calculateCoursePercentage(c))]++;
+        counts.total++;
+    }
+
+    return counts;
+}
+
+// ============================================================================
+// GRADE INDEX
+// ============================================================================
+// Every Gradebook keeps its graded courses in one bucket per letter grade.
+// A course is re-graded only when one of its own assignments or categories
+// changes, and moved to another bucket (swapping the last course of the
+// old bucket into its place) only if its grade changed. The buckets are
+// rebuilt from scratch when a snapshot or columnar file replaces all the
+// courses. The grading scale is picked before any course is loaded, so
+// the buckets never have to follow a change of scale.
+
+GradeIndex::GradeIndex() : total(0) {}
+
+void GradeIndex::clear() {
+    for (vector<CourseHandle>& bucket : members) {
+        bucket.clear();
+    }
+    entries.clear();
+    total = 0;
+}
+
+void GradeIndex::rebuild(const CourseStore& courses) {
+    clear();
+    for (const Course& c : courses) {
+        update(courses, courses.handleOf(c.id));
+    }
+}
+
+void GradeIndex::update(const CourseStore& courses, CourseHandle handle) {
+    const Course* c = courses.get(handle);
+    if (c == nullptr || c->work.empty()) {
+        erase(handle);
+        return;
+    }
+
+    Grade grade = percentageToGrade(calculateCoursePercentage(*c));
+    if (handle.slot >= entries.size()) {
+        Entry unused = { 0, static_cast<uint8_t>(GRADE_COUNT) };
+        entries.resize(handle.slot + 1, unused);
+    }
+    if (entries[handle.slot].grade == grade) {
+        return;  // same bucket as before
+    }
+
+    erase(handle);
+    entries[handle.slot].grade = static_cast<uint8_t>(grade);
+    entries[handle.slot].position =
+        static_cast<uint32_t>(members[grade].size());
+    members[grade].push_back(handle);
+    total++;
+}
+
+void GradeIndex::erase(CourseHandle handle) {
+    if (handle.slot >= entries.size() ||
+        entries[handle.slot].grade == GRADE_COUNT) {
+        return;  // not indexed
+    }
+
+    Entry& entry = entries[handle.slot];
+    vector<CourseHandle>& bucket = members[entry.grade];
+    CourseHandle last = bucket.back();
+    bucket[entry.position] = last;
+    entries[last.slot].position = entry.position;
+    bucket.pop_back();
+
+    entry.grade = static_cast<uint8_t>(GRADE_COUNT);
+    total--;
+}
+
+GradeCounts GradeIndex::counts() const {
+    GradeCounts counts = {};
+    for (int g = 0; g < GRADE_COUNT; ++g) {
+        counts.counts[g] = static_cast<int>(members[g].size());
+    }
+    counts.total = total;
+    return counts;
+}
+
+// Fills "ids" (sorted) with the courses that have "grade", or with
+// "worse" set, a grade below it on the active grading scale (the at-risk
+// list: "worse than C" gives every D and F). Returns false if the scale
+// does not use "grade".
+bool coursesWithGrade(const Gradebook& book, Grade grade, bool worse,
+                      vector<int>& ids) {
+    ids.clear();
+
+    const GradingScale& scale = gradingScale();
+    int band = 0;
+    while (band < scale.bandCount && scale.bands[band].grade != grade) {
+        ++band;
+    }
+    if (band == scale.bandCount) {
+        return false;
+    }
+
+    for (int b = worse ? band + 1 : band;
+         b < (worse ? scale.bandCount : band + 1); ++b) {
+        for (CourseHandle handle : book.grades.coursesWith(
+                 scale.bands[b].grade)) {
+            ids.push_back(book.courses.get(handle)->id);
+        }
+    }
+    sort(ids.begin(), ids.end());
+    return true;
+}
+
+// ============================================================================
+// BATCH MODE
+// ============================================================================
+// Reads rows of the form
+//     student,course,credits,assignment,earned,max[,term]
+// (comma or tab separated, one assignment per row) and writes one result
+// record per course plus one GPA record per student. The optional term
+// (e.g. "Fall 2025") keeps a retaken course apart from the earlier attempt.
+//
+// Rows must be grouped by student (all rows for one student next to each
+// other, which is how the registrar export is sorted); rows of a student
+// that shows up again later are reported and skipped. Students are read
+// in blocks of BATCH_BLOCK_STUDENTS, graded in parallel (see "COHORT GPA")
+// and written in input order. Only one block of courses is kept in memory
+// (plus the ids of the students already read), so memory stays bounded no
+// matter how many courses are in the file.
+//
+// Output format (same delimiter as the input):
+//     record,student,course,credits,assignments,percent,letter,gpa
+//     COURSE,S1,COSC 3345,3,4,91.25,A,
+//     GPA,S1,,7,2,,,3.43
+// For GPA records "credits" is the total graded credit hours and
+// "assignments" holds the number of graded courses. The gpa field is left
+// empty when no credit hours count toward the GPA (only pass/fail courses).
+
+// One parsed input row.
+struct BatchRow {
+    string student;
+    string course;
+    double credits;
+    string assignment;
+    double earned;
+    double max;
+    string term;      // empty when the row has no term field
+};
+
+// Splits one line into fields. A field may be wrapped in double quotes so it
+// can contain the delimiter; "" inside quotes stands for one quote.
+// The fields vector is reused between lines to avoid reallocating.
+bool splitBatchLine(const string& line, char delimiter, vector<string>& fields) {
+    size_t count = 0;
+    size_t pos = 0;
+    size_t end = line.size();
+
+    // Ignore a Windows line ending.
+    if (end > 0 && line[end - 1] == '\r') {
+        end--;
+    }
+
+    while (true) {
+        if (count == fields.size()) {
+            fields.push_back(string());
+        }
+        string& field = fields[count];
+        field.clear();
+        count++;
+
+        if (pos < end && line[pos] == '"') {
+            // Quoted field.
+            pos++;
+            bool closed = false;
+            while (pos < end) {
+                if (line[pos] == '"') {
+                    if (pos + 1 < end && line[pos + 1] == '"') {
+                        field += '"';
+                        pos += 2;
+                    } else {
+                        pos++;
+                        closed = true;
+                        break;
+                    }
+                } else {
+                    field += line[pos];
+                    pos++;
+                }
+            }
+            if (!closed || (pos < end && line[pos] != delimiter)) {
+                return false; // unbalanced quotes
+            }
+        } else {
+            while (pos < end && line[pos] != delimiter) {
+                field += line[pos];
+                pos++;
+            }
+        }
+
+        if (pos >= end) {
+            break;
+        }
+        pos++; // skip the delimiter
+    }
+
+    fields.resize(count);
+    return true;
+}
+
+// Trims spaces around a field in place.
+static void trimField(string& field) {
+    size_t first = field.find_first_not_of(" \t");
+    if (first == string::npos) {
+        field.clear();
+        return;
+    }
+    size_t last = field.find_last_not_of(" \t");
+    field = field.substr(first, last - first + 1);
+}
+
+// Parses a whole field as a number. Returns false if it is not a number.
+static bool parseNumberField(const string& field, double& value) {
+    if (field.empty()) {
+        return false;
+    }
+    char* endPtr = nullptr;
+    value = strtod(field.c_str(), &endPtr);
+    return endPtr == field.c_str() + field.size();
+}
+
+// Turns split fields into a BatchRow, using the same limits as the menus.
+bool parseBatchRow(const vector<string>& fields, BatchRow& row, string& error) {
+    if (fields.size() != 6 && fields.size() != 7) {
+        error = "expected 6 or 7 fields "
+                "(student,course,credits,assignment,earned,max[,term])";
+        return false;
+    }
+
+    row.student = fields[0];
+    row.course = fields[1];
+    row.assignment = fields[3];
+    trimField(row.student);
+    trimField(row.course);
+    trimField(row.assignment);
+    row.term.clear();
+    if (fields.size() == 7) {
+        row.term = fields[6];
+        trimField(row.term);
+    }
+
+    string credits = fields[2];
+    string earned = fields[4];
+    string max = fields[5];
+    trimField(credits);
+    trimField(earned);
+    trimField(max);
+
+    if (row.student.empty() || row.course.empty()) {
+        error = "student and course must not be empty";
+        return false;
+    }
+    // Written as !(in range) so "nan" is refused too.
+    if (!parseNumberField(credits, row.credits) ||
+        !(row.credits >= 0.5 && row.credits <= 6.0)) {
+        error = "credits must be a number between 0.5 and 6";
+        return false;
+    }
+    if (!parseNumberField(max, row.max) ||
+        !(row.max >= 1.0 && row.max <= 10000.0)) {
+        error = "max must be a number between 1 and 10000";
+        return false;
+    }
+    if (!parseNumberField(earned, row.earned) ||
+        !(row.earned >= 0.0 && row.earned <= row.max)) {
+        error = "earned must be a number between 0 and max";
+        return false;
+    }
+    return true;
+}
+
+// Appends one output field, quoting it if it contains the delimiter or quotes.
+void appendBatchField(string& out, const char* field, size_t length,
+                      char delimiter) {
+    if (memchr(field, delimiter, length) == nullptr &&
+        memchr(field, '"', length) == nullptr) {
+        out.append(field, length);
+        return;
+    }
+
+    out += '"';
+    for (size_t i = 0; i < length; ++i) {
+        if (field[i] == '"') {
+            out += '"';
+        }
+        out += field[i];
+    }
+    out += '"';
+}
+
+// Appends the COURSE records and the GPA record for one student.
+// The course totals must be up to date (see recalculateCourseTotals).
+void writeStudentResults(const string& student, const CourseStore& courses,
+                         double gpa, char delimiter, string& out) {
+    char number[64];
+    double gradedCredits = 0.0;
+    int gradedCourses = 0;
+
+    for (const Course& c : courses) {
+        double percent = calculateCoursePercentage(c);
+        const GradeBand& band = gradeBandFor(percent);
+
+        out += "COURSE";
+        out += delimiter;
+        appendBatchField(out, student.data(), student.size(), delimiter);
+        out += delimiter;
+        appendBatchField(out, c.name.c_str(), c.name.size(), delimiter);
+        out += delimiter;
+        snprintf(number, sizeof(number), "%g", c.creditHours);
+        out += number;
+        out += delimiter;
+        snprintf(number, sizeof(number), "%zu", c.work.size());
+        out += number;
+        out += delimiter;
+        snprintf(number, sizeof(number), "%.2f", percent);
+        out += number;
+        out += delimiter;
+        out += gradeName(band.grade);
+        out += delimiter;
+        out += '\n';
+
+        if (band.countsInGpa) {
+            gradedCredits += c.creditHours;
+        }
+        gradedCourses++;
+    }
+
+    out += "GPA";
+    out += delimiter;
+    appendBatchField(out, student.data(), student.size(), delimiter);
+    out += delimiter;
+    out += delimiter;
+    snprintf(number, sizeof(number), "%g", gradedCredits);
+    out += number;
+    out += delimiter;
+    snprintf(number, sizeof(number), "%d", gradedCourses);
+    out += number;
+    out += delimiter;
+    out += delimiter;
+    out += delimiter;
+    if (gradedCredits > 0.0) {
+        snprintf(number, sizeof(number), "%.2f", gpa);
+        out += number;
+    }
+    out += '\n';
+}
+
+// Students read before a block is graded and written out.
+const size_t BATCH_BLOCK_STUDENTS = 4096;
+
+// Output is written in chunks of about this many bytes.
+const size_t BATCH_FLUSH_BYTES = 1 << 16;
+
+// Rebuilds the course totals and computes the GPA of the first "count"
+// students of a block, on "threads" threads.
+static void gradeStudentBlock(vector<StudentRecord>& block, size_t count,
+                              unsigned threads, vector<double>& gpas) {
+    parallelForRanges(count, threads, 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            for (Course& c : block[i].courses) {
+                recalculateCourseTotals(c);
+            }
+            gpas[i] = calculateOverallGPA(block[i].courses);
+        }
+    });
+}
+
+// Writes the results of a graded block in input order, flushing the output
+// buffer whenever it passes BATCH_FLUSH_BYTES.
+static void writeStudentBlock(const vector<StudentRecord>& block, size_t count,
+                              const vector<double>& gpas, char delimiter,
+                              string& buffer, ostream& out) {
+    for (size_t i = 0; i < count; ++i) {
+        writeStudentResults(block[i].id, block[i].courses, gpas[i],
+                            delimiter, buffer);
+        if (buffer.size() >= BATCH_FLUSH_BYTES) {
+            out.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+            buffer.clear();
+        }
+    }
+}
+
+// Streams the whole input once, collecting the rows of each student into a
+// StudentRecord. Whenever BATCH_BLOCK_STUDENTS students are complete (and
+// once more at the end) onBlock(block, count) is called with the first
+// "count" students of the block; their course totals are NOT rebuilt yet.
+// "delimiter" is set from the first non-empty line (0 if there was none).
+// Bad rows, and rows of a student whose rows already ended earlier in the
+// file, are reported on stderr (with their line number) and skipped.
+// Returns the number of skipped rows.
+long long readStudentBlocks(istream& in, char& delimiter,
+                            const function<void(vector<StudentRecord>&,
+                                                size_t)>& onBlock) {
+    string line;
+    vector<string> fields;
+    BatchRow row;
+    string error;
+
+    // The block is reused, so its course stores keep their memory.
+    vector<StudentRecord> block(BATCH_BLOCK_STUDENTS);
+    size_t blockCount = 0;    // students in the block; the last is current
+    bool firstRow = true;     // the first row may be a header line
+    unordered_set<string> finished;  // students whose rows have ended
+    long long lineNumber = 0;
+    long long badRows = 0;
+    delimiter = 0;
+
+    while (getline(in, line)) {
+        lineNumber++;
+
+        if (line.empty() || line == "\r") {
+            continue;
+        }
+
+        if (delimiter == 0) {
+            delimiter = (line.find('\t') != string::npos) ? '\t' : ',';
+        }
+
+        if (!splitBatchLine(line, delimiter, fields)) {
+            cerr << "line " << lineNumber << ": unbalanced quotes, row skipped\n";
+            firstRow = false;
+            badRows++;
+            continue;
+        }
+
+        if (!parseBatchRow(fields, row, error)) {
+            // An optional header line is allowed as the first row.
+            if (firstRow && !fields.empty() && fields[0] == "student") {
+                firstRow = false;
+                continue;
+            }
+            cerr << "line " << lineNumber << ": " << error << ", row skipped\n";
+            firstRow = false;
+            badRows++;
+            continue;
+        }
+        firstRow = false;
+
+        // A new student starts. If the block is full, hand it over.
+        if (blockCount == 0 || row.student != block[blockCount - 1].id) {
+            if (finished.count(row.student) > 0) {
+                cerr << "line " << lineNumber << ": student " << row.student
+                     << " is listed twice (rows must be grouped), row skipped\n";
+                badRows++;
+                continue;
+            }
+            if (blockCount > 0) {
+                finished.insert(block[blockCount - 1].id);
+            }
+            if (blockCount == BATCH_BLOCK_STUDENTS) {
+                onBlock(block, blockCount);
+                blockCount = 0;
+            }
+            block[blockCount].id = row.student;
+            block[blockCount].courses.clear();
+            blockCount++;
+        }
+        CourseStore& courses = block[blockCount - 1].courses;
+
+        // Students have only a handful of courses, so a linear search by
+        // name (and term) is cheap here.
+        Course* course = nullptr;
+        for (Course& c : courses) {
+            if (c.name == row.course && c.term == row.term) {
+                course = &c;
+                break;
+            }
+        }
+        if (course == nullptr) {
+            Course c;
+            c.id = static_cast<int>(courses.size()) + 1;
+            c.name = row.course;
+            c.term = row.term;
+            c.creditHours = row.credits;
+            course = courses.get(courses.insert(c));
+        }
+
+        Assignment a;
+        a.name = row.assignment;
+        a.earned = row.earned;
+        a.max = row.max;
+        // Only the columns are filled here; the totals are rebuilt in
+        // one pass per course when the block is handed over.
+        course->work.push_back(a);
+    }
+
+    if (blockCount > 0) {
+        onBlock(block, blockCount);
+    }
+    return badRows;
+}
+
+// Appends the header line of the batch output.
+static void appendBatchHeader(char delimiter, string& out) {
+    const char* const columns[] = {
+        "record", "student", "course", "credits", "assignments", "percent",
+        "letter", "gpa"
+    };
+    for (size_t i = 0; i < sizeof(columns) / sizeof(columns[0]); ++i) {
+        if (i > 0) {
+            out += delimiter;
+        }
+        out += columns[i];
+    }
+    out += '\n';
+}
+
+// Streams the whole input once and writes results block by block.
+// Returns 0 if every row was valid, 2 if some rows were skipped.
+int runBatchMode(istream& in, ostream& out, unsigned threads) {
+    string buffer;
+    buffer.reserve(BATCH_FLUSH_BYTES + 4096);
+    vector<double> gpas(BATCH_BLOCK_STUDENTS);
+    char delimiter = 0;
+    bool headerWritten = false;
+
+    long long badRows = readStudentBlocks(in, delimiter,
+        [&](vector<StudentRecord>& block, size_t count) {
+            if (!headerWritten) {
+                appendBatchHeader(delimiter, buffer);
+                headerWritten = true;
+            }
+            gradeStudentBlock(block, count, threads, gpas);
+            writeStudentBlock(block, count, gpas, delimiter, buffer, out);
+        });
+
+    // Any non-empty input gets a header, even if every row was bad.
+    if (!headerWritten && delimiter != 0) {
+        appendBatchHeader(delimiter, buffer);
+    }
+
+    out.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+    out.flush();
+
+    return badRows == 0 ? 0 : 2;
+}
+
+// ============================================================================
+// COHORT GPA (PARALLEL)
+// ============================================================================
+// Computes GPAs for many students at once on all CPU cores.
+//
+// Students can have very different course loads, so handing every thread
+// an equal slice of students would leave some threads idle while others
+// are still busy. Instead each thread owns a double-ended queue of index
+// ranges (a "work-stealing" scheduler):
+//   * a thread splits its range in halves, keeps working on the lower half
+//     and pushes the upper half onto the back of its own queue,
+//   * when its own queue is empty it steals from the FRONT of another
+//     thread's queue, which is where the biggest leftover ranges are.
+// Each student is always handled start to finish by one thread and writes
+// only its own result slot, so the results are exactly the same no matter
+// how many threads run or who steals what.
+
+// Number of threads to use when the user does not say.
+unsigned defaultThreadCount() {
+    unsigned count = thread::hardware_concurrency();
+    return count == 0 ? 1 : count;
+}
+
+// Most threads "--threads" accepts.
+const long MAX_THREADS = 1024;
+
+// Reads the value given to "--threads" (nullptr when it is missing).
+// Returns false, after saying why on stderr, unless it is a whole number
+// between 1 and MAX_THREADS.
+bool parseThreadCount(const char* value, unsigned& threads) {
+    char* end = nullptr;
+    long requested = value == nullptr ? 0 : strtol(value, &end, 10);
+    if (value == nullptr || end == value || *end != '\0' ||
+        requested < 1 || requested > MAX_THREADS) {
+        cerr << "--threads needs a whole number between 1 and " << MAX_THREADS
+             << ".\n";
+        return false;
+    }
+    threads = static_cast<unsigned>(requested);
+    return true;
+}
+
+namespace {
+
+struct IndexRange {
+    size_t begin;
+    size_t end;
+};
+
+// One worker's queue of ranges. The owner works at the back, thieves take
+// from the front.
+struct WorkQueue {
+    mutex lock;
+    deque<IndexRange> ranges;
+
+    void pushBack(const IndexRange& r) {
+        lock_guard<mutex> guard(lock);
+        ranges.push_back(r);
+    }
+
+    bool popBack(IndexRange& r) {
+        lock_guard<mutex> guard(lock);
+        if (ranges.empty()) {
+            return false;
+        }
+        r = ranges.back();
+        ranges.pop_back();
+        return true;
+    }
+
+    bool popFront(IndexRange& r) {
+        lock_guard<mutex> guard(lock);
+        if (ranges.empty()) {
+            return false;
+        }
+        r = ranges.front();
+        ranges.pop_front();
+        return true;
+    }
+};
+
+} // namespace
+
+// Calls body(worker, begin, end) over [0, count) in pieces of at most
+// "grain" items, spread over "threads" threads with work stealing. "worker"
+// is the number (0 .. threads-1) of the thread running the piece, so the
+// body can keep per-thread partial results without locking. Returns when
+// every item has been processed.
+void parallelForWorkers(size_t count, unsigned threads, size_t grain,
+                        const function<void(unsigned, size_t, size_t)>& body) {
+    if (grain == 0) {
+        grain = 1;
+    }
+    size_t pieces = (count + grain - 1) / grain;
+    if (threads > pieces) {
+        threads = static_cast<unsigned>(pieces);
+    }
+    if (threads <= 1) {
+        if (count > 0) {
+            body(0, 0, count);
+        }
+        return;
+    }
+
+    vector<WorkQueue> queues(threads);
+    atomic<size_t> remaining(count);
+
+    // Start every thread with an equal share; stealing evens out the rest.
+    for (unsigned t = 0; t < threads; ++t) {
+        IndexRange r;
+        r.begin = count * t / threads;
+        r.end = count * (t + 1) / threads;
+        if (r.begin < r.end) {
+            queues[t].pushBack(r);
+        }
+    }
+
+    auto worker = [&](unsigned self) {
+        while (remaining.load() > 0) {
+            IndexRange r;
+            bool found = queues[self].popBack(r);
+            for (unsigned k = 1; !found && k < threads; ++k) {
+                found = queues[(self + k) % threads].popFront(r);
+            }
+            if (!found) {
+                this_thread::yield(); // others are finishing the last pieces
+                continue;
+            }
+
+            // Leave the upper halves where other threads can steal them.
+            while (r.end - r.begin > grain) {
+                IndexRange upper;
+                upper.begin = r.begin + (r.end - r.begin) / 2;
+                upper.end = r.end;
+                queues[self].pushBack(upper);
+                r.end = upper.begin;
+            }
+
+            body(self, r.begin, r.end);
+            remaining -= r.end - r.begin;
+        }
+    };
+
+    vector<thread> helpers;
+    helpers.reserve(threads - 1);
+    for (unsigned t = 1; t < threads; ++t) {
+        helpers.push_back(thread(worker, t));
+    }
+    worker(0);
+    for (thread& helper : helpers) {
+        helper.join();
+    }
+}
+
+// Same as parallelForWorkers for bodies that do not need the thread number.
+void parallelForRanges(size_t count, unsigned threads, size_t grain,
+                       const function<void(size_t, size_t)>& body) {
+    parallelForWorkers(count, threads, grain,
+                       [&](unsigned, size_t begin, size_t end) {
+        body(begin, end);
+    });
+}
+
+// Fills gpas[i] with the GPA of students[i], using "threads" threads.
+// The course totals of every student must be up to date.
+void calculateCohortGPAs(const vector<StudentRecord>& students,
+                         unsigned threads, vector<double>& gpas) {
+    gpas.assign(students.size(), 0.0);
+    parallelForRanges(students.size(), threads, 16,
+                      [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            gpas[i] = calculateOverallGPA(students[i].courses);
+        }
+    });
+}
+
+// ============================================================================
+// COHORT GRADE DISTRIBUTION
+// ============================================================================
+// The same report as showGradeDistribution, but over every course of a
+// whole cohort, with one row per course name, department or term. Each
+// group also gets a histogram of course percentages in bins of a chosen
+// width (1% by default); bin i counts percentages in [i*W, (i+1)*W) and the
+// last bin counts everything at 100% or above (extra credit).
+//
+// Students are spread over the threads with parallelForWorkers. Every
+// thread fills its own table of groups, so no counter is ever shared, and
+// the tables are added together once at the end. The counts are exact, so
+// they do not depend on the number of threads.
+//
+// "--distribution [file]" reads the batch input format (see "BATCH MODE";
+// the term is the optional 7th field) and writes, with the same delimiter:
+//     record,group,courses,A,B,C,D,F,mean
+//     GRADES,COSC,412,101,150,90,41,30,81.37
+//     BIN,COSC,3,57
+// The grade columns are the grades of the active scale. For BIN records
+// "courses" is the number of courses in the bin and the next column holds
+// the lowest percentage of the bin; only non-empty bins are written.
+
+class CohortDistribution {
+public:
+    CohortDistribution(DistributionGrouping grouping, double binWidth,
+                       unsigned threads);
+
+    // Counts every course of the first "count" students. With
+    // "rebuildTotals" the course totals are rebuilt first (batch input only
+    // fills the assignment columns).
+    void addStudents(vector<StudentRecord>& students, size_t count,
+                     bool rebuildTotals);
+
+    // Adds the per-thread tables together into "groups", sorted by group
+    // name, and starts over empty.
+    void finish(vector<GroupDistribution>& groups);
+
+private:
+    // Keyed by the pool id of the group name. The GroupDistribution holds
+    // the name, so the id cannot be reused for another name meanwhile.
+    typedef unordered_map<uint32_t, GroupDistribution> GroupTable;
+
+    // Department of a course name, cached by the course name's pool id.
+    // The course name is kept for the same reason as above.
+    struct DepartmentEntry {
+        PooledName course;
+        PooledName department;
+    };
+
+    struct Worker {
+        GroupTable groups;
+        unordered_map<uint32_t, DepartmentEntry> departments;
+    };
+
+    const PooledName& groupName(Worker& worker, const Course& c) const;
+    void addCourse(Worker& worker, const Course& c) const;
+    void startGroup(GroupDistribution& g, const PooledName& name) const;
+
+    DistributionGrouping grouping;
+    double binWidth;
+    size_t binCount;
+    unsigned threads;
+    vector<Worker> workers;
+};
+
+CohortDistribution::CohortDistribution(DistributionGrouping grouping,
+                                       double binWidth, unsigned threads)
+    : grouping(grouping), binWidth(binWidth),
+      binCount(static_cast<size_t>(ceil(100.0 / binWidth)) + 1),
+      threads(threads == 0 ? 1 : threads), workers(this->threads) {}
+
+// The department is the start of the course name up to the first space or
+// digit ("COSC 3345" and "COSC2436" both give "COSC"). A name that starts
+// with a digit is its own department.
+static PooledName departmentOf(const PooledName& course) {
+    const char* text = course.c_str();
+    size_t length = 0;
+    while (length < course.size() && text[length] != ' ' &&
+           !isdigit(static_cast<unsigned char>(text[length]))) {
+        length++;
+    }
+    if (length == 0 || length == course.size()) {
+        return course;
+    }
+    return PooledName(text, length);
+}
+
+// Returns a name the course or the cache holds, so counting a course does
+// not touch the name's reference count (shared by every thread).
+const PooledName& CohortDistribution::groupName(Worker& worker,
+                                                const Course& c) const {
+    if (grouping == GROUP_BY_TERM) {
+        return c.term;
+    }
+    if (grouping == GROUP_BY_COURSE) {
+        return c.name;
+    }
+
+    // Interning a department takes the pool's lock, so each thread
+    // remembers the departments it has already worked out.
+    auto found = worker.departments.find(c.name.poolId());
+    if (found != worker.departments.end()) {
+        return found->second.department;
+    }
+    DepartmentEntry& entry = worker.departments[c.name.poolId()];
+    entry.course = c.name;
+    entry.department = departmentOf(c.name);
+    return entry.department;
+}
+
+void CohortDistribution::startGroup(GroupDistribution& g,
+                                    const PooledName& name) const {
+    g.group = name;
+    for (int i = 0; i < GRADE_COUNT; ++i) {
+        g.grades[i] = 0;
+    }
+    g.courses = 0;
+    g.sumPercent = 0.0;
+    g.bins.assign(binCount, 0);
+}
+
+void CohortDistribution::addCourse(Worker& worker, const Course& c) const {
+    const PooledName& name = groupName(worker, c);
+    auto found = worker.groups.find(name.poolId());
+    if (found == worker.groups.end()) {
+        found = worker.groups.insert(
+            make_pair(name.poolId(), GroupDistribution())).first;
+        startGroup(found->second, name);
+    }
+    GroupDistribution& g = found->second;
+
+    double percent = calculateCoursePercentage(c);
+    size_t bin = binCount - 1;
+    if (percent < 100.0) {
+        bin = static_cast<size_t>(percent / binWidth);
+        if (bin > binCount - 2) {
+            bin = binCount - 2;  // rounding right below 100%
+        }
+    }
+
+    g.grades[percentageToGrade(percent)]++;
+    g.courses++;
+    g.sumPercent += percent;
+    g.bins[bin]++;
+}
+
+void CohortDistribution::addStudents(vector<StudentRecord>& students,
+                                     size_t count, bool rebuildTotals) {
+    parallelForWorkers(count, threads, 16,
+                       [&](unsigned self, size_t begin, size_t end) {
+        Worker& worker = workers[self];
+        for (size_t i = begin; i < end; ++i) {
+            for (Course& c : students[i].courses) {
+                if (rebuildTotals) {
+                    recalculateCourseTotals(c);
+                }
+                addCourse(worker, c);
+            }
+        }
+    });
+}
+
+void CohortDistribution::finish(vector<GroupDistribution>& groups) {
+    GroupTable total;
+    for (Worker& worker : workers) {
+        for (auto& item : worker.groups) {
+            auto found = total.find(item.first);
+            if (found == total.end()) {
+                total.insert(make_pair(item.first, move(item.second)));
+                continue;
+            }
+
+            GroupDistribution& into = found->second;
+            const GroupDistribution& from = item.second;
+            for (int i = 0; i < GRADE_COUNT; ++i) {
+                into.grades[i] += from.grades[i];
+            }
+            into.courses += from.courses;
+            into.sumPercent += from.sumPercent;
+            for (size_t b = 0; b < binCount; ++b) {
+                into.bins[b] += from.bins[b];
+            }
+        }
+        worker.groups.clear();
+        worker.departments.clear();
+    }
+
+    groups.clear();
+    groups.reserve(total.size());
+    for (auto& item : total) {
+        groups.push_back(move(item.second));
+    }
+    sort(groups.begin(), groups.end(),
+         [](const GroupDistribution& a, const GroupDistribution& b) {
+        return strcmp(a.group.c_str(), b.group.c_str()) < 0;
+    });
+}
+
+// Appends the header and one GRADES record plus the BIN records for every
+// group (see the format above).
+void writeDistribution(const vector<GroupDistribution>& groups,
+                       double binWidth, char delimiter, string& out) {
+    const GradingScale& scale = gradingScale();
+    char number[64];
+
+    out += "record";
+    out += delimiter;
+    out += "group";
+    out += delimiter;
+    out += "courses";
+    for (int i = 0; i < scale.bandCount; ++i) {
+        out += delimiter;
+        out += gradeName(scale.bands[i].grade);
+    }
+    out += delimiter;
+    out += "mean\n";
+
+    for (const GroupDistribution& g : groups) {
+        out += "GRADES";
+        out += delimiter;
+        appendBatchField(out, g.group.c_str(), g.group.size(), delimiter);
+        out += delimiter;
+        snprintf(number, sizeof(number), "%lld", g.courses);
+        out += number;
+        for (int i = 0; i < scale.bandCount; ++i) {
+            snprintf(number, sizeof(number), "%lld",
+                     g.grades[scale.bands[i].grade]);
+            out += delimiter;
+            out += number;
+        }
+        double mean = g.courses > 0 ? g.sumPercent / g.courses : 0.0;
+        snprintf(number, sizeof(number), "%.2f", mean);
+        out += delimiter;
+        out += number;
+        out += '\n';
+
+        for (size_t b = 0; b < g.bins.size(); ++b) {
+            if (g.bins[b] == 0) {
+                continue;
+            }
+            double low = b + 1 == g.bins.size() ? 100.0 : b * binWidth;
+            out += "BIN";
+            out += delimiter;
+            appendBatchField(out, g.group.c_str(), g.group.size(), delimiter);
+            out += delimiter;
+            snprintf(number, sizeof(number), "%u", g.bins[b]);
+            out += number;
+            out += delimiter;
+            snprintf(number, sizeof(number), "%g", low);
+            out += number;
+            out += '\n';
+        }
+    }
+}
+
+// Streams the batch input once and writes the distribution of the whole
+// cohort. Bad rows are reported on stderr and skipped, as in batch mode.
+// Returns 0 if every row was valid, 2 if some rows were skipped.
+int runDistributionMode(istream& in, ostream& out,
+                        DistributionGrouping grouping, double binWidth,
+                        unsigned threads) {
+    CohortDistribution distribution(grouping, binWidth, threads);
+    char delimiter = 0;
+
+    long long badRows = readStudentBlocks(in, delimiter,
+        [&](vector<StudentRecord>& block, size_t count) {
+            distribution.addStudents(block, count, true);
+        });
+
+    vector<GroupDistribution> groups;
+    distribution.finish(groups);
+
+    string buffer;
+    writeDistribution(groups, binWidth, delimiter == 0 ? ',' : delimiter,
+                      buffer);
+    out.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+    out.flush();
+
+    return badRows == 0 ? 0 : 2;
+}
+
+// ============================================================================
+// TRANSCRIPTS
+// ============================================================================
+// "--transcripts [file] [--format text|json] [--threads N]" reads the batch
+// mode input and writes a transcript for every student: each course with
+// its assignments and average (as on the course details screen) and the
+// overall GPA (as on the GPA screen), either as fixed-width text or as one
+// JSON object per line.
+//
+// The work is a pipeline of three stages joined by bounded queues:
+//     reader (this thread) -> N graders -> writer thread
+// The reader collects chunks of up to BATCH_BLOCK_STUDENTS students, each
+// grader takes a whole chunk, rebuilds its totals and formats it in the
+// grader's own ReportBuffer, and the writer puts the chunks back in input
+// order before writing them. A fixed pool of chunks goes round between the
+// stages (the reader waits when none is free), so memory does not grow
+// with the input, and the chunks' courses and text are reused instead of
+// allocated again.
+//
+// Text format (one block per student):
+//     ====================================================
+//     Transcript for: S1
+//     ====================================================
+//     Course: COSC 3345 (Fall 2025)
+//     Credit hours: 3
+//     Name                     Earned         Max            Percent
+//     ----------------------------------------------------
+//     Quiz 1                   9              10             90.00
+//     ----------------------------------------------------
+//     Course average: 90.00% (A)
+//     ====================================================
+//     Overall GPA (4.0 scale): 4.00
+//     Graded credit hours: 3
+//     ====================================================
+//
+// JSON format (one line per student, wrapped here):
+//     {"student": "S1", "gpa": 4.0000, "graded_credits": 3, "courses": [
+//     {"name": "COSC 3345", "term": "Fall 2025", "credits": 3,
+//     "percent": 90.0000, "grade": "A", "assignments": [
+//     {"name": "Quiz 1", "earned": 9, "max": 10, "percent": 90.0000}]}]}
+
+// Chunks in the pipeline per grader thread (plus two for the reader and
+// the writer).
+const size_t TRANSCRIPT_CHUNKS_PER_THREAD = 2;
+
+// Adds a JSON string (quoted, with quotes, backslashes and control
+// characters escaped).
+static void appendJsonString(ReportBuffer& out, const char* text,
+                             size_t length) {
+    static const char HEX[] = "0123456789abcdef";
+    out.append('"');
+    for (size_t i = 0; i < length; ++i) {
+        unsigned char ch = static_cast<unsigned char>(text[i]);
+        if (ch == '"' || ch == '\\') {
+            out.append('\\');
+            out.append(static_cast<char>(ch));
+        } else if (ch < 0x20) {
+            out.append("\\u00");
+            out.append(HEX[ch >> 4]);
+            out.append(HEX[ch & 15]);
+        } else {
+            out.append(static_cast<char>(ch));
+        }
+    }
+    out.append('"');
+}
+
+static void appendJsonString(ReportBuffer& out, const PooledName& name) {
+    appendJsonString(out, name.c_str(), name.size());
+}
+
+// Adds a JSON number with "digits" decimals, or null for NaN and infinity,
+// which JSON cannot express.
+static void appendJsonFixed(ReportBuffer& out, double value, int digits) {
+    if (std::isfinite(value)) {
+        out.appendFixed(value, digits);
+    } else {
+        out.append("null");
+    }
+}
+
+// Same for a number written the short way (see ReportBuffer::appendShort).
+static void appendJsonShort(ReportBuffer& out, double value) {
+    if (std::isfinite(value)) {
+        out.appendShort(value);
+    } else {
+        out.append("null");
+    }
+}
+
+static void appendTextTranscript(const StudentRecord& student, double gpa,
+                                 double gradedCredits, ReportBuffer& out) {
+    out.append("====================================================\n");
+    out.append("Transcript for: ");
+    out.append(student.id);
+    out.append("\n====================================================\n");
+
+    for (const Course& c : student.courses) {
+        out.append("Course: ");
+        out.append(c.name);
+        if (!c.term.empty()) {
+            out.append(" (");
+            out.append(c.term);
+            out.append(')');
+        }
+        out.append("\nCredit hours: ");
+        out.appendShort(c.creditHours);
+        out.append('\n');
+
+        size_t start = out.size();
+        out.append("Name");
+        out.padFrom(start, 25);
+        out.append("Earned");
+        out.padFrom(start, 40);
+        out.append("Max");
+        out.padFrom(start, 55);
+        out.append("Percent\n----------------------------------------------------\n");
+
+        for (size_t i = 0; i < c.work.size(); ++i) {
+            double earned = c.work.earned[i];
+            double max = c.work.max[i];
+            start = out.size();
+            out.append(c.work.names[i]);
+            out.padFrom(start, 25);
+            out.appendShort(earned);
+            out.padFrom(start, 40);
+            out.appendShort(max);
+            out.padFrom(start, 55);
+            out.appendFixed((earned / max) * 100.0, 2);
+            out.append('\n');
+        }
+
+        double percent = calculateCoursePercentage(c);
+        out.append("----------------------------------------------------\n");
+        out.append("Course average: ");
+        out.appendFixed(percent, 2);
+        out.append("% (");
+        out.append(percentageToLetter(percent));
+        out.append(")\n====================================================\n");
+    }
+
+    out.append("Overall GPA (4.0 scale): ");
+    out.appendFixed(gpa, 2);
+    out.append("\nGraded credit hours: ");
+    out.appendShort(gradedCredits);
+    out.append("\n====================================================\n");
+}
+
+static void appendJsonTranscript(const StudentRecord& student, double gpa,
+                                 double gradedCredits, ReportBuffer& out) {
+    out.append("{\"student\": ");
+    appendJsonString(out, student.id.data(), student.id.size());
+    out.append(", \"gpa\": ");
+    appendJsonFixed(out, gpa, 4);
+    out.append(", \"graded_credits\": ");
+    appendJsonShort(out, gradedCredits);
+    out.append(", \"courses\": [");
+
+    bool firstCourse = true;
+    for (const Course& c : student.courses) {
+        double percent = calculateCoursePercentage(c);
+        out.append(firstCourse ? "{\"name\": " : ", {\"name\": ");
+        firstCourse = false;
+        appendJsonString(out, c.name);
+        out.append(", \"term\": ");
+        appendJsonString(out, c.term);
+        out.append(", \"credits\": ");
+        appendJsonShort(out, c.creditHours);
+        out.append(", \"percent\": ");
+        appendJsonFixed(out, percent, 4);
+        out.append(", \"grade\": \"");
+        out.append(percentageToLetter(percent));
+        out.append("\", \"assignments\": [");
+
+        for (size_t i = 0; i < c.work.size(); ++i) {
+            double earned = c.work.earned[i];
+            double max = c.work.max[i];
+            out.append(i == 0 ? "{\"name\": " : ", {\"name\": ");
+            appendJsonString(out, c.work.names[i]);
+            out.append(", \"earned\": ");
+            appendJsonShort(out, earned);
+            out.append(", \"max\": ");
+            appendJsonShort(out, max);
+            out.append(", \"percent\": ");
+            appendJsonFixed(out, (earned / max) * 100.0, 4);
+            out.append('}');
+        }
+        out.append("]}");
+    }
+    out.append("]}\n");
+}
+
+// Appends one student's transcript. The course totals must be up to date
+// (see recalculateCourseTotals).
+void appendTranscript(const StudentRecord& student, TranscriptFormat format,
+                      ReportBuffer& out) {
+    double gpa = calculateOverallGPA(student.courses);
+    double gradedCredits = 0.0;
+    for (const Course& c : student.courses) {
+        if (!c.work.empty() &&
+            gradeBandFor(calculateCoursePercentage(c)).countsInGpa) {
+            gradedCredits += c.creditHours;
+        }
+    }
+
+    if (format == TRANSCRIPT_JSON) {
+        appendJsonTranscript(student, gpa, gradedCredits, out);
+    } else {
+        appendTextTranscript(student, gpa, gradedCredits, out);
+    }
+}
+
+namespace {
+
+// A queue that holds at most "capacity" items, shared by two stages of the
+// pipeline. push waits while the queue is full and pop while it is empty;
+// once close() has been called, pop returns false when nothing is left.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity)
+        : capacity(capacity), closed(false) {}
+
+    void push(const T& item) {
+        unique_lock<mutex> guard(lock);
+        notFull.wait(guard, [this] { return items.size() < capacity; });
+        items.push_back(item);
+        notEmpty.notify_one();
+    }
+
+    bool pop(T& item) {
+        unique_lock<mutex> guard(lock);
+        notEmpty.wait(guard, [this] { return !items.empty() || closed; });
+        if (items.empty()) {
+            return false;
+        }
+        item = items.front();
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        lock_guard<mutex> guard(lock);
+        closed = true;
+        notEmpty.notify_all();
+    }
+
+private:
+    mutex lock;
+    condition_variable notFull;
+    condition_variable notEmpty;
+    deque<T> items;
+    size_t capacity;
+    bool closed;
+};
+
+// A block of students on its way through the pipeline.
+struct TranscriptChunk {
+    size_t sequence;                 // position in the input (0, 1, 2, ...)
+    size_t count;                    // students in use at the front
+    vector<StudentRecord> students;
+    string text;                     // the formatted transcripts
+};
+
+} // namespace
+
+// Streams the whole input once and writes a transcript for every student,
+// in input order, on "threads" grader threads. Returns 0 if every row was
+// valid, 2 if some rows were skipped.
+int runTranscriptMode(istream& in, ostream& out, TranscriptFormat format,
+                      unsigned threads) {
+    if (threads == 0) {
+        threads = 1;
+    }
+    // The writer thread owns "out" from here on, so reading must not
+    // flush it.
+    in.tie(nullptr);
+
+    size_t poolSize = threads * TRANSCRIPT_CHUNKS_PER_THREAD + 2;
+    vector<TranscriptChunk> pool(poolSize);
+    BoundedQueue<TranscriptChunk*> freeChunks(poolSize);
+    BoundedQueue<TranscriptChunk*> parsed(poolSize);
+    BoundedQueue<TranscriptChunk*> formatted(poolSize);
+    for (TranscriptChunk& chunk : pool) {
+        chunk.students.resize(BATCH_BLOCK_STUDENTS);
+        freeChunks.push(&chunk);
+    }
+
+    vector<thread> graders;
+    graders.reserve(threads);
+    for (unsigned t = 0; t < threads; ++t) {
+        graders.push_back(thread([&]() {
+            ReportBuffer buffer;  // this grader's own formatting buffer
+            TranscriptChunk* chunk = nullptr;
+            while (parsed.pop(chunk)) {
+                buffer.clear();
+                for (size_t i = 0; i < chunk->count; ++i) {
+                    for (Course& c : chunk->students[i].courses) {
+                        recalculateCourseTotals(c);
+                    }
+                    appendTranscript(chunk->students[i], format, buffer);
+                }
+                // The chunk's old text becomes this buffer's next storage.
+                buffer.swapText(chunk->text);
+                formatted.push(chunk);
+            }
+        }));
+    }
+
+    // Chunks can finish out of order. At most poolSize are on their way at
+    // once, so chunk "next + k" (k < poolSize) waits in slot
+    // (next + k) % poolSize until every earlier chunk has been written.
+    thread writer([&]() {
+        vector<TranscriptChunk*> waiting(poolSize, nullptr);
+        size_t next = 0;
+        TranscriptChunk* chunk = nullptr;
+        while (formatted.pop(chunk)) {
+            waiting[chunk->sequence % poolSize] = chunk;
+            while (waiting[next % poolSize] != nullptr) {
+                TranscriptChunk* ready = waiting[next % poolSize];
+                waiting[next % poolSize] = nullptr;
+                out.write(ready->text.data(),
+                          static_cast<streamsize>(ready->text.size()));
+                freeChunks.push(ready);
+                next++;
+            }
+        }
+        out.flush();
+    });
+
+    // The reader trades its filled block for the student records of a free
+    // chunk, so neither side copies or allocates.
+    size_t sequence = 0;
+    char delimiter = 0;
+    long long badRows = readStudentBlocks(in, delimiter,
+        [&](vector<StudentRecord>& block, size_t count) {
+            TranscriptChunk* chunk = nullptr;
+            freeChunks.pop(chunk);  // waits while every chunk is in use
+            chunk->students.swap(block);
+            chunk->count = count;
+            chunk->sequence = sequence++;
+            parsed.push(chunk);
+        });
+
+    parsed.close();
+    for (thread& grader : graders) {
+        grader.join();
+    }
+    formatted.close();
+    writer.join();
+
+    return badRows == 0 ? 0 : 2;
+}
+
+// ============================================================================
+// SNAPSHOT FILES
+// ============================================================================
+// A snapshot saves every course and assignment plus nextCourseId in one
+// binary file. Layout (all numbers in the machine's native byte order,
+// which the header records so a file from another machine is rejected):
+//
+//   header (72 bytes)      magic "GPASNAP", version, counts, checksum
+//   course columns         id (int32), credits (double),
+//                          percent (double, the course average),
+//                          workBegin (uint64, courseCount + 1 entries),
+//                          nameBegin (uint64, courseCount + 1 entries),
+//                          categoryBegin (uint64, courseCount + 1 entries)
+//   category columns       weight (double),
+//                          nameBegin (uint64, categoryCount + 1 entries),
+//                          dropLowest (uint32)
+//   assignment columns     earned (double), max (double),
+//                          nameBegin (uint64, assignmentCount + 1 entries),
+//                          category (uint8), extraCredit (uint8)
+//   string table           all names back to back, no separators: course
+//                          names, then category names, then assignments
+//
+// Course i owns assignments workBegin[i] .. workBegin[i+1]-1 and categories
+// categoryBegin[i] .. categoryBegin[i+1]-1, and its name is
+// strings[nameBegin[i] .. nameBegin[i+1]). An assignment's category is an
+// index into its own course's categories. Every column except the uint8
+// ones and the strings starts on an 8-byte boundary, so the columns can be
+// used straight from mmap memory. The checksum (64-bit FNV-1a) covers
+// everything after the header.
+//
+// Version 1 files (from before grading categories) are still read. Their
+// header is 64 bytes (no categoryCount), they have no category columns,
+// and their "percent" column holds each course's sum of percentages.
+
+const char SNAPSHOT_MAGIC[8] = { 'G', 'P', 'A', 'S', 'N', 'A', 'P', '\0' };
+const uint32_t SNAPSHOT_VERSION = 2;
+const uint32_t SNAPSHOT_V1_HEADER_BYTES = 64;
+const uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t courseCount;
+    uint64_t assignmentCount;
+    uint64_t stringBytes;
+    int32_t nextCourseId;
+    uint32_t journalEpoch;  // which journal this snapshot goes with
+    uint64_t checksum;
+    uint64_t fileSize;
+    uint64_t categoryCount;  // version 2 and later
+};
+
+// Where each column starts, worked out from the counts alone so the writer
+// and the reader always agree.
+struct SnapshotLayout {
+    uint64_t ids;
+    uint64_t credits;
+    uint64_t percentages;
+    uint64_t workBegin;
+    uint64_t courseNameBegin;
+    uint64_t categoryBegin;
+    uint64_t weights;
+    uint64_t categoryNameBegin;
+    uint64_t dropLowest;
+    uint64_t earned;
+    uint64_t max;
+    uint64_t assignmentNameBegin;
+    uint64_t assignmentCategory;
+    uint64_t extraCredit;
+    uint64_t strings;
+    uint64_t fileSize;
+};
+
+static uint64_t alignTo8(uint64_t offset) {
+    return (offset + 7) & ~static_cast<uint64_t>(7);
+}
+
+// In version 1 files the category columns are empty (zero bytes long).
+static SnapshotLayout snapshotLayout(uint32_t version, uint64_t courseCount,
+                                     uint64_t categoryCount,
+                                     uint64_t assignmentCount,
+                                     uint64_t stringBytes) {
+    bool v1 = version == 1;
+    uint64_t courseOffsets = v1 ? 0 : courseCount + 1;
+    uint64_t categoryOffsets = v1 ? 0 : categoryCount + 1;
+    uint64_t assignmentBytes = v1 ? 0 : assignmentCount;
+
+    SnapshotLayout l;
+    l.ids = v1 ? SNAPSHOT_V1_HEADER_BYTES : sizeof(SnapshotHeader);
+    l.credits = alignTo8(l.ids + courseCount * sizeof(int32_t));
+    l.percentages = l.credits + courseCount * sizeof(double);
+    l.workBegin = l.percentages + courseCount * sizeof(double);
+    l.courseNameBegin = l.workBegin + (courseCount + 1) * sizeof(uint64_t);
+    l.categoryBegin = l.courseNameBegin + (courseCount + 1) * sizeof(uint64_t);
+    l.weights = l.categoryBegin + courseOffsets * sizeof(uint64_t);
+    l.categoryNameBegin = l.weights + categoryCount * sizeof(double);
+    l.dropLowest = l.categoryNameBegin + categoryOffsets * sizeof(uint64_t);
+    l.earned = alignTo8(l.dropLowest + categoryCount * sizeof(uint32_t));
+    l.max = l.earned + assignmentCount * sizeof(double);
+    l.assignmentNameBegin = l.max + assignmentCount * sizeof(double);
+    l.assignmentCategory = l.assignmentNameBegin +
+        (assignmentCount + 1) * sizeof(uint64_t);
+    l.extraCredit = l.assignmentCategory + assignmentBytes;
+    l.strings = l.extraCredit + assignmentBytes;
+    l.fileSize = l.strings + stringBytes;
+    return l;
+}
+
+// 64-bit FNV-1a hash, continued from "hash" over "size" more bytes.
+static uint64_t fnv1a(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+
+// Writes bytes to the snapshot file and folds them into the checksum.
+// Pads with zeros first so the bytes land at "offset".
+static void writeSnapshotBytes(ofstream& out, uint64_t& position,
+                               uint64_t& checksum, uint64_t offset,
+                               const void* data, size_t size) {
+    static const char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    while (position < offset) {
+        size_t pad = static_cast<size_t>(offset - position);
+        if (pad > sizeof(zeros)) {
+            pad = sizeof(zeros);
+        }
+        out.write(zeros, static_cast<streamsize>(pad));
+        checksum = fnv1a(checksum, zeros, pad);
+        position += pad;
+    }
+    if (size > 0) {
+        out.write(static_cast<const char*>(data), static_cast<streamsize>(size));
+        checksum = fnv1a(checksum, data, size);
+        position += size;
+    }
+}
+
+// Flushes a file (or directory) that is already written to the disk itself.
+// Returns false if that fails. Systems without fsync just return true.
+static bool syncToDisk(const string& path) {
+#if defined(GPA_HAVE_MMAP)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+#else
+    (void)path;
+    return true;
+#endif
+}
+
+// The directory that holds "path" ("." for a bare file name).
+static string parentDirectory(const string& path) {
+    size_t slash = path.find_last_of('/');
+    if (slash == string::npos) {
+        return ".";
+    }
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+// Saves all courses to "path". The file is written next to the target and
+// renamed over it at the end, so a crash never leaves a half-written file.
+// The new file and then its directory entry are flushed to the disk before
+// this returns, so the caller may empty the journal right after.
+bool saveSnapshot(const string& path, const Gradebook& book, string& error) {
+    const CourseStore& courses = book.courses;
+
+    // Gather the course and category columns and the offsets first.
+    uint64_t courseCount = courses.size();
+    vector<int32_t> ids;
+    vector<double> credits;
+    vector<double> percents;
+    vector<uint64_t> workBegin;
+    vector<uint64_t> courseNameBegin;
+    vector<uint64_t> categoryBegin;
+    vector<double> weights;
+    vector<uint64_t> categoryNameBegin;
+    vector<uint32_t> dropLowest;
+    vector<uint64_t> assignmentNameBegin;
+    ids.reserve(courseCount);
+    credits.reserve(courseCount);
+    percents.reserve(courseCount);
+    workBegin.reserve(courseCount + 1);
+    courseNameBegin.reserve(courseCount + 1);
+    categoryBegin.reserve(courseCount + 1);
+
+    uint64_t assignmentCount = 0;
+    uint64_t categoryCount = 0;
+    uint64_t stringBytes = 0;
+    for (const Course& c : courses) {
+        ids.push_back(c.id);
+        credits.push_back(c.creditHours);
+        percents.push_back(calculateCoursePercentage(c));
+        workBegin.push_back(assignmentCount);
+        courseNameBegin.push_back(stringBytes);
+        categoryBegin.push_back(categoryCount);
+        assignmentCount += c.work.size();
+        categoryCount += c.categories.size();
+        stringBytes += c.name.size();
+    }
+    workBegin.push_back(assignmentCount);
+    courseNameBegin.push_back(stringBytes);
+    categoryBegin.push_back(categoryCount);
+
+    weights.reserve(categoryCount);
+    dropLowest.reserve(categoryCount);
+    categoryNameBegin.reserve(categoryCount + 1);
+    for (const Course& c : courses) {
+        for (const Category& cat : c.categories) {
+            weights.push_back(cat.weight);
+            dropLowest.push_back(static_cast<uint32_t>(cat.dropLowest));
+            categoryNameBegin.push_back(stringBytes);
+            stringBytes += cat.name.size();
+        }
+    }
+    categoryNameBegin.push_back(stringBytes);
+
+    assignmentNameBegin.reserve(assignmentCount + 1);
+    for (const Course& c : courses) {
+        for (const PooledName& name : c.work.names) {
+            assignmentNameBegin.push_back(stringBytes);
+            stringBytes += name.size();
+        }
+    }
+    assignmentNameBegin.push_back(stringBytes);
+
+    SnapshotLayout layout = snapshotLayout(SNAPSHOT_VERSION, courseCount,
+                                           categoryCount, assignmentCount,
+                                           stringBytes);
+
+    string tempPath = path + ".tmp";
+    ofstream out(tempPath.c_str(), ios::binary | ios::trunc);
+    if (!out) {
+        error = "could not create " + tempPath;
+        return false;
+    }
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    uint64_t position = sizeof(header);
+    uint64_t checksum = FNV_OFFSET_BASIS;
+
+    writeSnapshotBytes(out, position, checksum, layout.ids,
+                       ids.data(), ids.size() * sizeof(int32_t));
+    writeSnapshotBytes(out, position, checksum, layout.credits,
+                       credits.data(), credits.size() * sizeof(double));
+    writeSnapshotBytes(out, position, checksum, layout.percentages,
+                       percents.data(), percents.size() * sizeof(double));
+    writeSnapshotBytes(out, position, checksum, layout.workBegin,
+                       workBegin.data(), workBegin.size() * sizeof(uint64_t));
+    writeSnapshotBytes(out, position, checksum, layout.courseNameBegin,
+                       courseNameBegin.data(),
+                       courseNameBegin.size() * sizeof(uint64_t));
+    writeSnapshotBytes(out, position, checksum, layout.categoryBegin,
+                       categoryBegin.data(),
+                       categoryBegin.size() * sizeof(uint64_t));
+    writeSnapshotBytes(out, position, checksum, layout.weights,
+                       weights.data(), weights.size() * sizeof(double));
+    writeSnapshotBytes(out, position, checksum, layout.categoryNameBegin,
+                       categoryNameBegin.data(),
+                       categoryNameBegin.size() * sizeof(uint64_t));
+    writeSnapshotBytes(out, position, checksum, layout.dropLowest,
+                       dropLowest.data(), dropLowest.size() * sizeof(uint32_t));
+
+    // Assignment columns are written course by course, straight from each
+    // course's own columns. Each column starts with a (possibly empty) pad
+    // up to its offset in the layout.
+    writeSnapshotBytes(out, position, checksum, layout.earned, nullptr, 0);
+    for (const Course& c : courses) {
+        writeSnapshotBytes(out, position, checksum, position,
+                           c.work.earned.data(), c.work.size() * sizeof(double));
+    }
+    writeSnapshotBytes(out, position, checksum, layout.max, nullptr, 0);
+    for (const Course& c : courses) {
+        writeSnapshotBytes(out, position, checksum, position,
+                           c.work.max.data(), c.work.size() * sizeof(double));
+    }
+    writeSnapshotBytes(out, position, checksum, layout.assignmentNameBegin,
+                       assignmentNameBegin.data(),
+                       assignmentNameBegin.size() * sizeof(uint64_t));
+    writeSnapshotBytes(out, position, checksum, layout.assignmentCategory,
+                       nullptr, 0);
+    for (const Course& c : courses) {
+        writeSnapshotBytes(out, position, checksum, position,
+                           c.work.category.data(), c.work.size());
+    }
+    writeSnapshotBytes(out, position, checksum, layout.extraCredit, nullptr, 0);
+    for (const Course& c : courses) {
+        writeSnapshotBytes(out, position, checksum, position,
+                           c.work.extraCredit.data(), c.work.size());
+    }
+
+    writeSnapshotBytes(out, position, checksum, layout.strings, nullptr, 0);
+    for (const Course& c : courses) {
+        writeSnapshotBytes(out, position, checksum, position,
+                           c.name.c_str(), c.name.size());
+    }
+    for (const Course& c : courses) {
+        for (const Category& cat : c.categories) {
+            writeSnapshotBytes(out, position, checksum, position,
+                               cat.name.data(), cat.name.size());
+        }
+    }
+    for (const Course& c : courses) {
+        for (const PooledName& name : c.work.names) {
+            writeSnapshotBytes(out, position, checksum, position,
+                               name.c_str(), name.size());
+        }
+    }
+
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.courseCount = courseCount;
+    header.assignmentCount = assignmentCount;
+    header.stringBytes = stringBytes;
+    header.nextCourseId = book.nextCourseId;
+    header.journalEpoch = book.checkpointEpoch;
+    header.checksum = checksum;
+    header.fileSize = layout.fileSize;
+    header.categoryCount = categoryCount;
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+
+    if (!out || position != layout.fileSize || !syncToDisk(tempPath)) {
+        error = "could not write " + tempPath;
+        remove(tempPath.c_str());
+        return false;
+    }
+
+    if (rename(tempPath.c_str(), path.c_str()) != 0) {
+        error = "could not replace " + path;
+        remove(tempPath.c_str());
+        return false;
+    }
+    if (!syncToDisk(parentDirectory(path))) {
+        error = "could not flush the directory of " + path;
+        return false;
+    }
+    return true;
+}
+
+MappedFile::MappedFile() : bytes(nullptr), length(0), mapped(false) {}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const string& path, string& error) {
+    close();
+
+#if defined(GPA_HAVE_MMAP)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "could not open " + path;
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        error = "could not read the size of " + path;
+        return false;
+    }
+
+    length = static_cast<size_t>(info.st_size);
+    if (length > 0) {
+        void* memory = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (memory == MAP_FAILED) {
+            ::close(fd);
+            length = 0;
+            error = "could not map " + path;
+            return false;
+        }
+        bytes = static_cast<const unsigned char*>(memory);
+        mapped = true;
+    }
+    ::close(fd); // the mapping stays valid after closing the descriptor
+    return true;
+#else
+    ifstream in(path.c_str(), ios::binary);
+    if (!in) {
+        error = "could not open " + path;
+        return false;
+    }
+    in.seekg(0, ios::end);
+    fallback.resize(static_cast<size_t>(in.tellg()));
+    in.seekg(0, ios::beg);
+    if (!fallback.empty()) {
+        in.read(reinterpret_cast<char*>(&fallback[0]),
+                static_cast<streamsize>(fallback.size()));
+    }
+    if (!in) {
+        error = "could not read " + path;
+        fallback.clear();
+        return false;
+    }
+    bytes = fallback.empty() ? nullptr : &fallback[0];
+    length = fallback.size();
+    return true;
+#endif
+}
+
+void MappedFile::close() {
+#if defined(GPA_HAVE_MMAP)
+    if (mapped) {
+        munmap(const_cast<unsigned char*>(bytes), length);
+    }
+#endif
+    fallback.clear();
+    bytes = nullptr;
+    length = 0;
+    mapped = false;
+}
+
+SnapshotView::SnapshotView()
+    : version(SNAPSHOT_VERSION), courses(0), categories(0), assignments(0),
+      nextId(MIN_COURSE_ID), epoch(0), ids(nullptr), credits(nullptr),
+      percentages(nullptr), workBegin(nullptr), courseNameBegin(nullptr),
+      categoryBegin(nullptr), weights(nullptr), categoryNameBegin(nullptr),
+      dropLowest(nullptr), earned(nullptr), max(nullptr),
+      assignmentNameBegin(nullptr), assignmentCategory(nullptr),
+      extraCredit(nullptr), strings(nullptr) {}
+
+bool SnapshotView::open(const string& path, bool verifyChecksum,
+                        string& error) {
+    if (!file.open(path, error)) {
+        return false;
+    }
+
+    if (file.size() < SNAPSHOT_V1_HEADER_BYTES) {
+        error = path + " is too small to be a snapshot";
+        return false;
+    }
+
+    // Version 1 headers stop before categoryCount.
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(&header, file.data(), SNAPSHOT_V1_HEADER_BYTES);
+
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+        error = path + " is not a gradebook snapshot";
+        return false;
+    }
+    if (header.version != 1 && header.version != SNAPSHOT_VERSION) {
+        error = path + " has an unsupported snapshot version";
+        return false;
+    }
+    size_t headerBytes = header.version == 1 ? SNAPSHOT_V1_HEADER_BYTES
+                                             : sizeof(SnapshotHeader);
+    if (file.size() < headerBytes) {
+        error = path + " is too small to be a snapshot";
+        return false;
+    }
+    memcpy(&header, file.data(), headerBytes);
+    if (header.byteOrder != SNAPSHOT_BYTE_ORDER) {
+        error = path + " was written on a machine with another byte order";
+        return false;
+    }
+
+    // Guard against absurd counts before doing arithmetic with them.
+    if (header.courseCount > file.size() || header.assignmentCount > file.size() ||
+        header.stringBytes > file.size() || header.categoryCount > file.size()) {
+        error = path + " is damaged (bad counts)";
+        return false;
+    }
+
+    SnapshotLayout layout = snapshotLayout(header.version, header.courseCount,
+                                           header.categoryCount,
+                                           header.assignmentCount,
+                                           header.stringBytes);
+    if (layout.fileSize != file.size() || header.fileSize != file.size()) {
+        error = path + " is damaged (wrong size)";
+        return false;
+    }
+
+    if (verifyChecksum) {
+        uint64_t checksum = fnv1a(FNV_OFFSET_BASIS,
+                                  file.data() + headerBytes,
+                                  file.size() - headerBytes);
+        if (checksum != header.checksum) {
+            error = path + " is damaged (checksum mismatch)";
+            return false;
+        }
+    }
+
+    const unsigned char* base = file.data();
+    version = header.version;
+    courses = static_cast<size_t>(header.courseCount);
+    categories = static_cast<size_t>(header.categoryCount);
+    assignments = static_cast<size_t>(header.assignmentCount);
+    nextId = header.nextCourseId;
+    epoch = header.journalEpoch;
+    ids = reinterpret_cast<const int32_t*>(base + layout.ids);
+    credits = reinterpret_cast<const double*>(base + layout.credits);
+    percentages = reinterpret_cast<const double*>(base + layout.percentages);
+    workBegin = reinterpret_cast<const uint64_t*>(base + layout.workBegin);
+    courseNameBegin = reinterpret_cast<const uint64_t*>(base + layout.courseNameBegin);
+    earned = reinterpret_cast<const double*>(base + layout.earned);
+    max = reinterpret_cast<const double*>(base + layout.max);
+    assignmentNameBegin =
+        reinterpret_cast<const uint64_t*>(base + layout.assignmentNameBegin);
+    strings = reinterpret_cast<const char*>(base + layout.strings);
+
+    uint64_t firstAssignmentName = courseNameBegin[courses];
+    if (version != 1) {
+        categoryBegin = reinterpret_cast<const uint64_t*>(base + layout.categoryBegin);
+        weights = reinterpret_cast<const double*>(base + layout.weights);
+        categoryNameBegin =
+            reinterpret_cast<const uint64_t*>(base + layout.categoryNameBegin);
+        dropLowest = reinterpret_cast<const uint32_t*>(base + layout.dropLowest);
+        assignmentCategory = base + layout.assignmentCategory;
+        extraCredit = base + layout.extraCredit;
+
+        if (categoryBegin[0] != 0 || categoryBegin[courses] != categories ||
+            categoryNameBegin[0] != courseNameBegin[courses]) {
+            error = path + " is damaged (bad offsets)";
+            return false;
+        }
+        for (size_t i = 0; i < courses; ++i) {
+            if (categoryBegin[i] > categoryBegin[i + 1]) {
+                error = path + " is damaged (bad offsets)";
+                return false;
+            }
+        }
+        for (size_t k = 0; k < categories; ++k) {
+            if (categoryNameBegin[k] > categoryNameBegin[k + 1]) {
+                error = path + " is damaged (bad offsets)";
+                return false;
+            }
+        }
+        firstAssignmentName = categoryNameBegin[categories];
+    }
+
+    // The offset columns must only go forward and stay inside the file,
+    // otherwise reading names or assignments could run off the end.
+    if (workBegin[0] != 0 || workBegin[courses] != assignments ||
+        courseNameBegin[0] != 0 || assignmentNameBegin[assignments] !=
+        header.stringBytes || firstAssignmentName != assignmentNameBegin[0]) {
+        error = path + " is damaged (bad offsets)";
+        return false;
+    }
+    for (size_t i = 0; i < courses; ++i) {
+        if (workBegin[i] > workBegin[i + 1] ||
+            courseNameBegin[i] > courseNameBegin[i + 1]) {
+            error = path + " is damaged (bad offsets)";
+            return false;
+        }
+    }
+    for (size_t i = 0; i < assignments; ++i) {
+        if (assignmentNameBegin[i] > assignmentNameBegin[i + 1]) {
+            error = path + " is damaged (bad offsets)";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+PooledName SnapshotView::courseName(size_t i) const {
+    return PooledName(strings + courseNameBegin[i],
+                  static_cast<size_t>(courseNameBegin[i + 1] - courseNameBegin[i]));
+}
+
+string SnapshotView::categoryName(size_t k) const {
+    return string(strings + categoryNameBegin[k],
+                  static_cast<size_t>(categoryNameBegin[k + 1] -
+                                      categoryNameBegin[k]));
+}
+
+double SnapshotView::coursePercentage(size_t i) const {
+    if (version != 1) {
+        return percentages[i];
+    }
+    size_t count = courseAssignmentCount(i);
+    return count == 0 ? 0.0 : percentages[i] / static_cast<double>(count);
+}
+
+PooledName SnapshotView::assignmentName(size_t i) const {
+    return PooledName(strings + assignmentNameBegin[i],
+                  static_cast<size_t>(assignmentNameBegin[i + 1] -
+                                      assignmentNameBegin[i]));
+}
+
+double SnapshotView::overallGPA() const {
+    GpaTotals totals;
+    totals.qualityPoints = 0.0;
+    totals.credits = 0.0;
+    totals.fixedQuality = 0;
+    totals.fixedHalfHours = 0;
+
+    for (size_t i = 0; i < courses; ++i) {
+        if (courseAssignmentCount(i) == 0) {
+            continue;
+        }
+        addCourseToTotals(totals, coursePercentage(i), credits[i]);
+    }
+
+    return gpaFromTotals(totals);
+}
+
+// Replaces all courses with the contents of a snapshot file. On failure the
+// current courses are left untouched.
+bool loadSnapshot(const string& path, Gradebook& book, string& error) {
+    SnapshotView view;
+    if (!view.open(path, true, error)) {
+        return false;
+    }
+
+    // Every value is held to the limits applyMutation uses, written as
+    // !(in range) so NaN is refused too.
+    int savedNextId = view.nextCourseId();
+    if (!(savedNextId >= MIN_COURSE_ID && savedNextId <= MAX_COURSE_ID + 1)) {
+        error = path + " contains an invalid next course id";
+        return false;
+    }
+
+    CourseStore loaded;
+    for (size_t i = 0; i < view.courseCount(); ++i) {
+        Course c;
+        c.id = view.courseId(i);
+        c.name = view.courseName(i);
+        c.creditHours = view.courseCredits(i);
+        if (!(c.creditHours >= 0.5 && c.creditHours <= 6.0)) {
+            error = path + " contains a course with invalid credit hours";
+            return false;
+        }
+
+        size_t categoryCount = view.courseCategoryCount(i);
+        if (categoryCount > static_cast<size_t>(MAX_CATEGORIES)) {
+            error = path + " contains a course with too many categories";
+            return false;
+        }
+        if (categoryCount > 0) {
+            c.categories.resize(categoryCount);
+            for (size_t k = 0; k < categoryCount; ++k) {
+                size_t at = view.firstCategory(i) + k;
+                Category& cat = c.categories[k];
+                cat.name = view.categoryName(at);
+                cat.weight = view.categoryWeight(at);
+                cat.dropLowest = view.categoryDropLowest(at);
+                if (!(cat.weight > 0.0 && cat.weight <= 100.0) ||
+                    cat.dropLowest < 0 || cat.dropLowest > MAX_DROP_LOWEST) {
+                    error = path + " contains an invalid grading category";
+                    return false;
+                }
+            }
+        }
+
+        size_t first = view.firstAssignment(i);
+        size_t count = view.courseAssignmentCount(i);
+        const double* earned = view.earnedColumn() + first;
+        const double* max = view.maxColumn() + first;
+
+        c.work.earned.assign(earned, earned + count);
+        c.work.max.assign(max, max + count);
+        if (view.categoryColumn() != nullptr) {
+            const unsigned char* category = view.categoryColumn() + first;
+            const unsigned char* extra = view.extraCreditColumn() + first;
+            c.work.category.assign(category, category + count);
+            c.work.extraCredit.assign(extra, extra + count);
+        } else {
+            c.work.category.assign(count, 0);
+            c.work.extraCredit.assign(count, 0);
+        }
+        c.work.names.reserve(count);
+        for (size_t j = 0; j < count; ++j) {
+            if (!(max[j] >= 1.0 && max[j] <= 10000.0) ||
+                !(earned[j] >= 0.0 && earned[j] <= max[j])) {
+                error = path + " contains an invalid assignment score";
+                return false;
+            }
+            if (c.work.category[j] >= c.categories.size() ||
+                c.work.extraCredit[j] > 1) {
+                error = path + " contains an invalid assignment category";
+                return false;
+            }
+            c.work.names.push_back(view.assignmentName(first + j));
+        }
+        recalculateCourseTotals(c);
+        if (hasStrandedExtraCredit(c)) {
+            error = path + " has extra credit in a category without scores";
+            return false;
+        }
+
+        if (loaded.insert(c).generation == 0) {
+            error = path + " contains an invalid or repeated course id";
+            return false;
+        }
+    }
+
+    for (const Course& c : loaded) {
+        if (c.id >= savedNextId) {
+            savedNextId = c.id + 1; // never hand out an id that is in use
+        }
+    }
+
+    book.courses = loaded;
+    book.grades.rebuild(book.courses);
+    book.nextCourseId = savedNextId;
+    book.checkpointEpoch = view.journalEpoch();
+    return true;
+}
+
+// Menu screen: save all courses to a snapshot file. Saving to the "--data"
+// file is a checkpoint, so the journal is emptied as well.
+void saveGradebookMenu(Gradebook& book) {
+    string path = askSnapshotPath(book.dataPath);
+    if (path.empty()) {
+        cout << "No file name entered. Nothing was saved.\n";
+        return;
+    }
+
+    string error;
+    bool saved = (path == book.dataPath) ? checkpointGradebook(book, error)
+                                         : saveSnapshot(path, book, error);
+    if (saved) {
+        cout << "Saved " << book.courses.size() << " course(s) to " << path
+             << ".\n";
+    } else {
+        cout << "Save failed: " << error << "\n";
+    }
+}
+
+// Menu screen: replace all courses with a snapshot file.
+void loadGradebookMenu(Gradebook& book) {
+    string path = askSnapshotPath(book.dataPath);
+    if (path.empty()) {
+        cout << "No file name entered. Nothing was loaded.\n";
+        return;
+    }
+
+    uint32_t epoch = book.checkpointEpoch;
+    string error;
+    if (!loadSnapshot(path, book, error)) {
+        cout << "Load failed: " << error << "\n";
+        return;
+    }
+    cout << "Loaded " << book.courses.size() << " course(s) from " << path
+         << ".\n";
+
+    // Undo steps refer to the old courses.
+    if (book.history != nullptr) {
+        book.history->clear();
+    }
+
+    // The journal only describes changes to the old courses, so write the
+    // loaded courses as the new starting point right away.
+    book.checkpointEpoch = epoch;
+    if (!checkpointGradebook(book, error)) {
+        cout << "Warning: could not save to " << book.dataPath << ": "
+             << error << "\n";
+    }
+}
+
+// Asks for a snapshot file name; pressing Enter picks "defaultPath".
+string askSnapshotPath(const string& defaultPath) {
+    if (defaultPath.empty()) {
+        cout << "Enter the snapshot file name: ";
+    } else {
+        cout << "Enter the snapshot file name (press Enter for "
+             << defaultPath << "): ";
+    }
+
+    string path;
+    getline(cin, path);
+    if (path.empty()) {
+        path = defaultPath;
+    }
+    return path;
+}
+
+// ============================================================================
+// COLUMNAR EXPORT
+// ============================================================================
+// "--export-columns" writes the courses, categories and assignments as
+// column-oriented record batches for analytics tools, in the spirit of an
+// Arrow IPC stream; "--import-columns" reads such a file back. Layout (all
+// numbers in the machine's native byte order, which the header records):
+//
+//   header (24 bytes)     magic "GPACOLS", version, byte order, nextCourseId
+//   blocks, one after the other, each:
+//     block header (32 bytes)   kind, rows, body size, checksum
+//     body                      the batch's columns, each on an 8-byte
+//                               boundary and padded to a multiple of 8
+//
+// The kinds and their columns are listed next to ColumnarKind. Names are
+// not repeated in the batches: every name column holds an index into one
+// name dictionary, and each dictionary block adds the names the batches
+// after it need for the first time (offsets: uint64, rows + 1 entries,
+// then the text). All course batches come first, then category batches,
+// then assignment batches, and an END block closes the file. A batch holds
+// at most COLUMNAR_BATCH_ROWS rows, so the writer only ever buffers one
+// batch. The checksum (64-bit FNV-1a) covers the block's body.
+
+const char COLUMNAR_MAGIC[8] = { 'G', 'P', 'A', 'C', 'O', 'L', 'S', '\0' };
+const uint32_t COLUMNAR_VERSION = 1;
+const size_t COLUMNAR_BATCH_ROWS = 65536;
+const char* const UNGRADED_LETTER = "N/A";
+
+struct ColumnarHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    int32_t nextCourseId;
+    uint32_t reserved;
+};
+
+struct ColumnarBlockHeader {
+    uint32_t kind;
+    uint32_t reserved;
+    uint64_t rows;
+    uint64_t bodyBytes;
+    uint64_t checksum;
+};
+
+// Width in bytes of each column of a record batch, in file order.
+static const unsigned char COURSE_COLUMN_WIDTHS[] = { 8, 8, 4, 4, 4, 4, 4 };
+static const unsigned char CATEGORY_COLUMN_WIDTHS[] = { 8, 4, 4, 4 };
+static const unsigned char ASSIGNMENT_COLUMN_WIDTHS[] = { 8, 8, 8, 4, 4, 1, 1 };
+
+// The column widths of a record batch kind, or nullptr for other kinds.
+static const unsigned char* columnarWidths(uint32_t kind, int& count) {
+    switch (kind) {
+        case COLUMNAR_COURSES:
+            count = sizeof(COURSE_COLUMN_WIDTHS);
+            return COURSE_COLUMN_WIDTHS;
+        case COLUMNAR_CATEGORIES:
+            count = sizeof(CATEGORY_COLUMN_WIDTHS);
+            return CATEGORY_COLUMN_WIDTHS;
+        case COLUMNAR_ASSIGNMENTS:
+            count = sizeof(ASSIGNMENT_COLUMN_WIDTHS);
+            return ASSIGNMENT_COLUMN_WIDTHS;
+        default:
+            count = 0;
+            return nullptr;
+    }
+}
+
+// Where "column" starts in the body of a record batch with "rows" rows.
+// Passing the column count gives the size of the whole body.
+static uint64_t columnarOffset(uint32_t kind, uint64_t rows, int column) {
+    int count = 0;
+    const unsigned char* widths = columnarWidths(kind, count);
+    uint64_t offset = 0;
+    for (int i = 0; i < column && i < count; ++i) {
+        offset += alignTo8(rows * widths[i]);
+    }
+    return offset;
+}
+
+namespace {
+
+// Writes one export file, one batch at a time. Names get their dictionary
+// index the first time a batch uses them and are written in a dictionary
+// block just before that batch.
+class ColumnarWriter {
+public:
+    explicit ColumnarWriter(const string& path)
+        : out(path.c_str(), ios::binary | ios::trunc), nextName(0) {}
+
+    bool good() const { return static_cast<bool>(out); }
+
+    void writeHeader(int nextCourseId) {
+        ColumnarHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, COLUMNAR_MAGIC, sizeof(header.magic));
+        header.version = COLUMNAR_VERSION;
+        header.byteOrder = SNAPSHOT_BYTE_ORDER;
+        header.nextCourseId = nextCourseId;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+
+    // Clears the body for a record batch; column() then says where each
+    // of its columns goes.
+    void startBatch(uint32_t kind, size_t rows) {
+        int count = 0;
+        columnarWidths(kind, count);
+        body.assign(static_cast<size_t>(columnarOffset(kind, rows, count)), 0);
+    }
+
+    template <typename T>
+    T* column(uint32_t kind, size_t rows, int column) {
+        return reinterpret_cast<T*>(
+            body.data() + columnarOffset(kind, rows, column));
+    }
+
+    uint32_t nameIndex(const PooledName& name) {
+        unordered_map<uint32_t, uint32_t>::const_iterator found =
+            pooled.find(name.poolId());
+        if (found != pooled.end()) {
+            return found->second;
+        }
+        uint32_t index = addName(name.c_str(), name.size());
+        pooled.emplace(name.poolId(), index);
+        return index;
+    }
+
+    uint32_t nameIndex(const string& name) {
+        unordered_map<string, uint32_t>::const_iterator found = other.find(name);
+        if (found != other.end()) {
+            return found->second;
+        }
+        uint32_t index = addName(name.data(), name.size());
+        other.emplace(name, index);
+        return index;
+    }
+
+    // Writes the dictionary block for the new names (if any), then the
+    // record batch built with startBatch.
+    void finishBatch(uint32_t kind, size_t rows) {
+        if (!newOffsets.empty()) {
+            newOffsets.push_back(newText.size());
+            vector<unsigned char> dictionary(
+                alignTo8(newOffsets.size() * sizeof(uint64_t) + newText.size()),
+                0);
+            memcpy(dictionary.data(), newOffsets.data(),
+                   newOffsets.size() * sizeof(uint64_t));
+            memcpy(dictionary.data() + newOffsets.size() * sizeof(uint64_t),
+                   newText.data(), newText.size());
+            writeBlock(COLUMNAR_DICTIONARY, newOffsets.size() - 1,
+                       dictionary.data(), dictionary.size());
+            newOffsets.clear();
+            newText.clear();
+        }
+        writeBlock(kind, rows, body.data(), body.size());
+    }
+
+    void finish() {
+        writeBlock(COLUMNAR_END, 0, nullptr, 0);
+        out.close();
+    }
+
+private:
+    uint32_t addName(const char* text, size_t length) {
+        newOffsets.push_back(newText.size());
+        newText.append(text, length);
+        return nextName++;
+    }
+
+    void writeBlock(uint32_t kind, uint64_t rows, const unsigned char* data,
+                    size_t size) {
+        ColumnarBlockHeader header;
+        memset(&header, 0, sizeof(header));
+        header.kind = kind;
+        header.rows = rows;
+        header.bodyBytes = size;
+        header.checksum = fnv1a(FNV_OFFSET_BASIS, data, size);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        if (size > 0) {
+            out.write(reinterpret_cast<const char*>(data),
+                      static_cast<streamsize>(size));
+        }
+    }
+
+    ofstream out;
+    vector<unsigned char> body;
+    unordered_map<uint32_t, uint32_t> pooled;  // pool id -> name index
+    unordered_map<string, uint32_t> other;     // category names and letters
+    vector<uint64_t> newOffsets;               // names not written yet
+    string newText;
+    uint32_t nextName;
+};
+
+} // namespace
+
+// Writes every course of "book" to "path" as columnar record batches. Like
+// saveSnapshot it writes next to the target and renames at the end.
+bool exportColumnar(const string& path, const Gradebook& book, string& error) {
+    const CourseStore& courses = book.courses;
+    string tempPath = path + ".tmp";
+    ColumnarWriter writer(tempPath);
+    if (!writer.good()) {
+        error = "could not create " + tempPath;
+        return false;
+    }
+    writer.writeHeader(book.nextCourseId);
+
+    vector<const Course*> all;
+    all.reserve(courses.size());
+    for (const Course& c : courses) {
+        all.push_back(&c);
+    }
+
+    // Courses.
+    for (size_t begin = 0; begin < all.size(); begin += COLUMNAR_BATCH_ROWS) {
+        const uint32_t kind = COLUMNAR_COURSES;
+        size_t rows = all.size() - begin < COLUMNAR_BATCH_ROWS
+                          ? all.size() - begin : COLUMNAR_BATCH_ROWS;
+        writer.startBatch(kind, rows);
+        double* credits = writer.column<double>(kind, rows, COL_COURSE_CREDITS);
+        double* percent = writer.column<double>(kind, rows, COL_COURSE_PERCENT);
+        int32_t* ids = writer.column<int32_t>(kind, rows, COL_COURSE_ID);
+        uint32_t* names = writer.column<uint32_t>(kind, rows, COL_COURSE_NAME);
+        uint32_t* letters = writer.column<uint32_t>(kind, rows, COL_COURSE_LETTER);
+        uint32_t* categories =
+            writer.column<uint32_t>(kind, rows, COL_COURSE_CATEGORIES);
+        uint32_t* assignments =
+            writer.column<uint32_t>(kind, rows, COL_COURSE_ASSIGNMENTS);
+
+        for (size_t r = 0; r < rows; ++r) {
+            const Course& c = *all[begin + r];
+            credits[r] = c.creditHours;
+            ids[r] = c.id;
+            names[r] = writer.nameIndex(c.name);
+            categories[r] = static_cast<uint32_t>(c.categories.size());
+            assignments[r] = static_cast<uint32_t>(c.work.size());
+            if (c.work.empty()) {
+                percent[r] = 0.0;
+                letters[r] = writer.nameIndex(string(UNGRADED_LETTER));
+            } else {
+                percent[r] = calculateCoursePercentage(c);
+                letters[r] = writer.nameIndex(string(percentageToLetter(percent[r])));
+            }
+        }
+        writer.finishBatch(kind, rows);
+    }
+
+    // Categories and assignments fill their batches across course
+    // boundaries: "course" and "next" say where the batch goes on.
+    size_t course = 0;
+    size_t next = 0;
+    auto fillRows = [&](size_t (*countOf)(const Course&), size_t& rows) {
+        size_t startCourse = course;
+        size_t startNext = next;
+        rows = 0;
+        while (course < all.size() && rows < COLUMNAR_BATCH_ROWS) {
+            size_t left = countOf(*all[course]) - next;
+            size_t take = left < COLUMNAR_BATCH_ROWS - rows
+                              ? left : COLUMNAR_BATCH_ROWS - rows;
+            rows += take;
+            next += take;
+            if (next == countOf(*all[course])) {
+                course++;
+                next = 0;
+            }
+        }
+        course = startCourse;
+        next = startNext;
+    };
+
+    size_t rows = 0;
+    auto categoryCount = [](const Course& c) { return c.categories.size(); };
+    for (fillRows(categoryCount, rows); rows > 0; fillRows(categoryCount, rows)) {
+        const uint32_t kind = COLUMNAR_CATEGORIES;
+        writer.startBatch(kind, rows);
+        double* weights = writer.column<double>(kind, rows, COL_CATEGORY_WEIGHT);
+        int32_t* ids = writer.column<int32_t>(kind, rows, COL_CATEGORY_COURSE);
+        uint32_t* names = writer.column<uint32_t>(kind, rows, COL_CATEGORY_NAME);
+        uint32_t* drops = writer.column<uint32_t>(kind, rows, COL_CATEGORY_DROP);
+
+        for (size_t r = 0; r < rows; ++r) {
+            while (next == all[course]->categories.size()) {
+                course++;
+                next = 0;
+            }
+            const Course& c = *all[course];
+            const Category& cat = c.categories[next++];
+            weights[r] = cat.weight;
+            ids[r] = c.id;
+            names[r] = writer.nameIndex(cat.name);
+            drops[r] = static_cast<uint32_t>(cat.dropLowest);
+        }
+        writer.finishBatch(kind, rows);
+    }
+
+    course = 0;
+    next = 0;
+    auto assignmentCount = [](const Course& c) { return c.work.size(); };
+    for (fillRows(assignmentCount, rows); rows > 0;
+         fillRows(assignmentCount, rows)) {
+        const uint32_t kind = COLUMNAR_ASSIGNMENTS;
+        writer.startBatch(kind, rows);
+        double* earned = writer.column<double>(kind, rows, COL_ASSIGNMENT_EARNED);
+        double* max = writer.column<double>(kind, rows, COL_ASSIGNMENT_MAX);
+        double* percent =
+            writer.column<double>(kind, rows, COL_ASSIGNMENT_PERCENT);
+        int32_t* ids = writer.column<int32_t>(kind, rows, COL_ASSIGNMENT_COURSE);
+        uint32_t* names =
+            writer.column<uint32_t>(kind, rows, COL_ASSIGNMENT_NAME);
+        unsigned char* category =
+            writer.column<unsigned char>(kind, rows, COL_ASSIGNMENT_CATEGORY);
+        unsigned char* extra =
+            writer.column<unsigned char>(kind, rows, COL_ASSIGNMENT_EXTRA);
+
+        // Whole runs of a course's columns are copied at once.
+        size_t r = 0;
+        while (r < rows) {
+            const AssignmentColumns& work = all[course]->work;
+            size_t take = work.size() - next < rows - r ? work.size() - next
+                                                        : rows - r;
+            memcpy(earned + r, work.earned.data() + next, take * sizeof(double));
+            memcpy(max + r, work.max.data() + next, take * sizeof(double));
+            memcpy(category + r, work.category.data() + next, take);
+            memcpy(extra + r, work.extraCredit.data() + next, take);
+            for (size_t j = 0; j < take; ++j) {
+                percent[r + j] = earned[r + j] / max[r + j] * 100.0;
+                ids[r + j] = all[course]->id;
+                names[r + j] = writer.nameIndex(work.names[next + j]);
+            }
+            r += take;
+            next += take;
+            if (next == work.size()) {
+                course++;
+                next = 0;
+            }
+        }
+        writer.finishBatch(kind, rows);
+    }
+
+    writer.finish();
+    if (!writer.good()) {
+        error = "could not write " + tempPath;
+        remove(tempPath.c_str());
+        return false;
+    }
+    if (rename(tempPath.c_str(), path.c_str()) != 0) {
+        error = "could not replace " + path;
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+ColumnarView::ColumnarView() : nextId(MIN_COURSE_ID), names(0) {}
+
+bool ColumnarView::open(const string& path, bool verifyChecksum,
+                        string& error) {
+    batches.clear();
+    dictionaries.clear();
+    names = 0;
+    if (!file.open(path, error)) {
+        return false;
+    }
+
+    ColumnarHeader header;
+    if (file.size() < sizeof(header)) {
+        error = path + " is too small to be a columnar export";
+        return false;
+    }
+    memcpy(&header, file.data(), sizeof(header));
+    if (memcmp(header.magic, COLUMNAR_MAGIC, sizeof(header.magic)) != 0) {
+        error = path + " is not a columnar export";
+        return false;
+    }
+    if (header.version != COLUMNAR_VERSION) {
+        error = path + " has an unsupported columnar export version";
+        return false;
+    }
+    if (header.byteOrder != SNAPSHOT_BYTE_ORDER) {
+        error = path + " was written on a machine with another byte order";
+        return false;
+    }
+    nextId = header.nextCourseId;
+
+    const unsigned char* base = file.data();
+    uint64_t position = sizeof(header);
+    while (true) {
+        ColumnarBlockHeader block;
+        if (file.size() - position < sizeof(block)) {
+            error = path + " is damaged (ends inside a block)";
+            return false;
+        }
+        memcpy(&block, base + position, sizeof(block));
+        position += sizeof(block);
+
+        // Guard against absurd sizes before doing arithmetic with them.
+        if (block.bodyBytes > file.size() - position ||
+            block.rows > file.size() || block.bodyBytes % 8 != 0) {
+            error = path + " is damaged (bad block size)";
+            return false;
+        }
+        const unsigned char* body = base + position;
+        if (verifyChecksum &&
+            fnv1a(FNV_OFFSET_BASIS, body, static_cast<size_t>(block.bodyBytes))
+                != block.checksum) {
+            error = path + " is damaged (checksum mismatch)";
+            return false;
+        }
+        position += block.bodyBytes;
+
+        int columns = 0;
+        if (block.kind == COLUMNAR_END) {
+            if (position != file.size()) {
+                error = path + " is damaged (data after the end)";
+                return false;
+            }
+            return true;
+        } else if (block.kind == COLUMNAR_DICTIONARY) {
+            Dictionary d;
+            d.first = names;
+            d.count = static_cast<size_t>(block.rows);
+            d.offsets = reinterpret_cast<const uint64_t*>(body);
+            d.text = reinterpret_cast<const char*>(body) +
+                (d.count + 1) * sizeof(uint64_t);
+            uint64_t textRoom = block.bodyBytes - (d.count + 1) * sizeof(uint64_t);
+            bool valid = (d.count + 1) * sizeof(uint64_t) <= block.bodyBytes &&
+                         d.offsets[0] == 0 && d.offsets[d.count] <= textRoom;
+            for (size_t i = 0; valid && i < d.count; ++i) {
+                valid = d.offsets[i] <= d.offsets[i + 1];
+            }
+            if (!valid) {
+                error = path + " is damaged (bad dictionary)";
+                return false;
+            }
+            dictionaries.push_back(d);
+            names += d.count;
+        } else if (columnarWidths(block.kind, columns) != nullptr) {
+            if (block.bodyBytes != columnarOffset(block.kind, block.rows,
+                                                  columns)) {
+                error = path + " is damaged (wrong batch size)";
+                return false;
+            }
+            Batch b;
+            b.kind = static_cast<ColumnarKind>(block.kind);
+            b.rows = static_cast<size_t>(block.rows);
+            b.body = body;
+            batches.push_back(b);
+        } else {
+            error = path + " contains an unknown kind of block";
+            return false;
+        }
+    }
+}
+
+const unsigned char* ColumnarView::columnData(size_t b, int column) const {
+    return batches[b].body +
+        columnarOffset(batches[b].kind, batches[b].rows, column);
+}
+
+PooledName ColumnarView::name(uint32_t index) const {
+    // The dictionary blocks are few and in index order.
+    size_t d = dictionaries.size() - 1;
+    while (dictionaries[d].first > index) {
+        d--;
+    }
+    const Dictionary& dict = dictionaries[d];
+    size_t i = index - dict.first;
+    return PooledName(dict.text + dict.offsets[i],
+                      static_cast<size_t>(dict.offsets[i + 1] -
+                                          dict.offsets[i]));
+}
+
+// Replaces all courses with the contents of a columnar export file. On
+// failure the current courses are left untouched. The computed columns
+// (percentages and letters) are for readers only and are worked out again.
+bool importColumnar(const string& path, Gradebook& book, string& error) {
+    ColumnarView view;
+    if (!view.open(path, true, error)) {
+        return false;
+    }
+
+    // Courses in file order; the category and assignment rows name their
+    // course by id.
+    vector<Course> loaded;
+    vector<uint32_t> expectedCategories;
+    vector<uint32_t> expectedAssignments;
+    unordered_map<int, size_t> byId;
+    auto findCourse = [&](int id, size_t& at) {
+        unordered_map<int, size_t>::const_iterator found = byId.find(id);
+        if (found == byId.end()) {
+            error = path + " has a row for a course that is not in it";
+            return false;
+        }
+        at = found->second;
+        return true;
+    };
+    auto validName = [&](uint32_t index) {
+        if (index >= view.nameCount()) {
+            error = path + " is damaged (bad name index)";
+            return false;
+        }
+        return true;
+    };
+
+    for (size_t b = 0; b < view.batchCount(); ++b) {
+        size_t rows = view.batchRows(b);
+        if (view.batchKind(b) == COLUMNAR_COURSES) {
+            const double* credits = view.doubleColumn(b, COL_COURSE_CREDITS);
+            const int32_t* ids = view.intColumn(b, COL_COURSE_ID);
+            const uint32_t* names = view.uintColumn(b, COL_COURSE_NAME);
+            const uint32_t* categories =
+                view.uintColumn(b, COL_COURSE_CATEGORIES);
+            const uint32_t* assignments =
+                view.uintColumn(b, COL_COURSE_ASSIGNMENTS);
+            for (size_t r = 0; r < rows; ++r) {
+                if (!validName(names[r])) {
+                    return false;
+                }
+                if (!isValidCourseId(ids[r]) || categories[r] < 1 ||
+                    categories[r] > static_cast<uint32_t>(MAX_CATEGORIES) ||
+                    !byId.emplace(ids[r], loaded.size()).second) {
+                    error = path + " contains an invalid or repeated course";
+                    return false;
+                }
+                // The same limits as applyMutation, written as !(in range)
+                // so NaN is refused too.
+                if (!(credits[r] >= 0.5 && credits[r] <= 6.0)) {
+                    error = path + " contains a course with invalid credit hours";
+                    return false;
+                }
+                Course c;
+                c.id = ids[r];
+                c.name = view.name(names[r]);
+                c.creditHours = credits[r];
+                c.categories.clear();
+                loaded.push_back(c);
+                expectedCategories.push_back(categories[r]);
+                expectedAssignments.push_back(assignments[r]);
+            }
+        } else if (view.batchKind(b) == COLUMNAR_CATEGORIES) {
+            const double* weights = view.doubleColumn(b, COL_CATEGORY_WEIGHT);
+            const int32_t* ids = view.intColumn(b, COL_CATEGORY_COURSE);
+            const uint32_t* names = view.uintColumn(b, COL_CATEGORY_NAME);
+            const uint32_t* drops = view.uintColumn(b, COL_CATEGORY_DROP);
+            for (size_t r = 0; r < rows; ++r) {
+                size_t at = 0;
+                if (!findCourse(ids[r], at) || !validName(names[r])) {
+                    return false;
+                }
+                Category cat;
+                cat.name = view.name(names[r]).str();
+                cat.weight = weights[r];
+                cat.dropLowest = static_cast<int>(drops[r]);
+                if (!(cat.weight > 0.0 && cat.weight <= 100.0) ||
+                    drops[r] > static_cast<uint32_t>(MAX_DROP_LOWEST) ||
+                    loaded[at].categories.size() >= expectedCategories[at]) {
+                    error = path + " contains an invalid grading category";
+                    return false;
+                }
+                loaded[at].categories.push_back(cat);
+            }
+        } else if (view.batchKind(b) == COLUMNAR_ASSIGNMENTS) {
+            const double* earned = view.doubleColumn(b, COL_ASSIGNMENT_EARNED);
+            const double* max = view.doubleColumn(b, COL_ASSIGNMENT_MAX);
+            const int32_t* ids = view.intColumn(b, COL_ASSIGNMENT_COURSE);
+            const uint32_t* names = view.uintColumn(b, COL_ASSIGNMENT_NAME);
+            const unsigned char* category =
+                view.byteColumn(b, COL_ASSIGNMENT_CATEGORY);
+            const unsigned char* extra = view.byteColumn(b, COL_ASSIGNMENT_EXTRA);
+
+            // Rows of one course come in runs; each run is appended with
+            // one copy per column.
+            size_t r = 0;
+            while (r < rows) {
+                size_t end = r + 1;
+                while (end < rows && ids[end] == ids[r]) {
+                    end++;
+                }
+                size_t at = 0;
+                if (!findCourse(ids[r], at)) {
+                    return false;
+                }
+                AssignmentColumns& work = loaded[at].work;
+                if (work.size() + (end - r) > expectedAssignments[at]) {
+                    error = path + " has too many assignments for a course";
+                    return false;
+                }
+                for (size_t j = r; j < end; ++j) {
+                    if (!(max[j] >= 1.0 && max[j] <= 10000.0) ||
+                        !(earned[j] >= 0.0 && earned[j] <= max[j])) {
+                        error = path + " contains an invalid assignment score";
+                        return false;
+                    }
+                    if (category[j] >= expectedCategories[at] || extra[j] > 1) {
+                        error = path + " contains an invalid assignment category";
+                        return false;
+                    }
+                    if (!validName(names[j])) {
+                        return false;
+                    }
+                }
+                work.earned.insert(work.earned.end(), earned + r, earned + end);
+                work.max.insert(work.max.end(), max + r, max + end);
+                work.category.insert(work.category.end(), category + r,
+                                     category + end);
+                work.extraCredit.insert(work.extraCredit.end(), extra + r,
+                                        extra + end);
+                for (size_t j = r; j < end; ++j) {
+                    work.names.push_back(view.name(names[j]));
+                }
+                r = end;
+            }
+        }
+    }
+
+    CourseStore courses;
+    int savedNextId = view.nextCourseId();
+    if (!(savedNextId >= MIN_COURSE_ID && savedNextId <= MAX_COURSE_ID + 1)) {
+        error = path + " contains an invalid next course id";
+        return false;
+    }
+    for (size_t i = 0; i < loaded.size(); ++i) {
+        Course& c = loaded[i];
+        if (c.categories.size() != expectedCategories[i] ||
+            c.work.size() != expectedAssignments[i]) {
+            error = path + " is missing rows of a course";
+            return false;
+        }
+        recalculateCourseTotals(c);
+        if (hasStrandedExtraCredit(c)) {
+            error = path + " has extra credit in a category without scores";
+            return false;
+        }
+        if (courses.insert(c).generation == 0) {
+            error = path + " contains an invalid or repeated course id";
+            return false;
+        }
+        if (c.id >= savedNextId) {
+            savedNextId = c.id + 1; // never hand out an id that is in use
+        }
+    }
+
+    book.courses = courses;
+    book.grades.rebuild(book.courses);
+    book.nextCourseId = savedNextId;
+    return true;
+}
+
+// ============================================================================
+// WRITE-AHEAD JOURNAL
+// ============================================================================
+// With "--data file", every change is also appended to "file.journal"
+// before the menu moves on, so edits survive a crash without rewriting the
+// whole snapshot each time. On startup the snapshot is loaded and the
+// journal is replayed on top of it. Once the journal grows past
+// JOURNAL_CHECKPOINT_BYTES a new snapshot is written and the journal is
+// emptied ("checkpoint").
+//
+// File layout:
+//   header   "GPAJRNL\0", uint32 version, uint32 epoch
+//   records  uint32 payloadLength, uint32 checksum, payload
+//   payload  uint8 type, varint courseId, then by type:
+//              add course        double credits, string name
+//              add assignment    double earned, double max, string name,
+//                                varint category, uint8 extraCredit
+//              rename course     string name
+//              set credit hours  double credits
+//              edit assignment   varint index, double earned, double max,
+//                                string name, varint category,
+//                                uint8 extraCredit
+//              delete assignment varint index
+//              delete course     (nothing)
+//              add category      double weight, varint dropLowest,
+//                                string name
+//              edit category     varint index, double weight,
+//                                varint dropLowest, string name
+//              insert assignment same as edit assignment
+//              delete category   varint index
+//            Journals written before categories existed end assignment
+//            records after the name; those assignments are category 0.
+//   string   varint length, bytes
+// Varints use 7 bits per byte (low bits first). The checksum is the low 32
+// bits of FNV-1a over the payload.
+//
+// The epoch ties a journal to a snapshot: a checkpoint writes the snapshot
+// with epoch E+1 first and then restarts the journal with epoch E+1. If the
+// program dies in between, the old journal (epoch E) is recognized as
+// already included in the snapshot and is not replayed twice.
+
+const char JOURNAL_MAGIC[8] = { 'G', 'P', 'A', 'J', 'R', 'N', 'L', '\0' };
+const uint32_t JOURNAL_VERSION = 1;
+const size_t JOURNAL_HEADER_BYTES = 16;
+const uint64_t JOURNAL_CHECKPOINT_BYTES = 8 * 1024 * 1024;
+
+static void putVarint(vector<unsigned char>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<unsigned char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+static void putDouble(vector<unsigned char>& out, double value) {
+    unsigned char bytes[sizeof(double)];
+    memcpy(bytes, &value, sizeof(double));
+    out.insert(out.end(), bytes, bytes + sizeof(double));
+}
+
+static void putUint32(vector<unsigned char>& out, uint32_t value) {
+    unsigned char bytes[sizeof(uint32_t)];
+    memcpy(bytes, &value, sizeof(uint32_t));
+    out.insert(out.end(), bytes, bytes + sizeof(uint32_t));
+}
+
+// Reads values back out of an encoded payload, refusing to run past "end".
+struct JournalReader {
+    const unsigned char* pos;
+    const unsigned char* end;
+
+    bool varint(uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos == end) {
+                return false;
+            }
+            unsigned char byte = *pos++;
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool number(double& value) {
+        if (static_cast<size_t>(end - pos) < sizeof(double)) {
+            return false;
+        }
+        memcpy(&value, pos, sizeof(double));
+        pos += sizeof(double);
+        return true;
+    }
+
+    bool text(string& value) {
+        uint64_t length;
+        if (!varint(length) || length > static_cast<uint64_t>(end - pos)) {
+            return false;
+        }
+        value.assign(reinterpret_cast<const char*>(pos),
+                     static_cast<size_t>(length));
+        pos += length;
+        return true;
+    }
+};
+
+// Appends the payload for one Mutation (see the layout above).
+void encodeMutation(const Mutation& m, vector<unsigned char>& out) {
+    out.push_back(static_cast<unsigned char>(m.type));
+    putVarint(out, static_cast<uint64_t>(m.courseId));
+
+    switch (m.type) {
+        case MUTATION_ADD_COURSE:
+            putDouble(out, m.creditHours);
+            putVarint(out, m.name.size());
+            out.insert(out.end(), m.name.begin(), m.name.end());
+            break;
+        case MUTATION_ADD_ASSIGNMENT:
+            putDouble(out, m.earned);
+            putDouble(out, m.max);
+            putVarint(out, m.name.size());
+            out.insert(out.end(), m.name.begin(), m.name.end());
+            putVarint(out, m.category);
+            out.push_back(m.extraCredit ? 1 : 0);
+            break;
+        case MUTATION_RENAME_COURSE:
+            putVarint(out, m.name.size());
+            out.insert(out.end(), m.name.begin(), m.name.end());
+            break;
+        case MUTATION_SET_CREDIT_HOURS:
+            putDouble(out, m.creditHours);
+            break;
+        case MUTATION_EDIT_ASSIGNMENT:
+        case MUTATION_INSERT_ASSIGNMENT:
+            putVarint(out, m.index);
+            putDouble(out, m.earned);
+            putDouble(out, m.max);
+            putVarint(out, m.name.size());
+            out.insert(out.end(), m.name.begin(), m.name.end());
+            putVarint(out, m.category);
+            out.push_back(m.extraCredit ? 1 : 0);
+            break;
+        case MUTATION_DELETE_ASSIGNMENT:
+        case MUTATION_DELETE_CATEGORY:
+            putVarint(out, m.index);
+            break;
+        case MUTATION_DELETE_COURSE:
+            break;
+        case MUTATION_EDIT_CATEGORY:
+            putVarint(out, m.index);
+            putDouble(out, m.weight);
+            putVarint(out, m.dropLowest);
+            putVarint(out, m.name.size());
+            out.insert(out.end(), m.name.begin(), m.name.end());
+            break;
+        case MUTATION_ADD_CATEGORY:
+            putDouble(out, m.weight);
+            putVarint(out, m.dropLowest);
+            putVarint(out, m.name.size());
+            out.insert(out.end(), m.name.begin(), m.name.end());
+            break;
+    }
+}
+
+// Turns a payload back into a Mutation. Returns false if it is malformed.
+bool decodeMutation(const unsigned char* data, size_t size, Mutation& m) {
+    JournalReader in;
+    in.pos = data;
+    in.end = data + size;
+
+    if (in.pos == in.end) {
+        return false;
+    }
+    unsigned char type = *in.pos++;
+    if (type < MUTATION_ADD_COURSE || type > MUTATION_DELETE_CATEGORY) {
+        return false;
+    }
+
+    uint64_t courseId;
+    if (!in.varint(courseId) || courseId > static_cast<uint64_t>(MAX_COURSE_ID)) {
+        return false;
+    }
+
+    m = makeAddCourse(static_cast<int>(courseId), "", 0.0);
+    m.type = static_cast<MutationType>(type);
+
+    uint64_t index = 0;
+    uint64_t category = 0;
+    uint64_t dropLowest = 0;
+    bool ok = true;
+    switch (m.type) {
+        case MUTATION_ADD_COURSE:
+            ok = in.number(m.creditHours) && in.text(m.name);
+            break;
+        case MUTATION_ADD_ASSIGNMENT:
+            ok = in.number(m.earned) && in.number(m.max) && in.text(m.name);
+            break;
+        case MUTATION_RENAME_COURSE:
+            ok = in.text(m.name);
+            break;
+        case MUTATION_SET_CREDIT_HOURS:
+            ok = in.number(m.creditHours);
+            break;
+        case MUTATION_EDIT_ASSIGNMENT:
+        case MUTATION_INSERT_ASSIGNMENT:
+            ok = in.varint(index) && in.number(m.earned) &&
+                 in.number(m.max) && in.text(m.name);
+            break;
+        case MUTATION_DELETE_ASSIGNMENT:
+        case MUTATION_DELETE_CATEGORY:
+            ok = in.varint(index);
+            break;
+        case MUTATION_DELETE_COURSE:
+            break;
+        case MUTATION_EDIT_CATEGORY:
+            ok = in.varint(index) && in.number(m.weight) &&
+                 in.varint(dropLowest) && in.text(m.name);
+            break;
+        case MUTATION_ADD_CATEGORY:
+            ok = in.number(m.weight) && in.varint(dropLowest) &&
+                 in.text(m.name);
+            break;
+    }
+
+    // Category and extra-credit flag of an assignment (missing in
+    // journals from before categories).
+    bool isAssignment = m.type == MUTATION_ADD_ASSIGNMENT ||
+                        m.type == MUTATION_EDIT_ASSIGNMENT ||
+                        m.type == MUTATION_INSERT_ASSIGNMENT;
+    if (ok && isAssignment && in.pos != in.end) {
+        ok = in.varint(category) && in.pos != in.end;
+        if (ok) {
+            m.extraCredit = *in.pos++ != 0;
+        }
+    }
+
+    if (!ok || index > 0xFFFFFFFFu || category > 0xFFFFFFFFu ||
+        dropLowest > 0xFFFFFFFFu || in.pos != in.end) {
+        return false;
+    }
+    m.index = static_cast<uint32_t>(index);
+    m.category = static_cast<uint32_t>(category);
+    m.dropLowest = static_cast<uint32_t>(dropLowest);
+    return true;
+}
+
+Journal::Journal()
+    : file(nullptr), fileBytes(0), pendingCount(0), appendedCount(0),
+      maxBatchRecords(64), maxDelayMs(10) {}
+
+Journal::~Journal() {
+    close();
+}
+
+void Journal::setGroupCommit(size_t maxRecords, int delayMs) {
+    maxBatchRecords = maxRecords == 0 ? 1 : maxRecords;
+    maxDelayMs = delayMs;
+}
+
+bool Journal::writeHeader(uint32_t epoch) {
+    vector<unsigned char> header(JOURNAL_MAGIC, JOURNAL_MAGIC + 8);
+    putUint32(header, JOURNAL_VERSION);
+    putUint32(header, epoch);
+
+    if (fwrite(header.data(), 1, header.size(), file) != header.size() ||
+        fflush(file) != 0) {
+        return false;
+    }
+#if defined(GPA_HAVE_MMAP)
+    fsync(fileno(file));
+#endif
+    fileBytes = header.size();
+    return true;
+}
+
+bool Journal::open(const string& journalPath, uint32_t epoch, string& error) {
+    close();
+    path = journalPath;
+
+    // Keep the existing file only if it belongs to this snapshot.
+    bool keep = false;
+    ifstream probe(path.c_str(), ios::binary);
+    if (probe) {
+        char header[JOURNAL_HEADER_BYTES];
+        if (probe.read(header, sizeof(header))) {
+            uint32_t version;
+            uint32_t fileEpoch;
+            memcpy(&version, header + 8, sizeof(version));
+            memcpy(&fileEpoch, header + 12, sizeof(fileEpoch));
+            keep = memcmp(header, JOURNAL_MAGIC, 8) == 0 &&
+                   version == JOURNAL_VERSION && fileEpoch == epoch;
+        }
+        probe.seekg(0, ios::end);
+        fileBytes = static_cast<uint64_t>(probe.tellg());
+    }
+    probe.close();
+
+    file = fopen(path.c_str(), keep ? "ab" : "wb");
+    if (file == nullptr) {
+        error = "could not open " + path;
+        return false;
+    }
+    if (!keep && !writeHeader(epoch)) {
+        error = "could not write " + path;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void Journal::close() {
+    if (file != nullptr) {
+        commit();
+        fclose(file);
+        file = nullptr;
+    }
+    discardPending();
+}
+
+bool Journal::append(const Mutation& m) {
+    if (file == nullptr) {
+        return false;
+    }
+
+    if (pendingCount == 0) {
+        oldestPending = chrono::steady_clock::now();
+    }
+
+    // Reserve room for the length and checksum, then fill them in.
+    size_t start = pending.size();
+    pending.resize(start + 2 * sizeof(uint32_t));
+    encodeMutation(m, pending);
+
+    size_t payloadSize = pending.size() - start - 2 * sizeof(uint32_t);
+    const unsigned char* payload = &pending[start + 2 * sizeof(uint32_t)];
+    uint32_t length = static_cast<uint32_t>(payloadSize);
+    uint32_t checksum = static_cast<uint32_t>(
+        fnv1a(FNV_OFFSET_BASIS, payload, payloadSize));
+    memcpy(&pending[start], &length, sizeof(length));
+    memcpy(&pending[start + sizeof(uint32_t)], &checksum, sizeof(checksum));
+
+    pendingCount++;
+    appendedCount++;
+    if (pendingCount >= maxBatchRecords) {
+        return commit();
+    }
+    return true;
+}
+
+bool Journal::commit() {
+    if (pendingCount == 0) {
+        return true;
+    }
+    if (file == nullptr) {
+        return false;  // an earlier failure could not reopen the file
+    }
+
+    bool ok = fwrite(pending.data(), 1, pending.size(), file) == pending.size() &&
+              fflush(file) == 0;
+#if defined(GPA_HAVE_MMAP)
+    ok = ok && fsync(fileno(file)) == 0;
+#endif
+
+    if (!ok) {
+        // Keep the batch queued and cut off whatever part of it reached the
+        // file, so a later commit does not leave a half-written record in
+        // front of it (replay stops at the first damaged record).
+        fclose(file);
+#if defined(GPA_HAVE_MMAP)
+        if (truncate(path.c_str(), static_cast<off_t>(fileBytes)) != 0) {
+            cerr << "Warning: could not repair " << path << ".\n";
+        }
+#endif
+        file = fopen(path.c_str(), "ab");
+        return false;
+    }
+
+    fileBytes += pending.size();
+    pending.clear();
+    pendingCount = 0;
+    return true;
+}
+
+bool Journal::commitIfDue() {
+    if (pendingCount == 0) {
+        return true;
+    }
+    chrono::steady_clock::duration waited =
+        chrono::steady_clock::now() - oldestPending;
+    if (waited >= chrono::milliseconds(maxDelayMs)) {
+        return commit();
+    }
+    return true;
+}
+
+void Journal::discardPending() {
+    appendedCount -= pendingCount;
+    pending.clear();
+    pendingCount = 0;
+}
+
+bool Journal::reset(uint32_t epoch, string& error) {
+    if (file != nullptr) {
+        fclose(file);
+        file = nullptr;
+    }
+    pending.clear();
+    pendingCount = 0;
+
+    file = fopen(path.c_str(), "wb");
+    if (file == nullptr || !writeHeader(epoch)) {
+        error = "could not restart " + path;
+        return false;
+    }
+    return true;
+}
+
+// Applies the records of a journal file to "book". Stops at the first
+// damaged or half-written record (the tail of a crash) and cuts the file
+// back to the last good record. Returns the number of records applied, or
+// -1 if the file could not be read. A journal from an older epoch is
+// ignored because the snapshot already contains it.
+long long replayJournal(const string& path, Gradebook& book, string& error) {
+    ifstream probe(path.c_str(), ios::binary);
+    if (!probe) {
+        return 0; // no journal yet
+    }
+    probe.close();
+
+    MappedFile file;
+    if (!file.open(path, error)) {
+        return -1;
+    }
+
+    const unsigned char* data = file.data();
+    size_t size = file.size();
+    if (size < JOURNAL_HEADER_BYTES || memcmp(data, JOURNAL_MAGIC, 8) != 0) {
+        return 0; // nothing usable; Journal::open starts it over
+    }
+
+    uint32_t version;
+    uint32_t epoch;
+    memcpy(&version, data + 8, sizeof(version));
+    memcpy(&epoch, data + 12, sizeof(epoch));
+    if (version != JOURNAL_VERSION || epoch != book.checkpointEpoch) {
+        return 0;
+    }
+
+    Journal* attached = book.journal;
+    book.journal = nullptr; // do not log the replay itself
+
+    long long applied = 0;
+    size_t pos = JOURNAL_HEADER_BYTES;
+    Mutation m;
+    string applyError;
+
+    while (size - pos >= 2 * sizeof(uint32_t)) {
+        uint32_t length;
+        uint32_t checksum;
+        memcpy(&length, data + pos, sizeof(length));
+        memcpy(&checksum, data + pos + sizeof(uint32_t), sizeof(checksum));
+
+        size_t payloadStart = pos + 2 * sizeof(uint32_t);
+        if (length > size - payloadStart) {
+            break; // half-written record
+        }
+        const unsigned char* payload = data + payloadStart;
+        if (static_cast<uint32_t>(fnv1a(FNV_OFFSET_BASIS, payload, length)) !=
+                checksum ||
+            !decodeMutation(payload, length, m)) {
+            break; // damaged record
+        }
+
+        if (applyMutation(book, m, applyError)) {
+            applied++;
+        } else {
+            cerr << "Journal record skipped: " << applyError << "\n";
+        }
+        pos = payloadStart + length;
+    }
+
+    book.journal = attached;
+
+    if (pos != size) {
+        cerr << "Journal " << path << " had a damaged tail; "
+             << (size - pos) << " byte(s) dropped.\n";
+        file.close();
+#if defined(GPA_HAVE_MMAP)
+        if (truncate(path.c_str(), static_cast<off_t>(pos)) != 0) {
+            error = "could not repair " + path;
+            return -1;
+        }
+#endif
+    }
+    return applied;
+}
+
+// Writes a fresh snapshot and empties the journal, so the next startup
+// only replays what changed after this point.
+bool checkpointGradebook(Gradebook& book, string& error) {
+    if (book.dataPath.empty()) {
+        return true;
+    }
+
+    // If the journal cannot be written the snapshot still holds every
+    // change, so it is written anyway; the journal is only emptied once the
+    // snapshot is safely on disk.
+    bool committed = book.journal == nullptr || book.journal->commit();
+
+    uint32_t previousEpoch = book.checkpointEpoch;
+    book.checkpointEpoch = previousEpoch + 1;
+    if (!saveSnapshot(book.dataPath, book, error)) {
+        book.checkpointEpoch = previousEpoch;
+        if (!committed) {
+            error = "could not write the journal, and " + error;
+        }
+        return false;
+    }
+
+    if (book.journal != nullptr) {
+        return book.journal->reset(book.checkpointEpoch, error);
+    }
+    return true;
+}
+
+// Called by the menus after each operation: makes the change durable and
+// checkpoints once the journal has grown large. Returns false if the
+// journal could not be written, i.e. the latest changes are NOT on disk.
+bool syncGradebook(Gradebook& book) {
+    if (book.journal == nullptr) {
+        return true;
+    }
+
+    if (!book.journal->commit()) {
+        cerr << "Warning: could not write to the journal.\n";
+        return false;
+    }
+
+    if (book.journal->sizeBytes() > JOURNAL_CHECKPOINT_BYTES) {
+        string error;
+        if (!checkpointGradebook(book, error)) {
+            cerr << "Warning: checkpoint failed: " << error << "\n";
+        }
+    }
+    return true;
+}
+
+// Loads "--data" snapshot and journal, and attaches "journal" to the book.
+bool openGradebook(const string& dataPath, Gradebook& book, Journal& journal,
+                   string& error) {
+    book.dataPath = dataPath;
+
+    ifstream probe(dataPath.c_str());
+    if (probe) {
+        probe.close();
+        if (!loadSnapshot(dataPath, book, error)) {
+            return false;
+        }
+    }
+
+    string journalPath = dataPath + ".journal";
+    long long replayed = replayJournal(journalPath, book, error);
+    if (replayed < 0) {
+        return false;
+    }
+    if (replayed > 0) {
+        cerr << "Recovered " << replayed << " change(s) from " << journalPath
+             << ".\n";
+    }
+
+    if (!journal.open(journalPath, book.checkpointEpoch, error)) {
+        return false;
+    }
+    book.journal = &journal;
+    return true;
+}
+
+// ============================================================================
+// SCRIPT MODE
+// ============================================================================
+// "--script [file] [--data path]" reads one command per line (from the
+// file, or from stdin) and answers every command with exactly one line, so
+// another program can pipe thousands of operations through one process.
+//
+// Commands (course ids, assignment and category numbers as in the menus;
+// numbers start at 1):
+//     ADD_COURSE name credits                     -> OK id
+//     ADD_ASSIGN id name earned max [cat] [EXTRA] -> OK number
+//     EDIT id number earned max [name]            -> OK
+//     DEL id [number]                             -> OK   (course or assignment)
+//     RENAME id name                              -> OK
+//     CREDITS id hours                            -> OK
+//     ADD_CATEGORY id name weight [drop]          -> OK number
+//     EDIT_CATEGORY id number name weight drop    -> OK
+//     COURSE id                                   -> OK id name credits count
+//                                                       percent letter
+//     FIND name                                   -> OK count id ...
+//     GPA                                         -> OK gpa gradedCredits
+//     DIST                                        -> OK graded grade count ...
+//                                                       (one pair per grade)
+//     GRADE letter                                -> OK count id ...
+//     BELOW letter                                -> OK count id ...
+//                                                       (grades worse than it;
+//                                                       see "GRADE INDEX")
+//     WHATIF id earned max [cat]                  -> OK percent letter gpa
+//     FORECAST id pending [cat] [runs]            -> OK percent gpa p5 p50 p95
+//                                                       grade chance ...
+//                                                       (see "GRADE FORECAST")
+//     UNDO [steps] / REDO [steps]                 -> OK count  (see "UNDO / REDO")
+//     METRICS                                     -> OK {json}  (see "METRICS")
+//     EXPORT path                                 -> OK courses
+//                                                       (see "COLUMNAR EXPORT")
+//     SYNC                                        -> OK   (journal is on disk)
+//     QUIT                                        -> OK   (stops reading)
+// Failures answer "ERR message" and change nothing. Tokens are separated by
+// spaces or tabs; a token with spaces goes in double quotes ("" stands for
+// one quote inside them). Empty lines and lines starting with # get no
+// answer. Command names are not case sensitive.
+//
+// Lines are split in place (no copies, no allocations) and answers are
+// collected in one ReportBuffer. With "--data", changes go through
+// applyMutation and the journal's group commit: the journal is committed
+// just before the answers are written, so many commands share one fsync
+// and an "OK" is never seen before its change is on disk.
+
+const int SCRIPT_MAX_TOKENS = 8;
+const size_t SCRIPT_FLUSH_BYTES = 64 * 1024;
+
+// Splits "line" into tokens in place: separators after tokens are replaced
+// by '\0' and quoted tokens are unquoted where they stand. "tokens" then
+// points into the line. Returns the number of tokens, or -1 with "error"
+// set if the line cannot be split.
+static int splitScriptLine(string& line, char* tokens[], const char*& error) {
+    size_t end = line.size();
+    if (end > 0 && line[end - 1] == '\r') {
+        line[--end] = '\0';  // ignore a Windows line ending
+    }
+
+    char* text = &line[0];
+    size_t pos = 0;
+    int count = 0;
+    while (true) {
+        while (pos < end && (text[pos] == ' ' || text[pos] == '\t')) {
+            pos++;
+        }
+        if (pos >= end || (count == 0 && text[pos] == '#')) {
+            break;
+        }
+        if (count == SCRIPT_MAX_TOKENS) {
+            error = "too many arguments";
+            return -1;
+        }
+
+        if (text[pos] != '"') {
+            tokens[count++] = text + pos;
+            while (pos < end && text[pos] != ' ' && text[pos] != '\t') {
+                pos++;
+            }
+            if (pos < end) {
+                text[pos++] = '\0';
+            }
+            continue;
+        }
+
+        // Quoted token: copy it one place to the left over its own quotes.
+        size_t start = ++pos;
+        size_t written = start;
+        bool closed = false;
+        while (pos < end) {
+            if (text[pos] == '"') {
+                if (pos + 1 < end && text[pos + 1] == '"') {
+                    text[written++] = '"';
+                    pos += 2;
+                } else {
+                    pos++;
+                    closed = true;
+                    break;
+                }
+            } else {
+                text[written++] = text[pos++];
+            }
+        }
+        if (!closed ||
+            (pos < end && text[pos] != ' ' && text[pos] != '\t')) {
+            error = "unbalanced quotes";
+            return -1;
+        }
+        text[written] = '\0';  // written < pos, so this stays inside the line
+        tokens[count++] = text + start;
+    }
+
+    return count;
+}
+
+// True if "token" is the command "name", ignoring upper/lower case.
+static bool isScriptCommand(const char* token, const char* name) {
+    while (*token != '\0' && *name != '\0') {
+        if (toupper(static_cast<unsigned char>(*token)) != *name) {
+            return false;
+        }
+        ++token;
+        ++name;
+    }
+    return *token == '\0' && *name == '\0';
+}
+
+// Parses a whole token as a number / whole number.
+static bool parseScriptNumber(const char* token, double& value) {
+    char* endPtr = nullptr;
+    value = strtod(token, &endPtr);
+    return endPtr != token && *endPtr == '\0';
+}
+
+static bool parseScriptInt(const char* token, int& value) {
+    char* endPtr = nullptr;
+    long parsed = strtol(token, &endPtr, 10);
+    if (endPtr == token || *endPtr != '\0' || parsed < INT_MIN ||
+        parsed > INT_MAX) {
+        return false;
+    }
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+// Adds a name to an answer, quoted when it would not read back as one token.
+static void appendScriptName(ReportBuffer& out, const PooledName& name) {
+    const char* text = name.c_str();
+    size_t length = name.size();
+    bool plain = length > 0 && text[0] != '#';
+    for (size_t i = 0; plain && i < length; ++i) {
+        plain = text[i] != ' ' && text[i] != '\t' && text[i] != '"';
+    }
+    if (plain) {
+        out.append(name);
+        return;
+    }
+
+    out.append('"');
+    for (size_t i = 0; i < length; ++i) {
+        if (text[i] == '"') {
+            out.append('"');
+        }
+        out.append(text[i]);
+    }
+    out.append('"');
+}
+
+// Runs one command. Writes its answer line (without "OK"/"ERR") to "out"
+// and returns false with "error" set if it failed. "stop" is set by QUIT.
+static bool runScriptCommand(Gradebook& book, char* tokens[], int count,
+                             ReportBuffer& out, string& error, bool& stop) {
+    const char* command = tokens[0];
+    CourseStore& courses = book.courses;
+
+    // Most commands start with the id of an existing course.
+    int id = 0;
+    const Course* course = nullptr;
+    static const char* const COURSE_COMMANDS[] = {
+        "ADD_ASSIGN", "EDIT", "DEL", "RENAME", "CREDITS", "ADD_CATEGORY",
+        "EDIT_CATEGORY", "COURSE", "WHATIF", "FORECAST"
+    };
+    bool takesCourse = false;
+    for (const char* name : COURSE_COMMANDS) {
+        takesCourse = takesCourse || isScriptCommand(command, name);
+    }
+    if (takesCourse) {
+        if (count < 2 || !parseScriptInt(tokens[1], id)) {
+            error = "expected a course id";
+            return false;
+        }
+        course = courses.get(courses.handleOf(id));
+        if (course == nullptr) {
+            error = "no course found with that id";
+            return false;
+        }
+    }
+
+    if (isScriptCommand(command, "ADD_COURSE")) {
+        double credits = 0.0;
+        if (count != 3 || !parseScriptNumber(tokens[2], credits)) {
+            error = "usage: ADD_COURSE name credits";
+            return false;
+        }
+        if (!isValidCourseId(book.nextCourseId)) {
+            error = "no course ids left";
+            return false;
+        }
+        int newId = book.nextCourseId;
+        if (!applyMutation(book, makeAddCourse(newId, tokens[1], credits),
+                           error)) {
+            return false;
+        }
+        out.appendInt(newId);
+    } else if (isScriptCommand(command, "ADD_ASSIGN")) {
+        Assignment a;
+        int category = 1;
+        if (count < 5 || count > 7 || !parseScriptNumber(tokens[3], a.earned) ||
+            !parseScriptNumber(tokens[4], a.max) ||
+            (count >= 6 && !parseScriptInt(tokens[5], category)) ||
+            (count == 7 && !isScriptCommand(tokens[6], "EXTRA"))) {
+            error = "usage: ADD_ASSIGN id name earned max [category] [EXTRA]";
+            return false;
+        }
+        if (category < 1) {
+            error = "no category with that number";
+            return false;
+        }
+        a.name = tokens[2];
+        a.category = category - 1;
+        a.extraCredit = count == 7;
+        if (!applyMutation(book, makeAddAssignment(id, a), error)) {
+            return false;
+        }
+        out.appendInt(static_cast<long long>(course->work.size()));
+    } else if (isScriptCommand(command, "EDIT")) {
+        int number = 0;
+        double earned = 0.0;
+        double max = 0.0;
+        if ((count != 5 && count != 6) || !parseScriptInt(tokens[2], number) ||
+            !parseScriptNumber(tokens[3], earned) ||
+            !parseScriptNumber(tokens[4], max)) {
+            error = "usage: EDIT id number earned max [name]";
+            return false;
+        }
+        if (number < 1 || static_cast<size_t>(number) > course->work.size()) {
+            error = "no assignment with that number";
+            return false;
+        }
+        Assignment a = course->work[number - 1];
+        a.earned = earned;
+        a.max = max;
+        if (count == 6) {
+            a.name = tokens[5];
+        }
+        if (!applyMutation(book, makeEditAssignment(id, number - 1, a),
+                           error)) {
+            return false;
+        }
+    } else if (isScriptCommand(command, "DEL")) {
+        int number = 0;
+        if (count == 2) {
+            return applyMutation(book, makeDeleteCourse(id), error);
+        }
+        if (count != 3 || !parseScriptInt(tokens[2], number) || number < 1) {
+            error = "usage: DEL id [number]";
+            return false;
+        }
+        return applyMutation(book, makeDeleteAssignment(id, number - 1), error);
+    } else if (isScriptCommand(command, "RENAME")) {
+        if (count != 3) {
+            error = "usage: RENAME id name";
+            return false;
+        }
+        return applyMutation(book, makeRenameCourse(id, tokens[2]), error);
+    } else if (isScriptCommand(command, "CREDITS")) {
+        double hours = 0.0;
+        if (count != 3 || !parseScriptNumber(tokens[2], hours)) {
+            error = "usage: CREDITS id hours";
+            return false;
+        }
+        return applyMutation(book, makeSetCreditHours(id, hours), error);
+    } else if (isScriptCommand(command, "ADD_CATEGORY")) {
+        double weight = 0.0;
+        int drop = 0;
+        if ((count != 4 && count != 5) || !parseScriptNumber(tokens[3], weight) ||
+            (count == 5 && (!parseScriptInt(tokens[4], drop) || drop < 0))) {
+            error = "usage: ADD_CATEGORY id name weight [drop]";
+            return false;
+        }
+        if (!applyMutation(book, makeAddCategory(id, tokens[2], weight, drop),
+                           error)) {
+            return false;
+        }
+        out.appendInt(static_cast<long long>(course->categories.size()));
+    } else if (isScriptCommand(command, "EDIT_CATEGORY")) {
+        int number = 0;
+        double weight = 0.0;
+        int drop = 0;
+        if (count != 6 || !parseScriptInt(tokens[2], number) ||
+            !parseScriptNumber(tokens[4], weight) ||
+            !parseScriptInt(tokens[5], drop) || drop < 0 || number < 1) {
+            error = "usage: EDIT_CATEGORY id number name weight drop";
+            return false;
+        }
+        return applyMutation(book, makeEditCategory(id, number - 1, tokens[3],
+                                                    weight, drop), error);
+    } else if (isScriptCommand(command, "COURSE")) {
+        if (count != 2) {
+            error = "usage: COURSE id";
+            return false;
+        }
+        out.appendInt(course->id);
+        out.append(' ');
+        appendScriptName(out, course->name);
+        out.append(' ');
+        out.appendShort(course->creditHours);
+        out.append(' ');
+        out.appendInt(static_cast<long long>(course->work.size()));
+        if (course->work.empty()) {
+            out.append(" - -");
+        } else {
+            double percent = calculateCoursePercentage(*course);
+            out.append(' ');
+            out.appendFixed(percent, 4);
+            out.append(' ');
+            out.append(percentageToLetter(percent));
+        }
+    } else if (isScriptCommand(command, "FIND")) {
+        static vector<int> ids;
+        if (count != 2) {
+            error = "usage: FIND name";
+            return false;
+        }
+        findCoursesByName(courses, tokens[1], ids);
+        out.appendInt(static_cast<long long>(ids.size()));
+        for (int found : ids) {
+            out.append(' ');
+            out.appendInt(found);
+        }
+    } else if (isScriptCommand(command, "GPA")) {
+        if (count != 1) {
+            error = "usage: GPA";
+            return false;
+        }
+        GpaTotals totals = calculateGpaTotals(courses);
+        out.appendFixed(gpaFromTotals(totals), 4);
+        out.append(' ');
+        out.appendShort(totals.credits);
+    } else if (isScriptCommand(command, "DIST")) {
+        if (count != 1) {
+            error = "usage: DIST";
+            return false;
+        }
+        GradeCounts counts = book.grades.counts();
+        const GradingScale& scale = gradingScale();
+        out.appendInt(counts.total);
+        for (int i = 0; i < scale.bandCount; ++i) {
+            out.append(' ');
+            out.append(gradeName(scale.bands[i].grade));
+            out.append(' ');
+            out.appendInt(counts.counts[scale.bands[i].grade]);
+        }
+    } else if (isScriptCommand(command, "GRADE") ||
+               isScriptCommand(command, "BELOW")) {
+        static vector<int> ids;
+        bool worse = isScriptCommand(command, "BELOW");
+        Grade grade = GRADE_F;
+        if (count != 2) {
+            error = worse ? "usage: BELOW letter" : "usage: GRADE letter";
+            return false;
+        }
+        if (!gradeFromName(tokens[1], grade) ||
+            !coursesWithGrade(book, grade, worse, ids)) {
+            error = "the grading scale has no such grade";
+            return false;
+        }
+        out.appendInt(static_cast<long long>(ids.size()));
+        for (int found : ids) {
+            out.append(' ');
+            out.appendInt(found);
+        }
+    } else if (isScriptCommand(command, "WHATIF")) {
+        double earned = 0.0;
+        double max = 0.0;
+        int category = 1;
+        if (count < 4 || count > 5 || !parseScriptNumber(tokens[2], earned) ||
+            !parseScriptNumber(tokens[3], max) ||
+            (count == 5 && !parseScriptInt(tokens[4], category))) {
+            error = "usage: WHATIF id earned max [category]";
+            return false;
+        }
+        if (!(max >= 1.0 && max <= 10000.0) ||
+            !(earned >= 0.0 && earned <= max)) {
+            error = "earned points must be between 0 and max (max 1 to 10000)";
+            return false;
+        }
+
+        CourseHandle handle = courses.handleOf(id);
+        WhatIfOverlay overlay(courses);
+        if (!overlay.addHypothetical(handle, category - 1, earned, max)) {
+            error = "no category with that number";
+            return false;
+        }
+        double percent = overlay.coursePercentage(handle);
+        out.appendFixed(percent, 4);
+        out.append(' ');
+        out.append(percentageToLetter(percent));
+        out.append(' ');
+        out.appendFixed(overlay.overallGPA(), 4);
+    } else if (isScriptCommand(command, "FORECAST")) {
+        int pendingCount = 0;
+        int category = 1;
+        int runs = static_cast<int>(FORECAST_DEFAULT_RUNS);
+        if (count < 3 || count > 5 ||
+            !parseScriptInt(tokens[2], pendingCount) ||
+            (count >= 4 && !parseScriptInt(tokens[3], category)) ||
+            (count == 5 && !parseScriptInt(tokens[4], runs))) {
+            error = "usage: FORECAST id pending [category] [runs]";
+            return false;
+        }
+        if (pendingCount < 1 || pendingCount > 1000 || runs < 1 ||
+            static_cast<size_t>(runs) > FORECAST_MAX_RUNS) {
+            error = "pending must be 1 to 1000 and runs 1 to 100000000";
+            return false;
+        }
+        if (category < 1 ||
+            category > static_cast<int>(course->categories.size())) {
+            error = "no category with that number";
+            return false;
+        }
+
+        PendingWork work;
+        work.course = courses.handleOf(id);
+        work.category = category - 1;
+        int samples = 0;
+        fitPendingScores(courses, work.course, work.category, work.mean,
+                         work.spread, samples);
+        vector<PendingWork> pending(static_cast<size_t>(pendingCount), work);
+
+        ForecastResult result;
+        forecastGrades(courses, pending, static_cast<size_t>(runs),
+                       defaultThreadCount(), FORECAST_SEED, result);
+        out.appendFixed(result.meanPercent[0], 4);
+        out.append(' ');
+        out.appendFixed(result.meanGpa, 4);
+        const double fractions[] = { 0.05, 0.5, 0.95 };
+        for (double fraction : fractions) {
+            out.append(' ');
+            out.appendFixed(forecastGpaPercentile(result, fraction), 2);
+        }
+        const GradingScale& scale = gradingScale();
+        for (int i = 0; i < scale.bandCount; ++i) {
+            out.append(' ');
+            out.append(gradeName(scale.bands[i].grade));
+            out.append(' ');
+            out.appendFixed(static_cast<double>(
+                result.gradeCounts[scale.bands[i].grade]) / runs, 4);
+        }
+    } else if (isScriptCommand(command, "UNDO") ||
+               isScriptCommand(command, "REDO")) {
+        bool undo = isScriptCommand(command, "UNDO");
+        int steps = 1;
+        if (count > 2 || (count == 2 && (!parseScriptInt(tokens[1], steps) ||
+                                         steps < 1))) {
+            error = undo ? "usage: UNDO [steps]" : "usage: REDO [steps]";
+            return false;
+        }
+        string description;
+        int doneSteps = 0;
+        while (doneSteps < steps &&
+               (undo ? undoLastChange(book, description, error)
+                     : redoLastChange(book, description, error))) {
+            doneSteps++;
+        }
+        if (doneSteps == 0) {
+            return false;
+        }
+        out.appendInt(doneSteps);
+    } else if (isScriptCommand(command, "METRICS")) {
+        string json;
+        appendMetricsJson(json);
+        out.append(json);
+    } else if (isScriptCommand(command, "EXPORT")) {
+        if (count != 2) {
+            error = "usage: EXPORT path";
+            return false;
+        }
+        if (!exportColumnar(tokens[1], book, error)) {
+            return false;
+        }
+        out.appendInt(static_cast<long long>(courses.size()));
+    } else if (isScriptCommand(command, "SYNC")) {
+        if (book.journal != nullptr && !book.journal->commit()) {
+            error = "could not write to the journal";
+            return false;
+        }
+    } else if (isScriptCommand(command, "QUIT")) {
+        stop = true;
+    } else {
+        error = "unknown command";
+        return false;
+    }
+    return true;
+}
+
+// Runs one input line and adds its answer line (if it gets one) to
+// "answers". Returns false if the answer is ERR. "stop" is set by QUIT.
+bool answerScriptLine(Gradebook& book, string& line, ReportBuffer& answers,
+                      bool& stop) {
+    static ReportBuffer result;  // reused so answering does not allocate
+    static string error;
+    char* tokens[SCRIPT_MAX_TOKENS];
+    const char* splitError = nullptr;
+    int count = splitScriptLine(line, tokens, splitError);
+
+    if (count == 0) {
+        return true;  // nothing to answer (empty line or comment)
+    }
+    if (count < 0) {
+        answers.append("ERR ");
+        answers.append(splitError);
+        answers.append('\n');
+        return false;
+    }
+
+    result.clear();
+    bool ok = runScriptCommand(book, tokens, count, result, error, stop);
+    if (ok) {
+        answers.append(result.size() == 0 ? "OK" : "OK ");
+        answers.append(result.text());
+    } else {
+        answers.append("ERR ");
+        answers.append(error);
+    }
+    answers.append('\n');
+    return ok;
+}
+
+// True if every change answered so far is on disk (the journal has nothing
+// queued), so the answers up to here may be sent even if a later commit
+// fails.
+static bool scriptAnswersDurable(const Gradebook& book) {
+    return book.journal == nullptr || book.journal->pendingRecords() == 0;
+}
+
+// Makes the queued changes durable, then writes the queued answers. If the
+// journal cannot be written, the changes behind the answers after
+// "durableBytes" (see scriptAnswersDurable) are not safe on disk, so each
+// of those answers is replaced by an ERR, the unwritten records are
+// dropped and false is returned.
+static bool flushScriptAnswers(Gradebook& book, ReportBuffer& answers,
+                               size_t durableBytes, ostream& out) {
+    if (syncGradebook(book)) {
+        answers.writeTo(out);
+        return true;
+    }
+
+    // Nothing after this point may make those changes durable after all.
+    book.journal->discardPending();
+
+    string failed = answers.text().substr(durableBytes);
+    size_t lines = static_cast<size_t>(count(failed.begin(), failed.end(),
+                                             '\n'));
+    string kept = answers.text().substr(0, durableBytes);
+    answers.clear();
+    answers.append(kept);
+    for (size_t i = 0; i < lines; ++i) {
+        answers.append("ERR could not write to the journal\n");
+    }
+    answers.writeTo(out);
+    return false;
+}
+
+// Reads commands until the input ends (or QUIT) and answers each of them.
+// Returns 0 if every command succeeded, 2 if some answered ERR, and 1 if
+// the journal could not be written (reading stops right there).
+int runScriptMode(istream& in, ostream& out, Gradebook& book) {
+    string line;
+    ReportBuffer answers;
+    size_t durableBytes = 0;  // answers whose changes are already on disk
+    bool failed = false;
+    bool stop = false;
+
+    while (!stop && getline(in, line)) {
+        if (!answerScriptLine(book, line, answers, stop)) {
+            failed = true;
+        }
+        if (scriptAnswersDurable(book)) {
+            durableBytes = answers.size();
+        }
+
+        // Answer once no more input is waiting (the other side may be
+        // waiting for us) or when plenty of answers have piled up.
+        if (answers.size() >= SCRIPT_FLUSH_BYTES ||
+            in.rdbuf()->in_avail() <= 0) {
+            if (!flushScriptAnswers(book, answers, durableBytes, out)) {
+                return 1;
+            }
+            durableBytes = 0;
+        }
+    }
+
+    if (!flushScriptAnswers(book, answers, durableBytes, out)) {
+        return 1;
+    }
+    return failed ? 2 : 0;
+}
+
+// ============================================================================
+// DAEMON MODE
+// ============================================================================
+// "--serve socket [--data path]" keeps the gradebook in memory and answers
+// script-mode commands (see "SCRIPT MODE") from any number of local clients
+// over a Unix domain socket. A query then costs microseconds instead of a
+// process start plus reloading the data.
+//
+// One thread runs an epoll loop, so no locking is needed. Each wake-up is
+// handled as one batch:
+//   1. read everything the ready clients have sent,
+//   2. run every complete line, client by client, in the order received,
+//   3. commit the journal once for the whole batch (group commit),
+//   4. write the answers back.
+// An answer therefore never reaches a client before its change is on disk.
+// If the commit fails, the answers whose changes did not reach the disk
+// become ERR lines and the server stops without saving, so the files hold
+// exactly the changes that were answered OK.
+//
+// A client that sends commands without reading the answers is not read
+// from while more than SERVER_MAX_UNSENT_BYTES of its answers are waiting,
+// so the server's memory stays bounded.
+//
+// QUIT closes only that client's connection. SIGINT or SIGTERM stops the
+// server, which then saves the snapshot like the menu does on exit.
+//
+// GradebookClient is the matching client library, and
+// "--client socket [command ...]" is a small command-line client built on it.
+
+const size_t SERVER_MAX_LINE_BYTES = 64 * 1024;
+const size_t SERVER_MAX_READ_BYTES = 256 * 1024;    // per client per batch
+const size_t SERVER_MAX_UNSENT_BYTES = 1024 * 1024; // answers not yet sent
+const int SERVER_MAX_EVENTS = 64;
+const size_t CLIENT_PIPELINE_DEPTH = 256;
+
+#if defined(GPA_HAVE_EPOLL)
+
+// Where one answer of the current batch starts in a client's output, and
+// how many journal records must be on disk before it may be sent.
+struct ServerAnswer {
+    size_t begin;
+    uint64_t records;
+};
+
+// One connected client.
+struct ServerClient {
+    int fd = -1;             // -1 = slot not in use
+    string input;            // bytes received but not yet run
+    string output;           // answers not yet written
+    size_t outputPos = 0;    // how much of "output" is already written
+    vector<ServerAnswer> batch; // this batch's answers in "output"
+    bool closing = false;    // close once "output" is written
+    bool wantsRead = true;   // registered for EPOLLIN
+    bool wantsWrite = false; // registered for EPOLLOUT
+};
+
+static volatile sig_atomic_t serverStopRequested = 0;
+
+static void requestServerStop(int) {
+    serverStopRequested = 1;
+}
+
+// Changes which events epoll reports for a client.
+static void watchServerClient(int epollFd, ServerClient& client, bool read,
+                              bool write) {
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = (read ? EPOLLIN | EPOLLRDHUP : 0u) |
+                   (write ? EPOLLOUT : 0u);
+    event.data.fd = client.fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, client.fd, &event);
+    client.wantsRead = read;
+    client.wantsWrite = write;
+}
+
+static void closeServerClient(int epollFd, ServerClient& client) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, client.fd, nullptr);
+    ::close(client.fd);
+    client.fd = -1;
+    client.input.clear();
+    client.output.clear();
+    client.outputPos = 0;
+    client.batch.clear();
+    client.closing = false;
+    client.wantsRead = true;
+    client.wantsWrite = false;
+}
+
+// Reads what the client has sent so far, up to SERVER_MAX_READ_BYTES per
+// batch (epoll reports the rest next time). Returns false once the client
+// has hung up (or the connection failed).
+static bool readServerClient(ServerClient& client) {
+    char chunk[16 * 1024];
+    while (client.input.size() < SERVER_MAX_READ_BYTES) {
+        ssize_t got = ::read(client.fd, chunk, sizeof(chunk));
+        if (got > 0) {
+            client.input.append(chunk, static_cast<size_t>(got));
+            continue;
+        }
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        return false;  // 0 = the client closed its end
+    }
+    return true;
+}
+
+// Adds one answer to the client's output and remembers which journal
+// records it waits for.
+static void queueServerAnswer(const Gradebook& book, ServerClient& client,
+                              ReportBuffer& answers) {
+    if (answers.size() == 0) {
+        return;  // empty line or comment
+    }
+
+    ServerAnswer answer;
+    answer.begin = client.output.size();
+    answer.records = book.journal != nullptr
+        ? book.journal->appendedRecords() : 0;
+    client.batch.push_back(answer);
+
+    client.output += answers.text();
+    answers.clear();
+}
+
+// True while the client's unsent answers are below the limit, i.e. the
+// server may read and run more of its commands.
+static bool serverClientCanRun(const ServerClient& client) {
+    return !client.closing &&
+        client.output.size() - client.outputPos <= SERVER_MAX_UNSENT_BYTES;
+}
+
+// Runs the complete lines the client has sent (until its unsent answers
+// reach the limit) and queues the answers.
+static void runServerClientLines(Gradebook& book, ServerClient& client,
+                                 string& line, ReportBuffer& answers) {
+    size_t start = 0;
+    bool stop = false;
+    while (!stop && serverClientCanRun(client)) {
+        size_t end = client.input.find('\n', start);
+        if (end == string::npos) {
+            break;
+        }
+        line.assign(client.input, start, end - start);
+        start = end + 1;
+        answerScriptLine(book, line, answers, stop);
+        queueServerAnswer(book, client, answers);
+    }
+    client.input.erase(0, start);
+
+    if (stop) {
+        client.closing = true;
+        client.input.clear();
+    } else if (client.input.size() > SERVER_MAX_LINE_BYTES &&
+               client.input.find('\n') == string::npos) {
+        answers.append("ERR line too long\n");
+        queueServerAnswer(book, client, answers);
+        client.closing = true;
+        client.input.clear();
+    }
+}
+
+// After a failed journal commit: keeps the client's answers whose changes
+// are on disk and turns the rest of this batch's answers into ERR lines.
+static void failServerAnswers(const Gradebook& book, ServerClient& client) {
+    uint64_t durable = book.journal->durableRecords();
+    size_t kept = 0;
+    while (kept < client.batch.size() &&
+           client.batch[kept].records <= durable) {
+        ++kept;
+    }
+    if (kept == client.batch.size()) {
         return;
     }
 
-    c.name = newName;
-    cout << "Course name updated.\n";
+    client.output.resize(client.batch[kept].begin);
+    for (size_t i = kept; i < client.batch.size(); ++i) {
+        client.output += "ERR could not write to the journal\n";
+    }
+    client.closing = true;
+}
+
+// Writes as much of the queued answers as the socket takes right now.
+// Returns false if the connection failed.
+static bool writeServerClient(ServerClient& client) {
+    while (client.outputPos < client.output.size()) {
+        ssize_t sent = ::send(client.fd, client.output.data() + client.outputPos,
+                              client.output.size() - client.outputPos,
+                              MSG_NOSIGNAL);
+        if (sent > 0) {
+            client.outputPos += static_cast<size_t>(sent);
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        return sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+    client.output.clear();
+    client.outputPos = 0;
+    return true;
+}
+
+// Binds the listening socket, replacing a stale socket file left behind by
+// a server that did not shut down cleanly. Returns -1 on failure.
+static int openServerSocket(const string& socketPath, string& error) {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path)) {
+        error = "socket path is empty or too long";
+        return -1;
+    }
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    struct stat info;
+    if (lstat(socketPath.c_str(), &info) == 0) {
+        if (!S_ISSOCK(info.st_mode)) {
+            error = socketPath + " exists and is not a socket";
+            return -1;
+        }
+        // Only remove it if nobody is serving on it any more.
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool inUse = probe >= 0 &&
+            ::connect(probe, reinterpret_cast<sockaddr*>(&address),
+                      sizeof(address)) == 0;
+        if (probe >= 0) {
+            ::close(probe);
+        }
+        if (inUse) {
+            error = "another server is already listening on " + socketPath;
+            return -1;
+        }
+        unlink(socketPath.c_str());
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        error = string("could not create socket: ") + strerror(errno);
+        return -1;
+    }
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(fd, SOMAXCONN) != 0) {
+        error = string("could not listen on ") + socketPath + ": " +
+            strerror(errno);
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Serves clients until SIGINT/SIGTERM. Returns 0 on a clean stop and 1 if
+// the journal could not be written (the caller must not save then).
+int runServer(const string& socketPath, Gradebook& book) {
+    string error;
+    int listenFd = openServerSocket(socketPath, error);
+    if (listenFd < 0) {
+        cerr << "Could not start server: " << error << "\n";
+        return 1;
+    }
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        cerr << "Could not start server: epoll_create1 failed\n";
+        ::close(listenFd);
+        unlink(socketPath.c_str());
+        return 1;
+    }
+    epoll_event listenEvent;
+    memset(&listenEvent, 0, sizeof(listenEvent));
+    listenEvent.events = EPOLLIN;
+    listenEvent.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &listenEvent);
+
+    signal(SIGINT, requestServerStop);
+    signal(SIGTERM, requestServerStop);
+    signal(SIGPIPE, SIG_IGN);
+
+    cerr << "Serving " << book.courses.size() << " course(s) on "
+         << socketPath << " (Ctrl+C to stop).\n";
+
+    vector<ServerClient> clients;  // indexed by file descriptor
+    vector<int> touched;           // clients with answers from this batch
+    vector<int> backlog;           // clients with lines left to run
+    epoll_event events[SERVER_MAX_EVENTS];
+    string line;
+    ReportBuffer answers;
+    bool journalFailed = false;
+
+    while (!serverStopRequested) {
+        int ready = epoll_wait(epollFd, events, SERVER_MAX_EVENTS,
+                               backlog.empty() ? -1 : 0);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            cerr << "epoll_wait failed: " << strerror(errno) << "\n";
+            break;
+        }
+
+        for (int i = 0; i < ready; ++i) {
+            int fd = events[i].data.fd;
+
+            if (fd == listenFd) {
+                while (true) {
+                    int clientFd = accept4(listenFd, nullptr, nullptr,
+                                           SOCK_NONBLOCK | SOCK_CLOEXEC);
+                    if (clientFd < 0) {
+                        break;  // EAGAIN: no more waiting connections
+                    }
+                    if (static_cast<size_t>(clientFd) >= clients.size()) {
+                        clients.resize(static_cast<size_t>(clientFd) + 1);
+                    }
+                    clients[clientFd].fd = clientFd;
+
+                    epoll_event event;
+                    memset(&event, 0, sizeof(event));
+                    event.events = EPOLLIN | EPOLLRDHUP;
+                    event.data.fd = clientFd;
+                    epoll_ctl(epollFd, EPOLL_CTL_ADD, clientFd, &event);
+                }
+                continue;
+            }
+
+            ServerClient& client = clients[fd];
+            if (client.fd < 0) {
+                continue;  // closed earlier in this batch
+            }
+            if (client.wantsRead &&
+                (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+                bool open = readServerClient(client);
+                if (!client.closing) {
+                    runServerClientLines(book, client, line, answers);
+                }
+                if (!open) {
+                    client.closing = true;
+                }
+            }
+            touched.push_back(fd);
+        }
+
+        // Lines held back earlier while a client's answers piled up.
+        for (int fd : backlog) {
+            ServerClient& client = clients[fd];
+            if (client.fd >= 0 && serverClientCanRun(client)) {
+                runServerClientLines(book, client, line, answers);
+                touched.push_back(fd);
+            }
+        }
+        backlog.clear();
+
+        // One journal commit covers every change made in this batch.
+        if (!syncGradebook(book)) {
+            for (int fd : touched) {
+                if (clients[fd].fd >= 0) {
+                    failServerAnswers(book, clients[fd]);
+                }
+            }
+            // Nothing may make the refused changes durable after all.
+            book.journal->discardPending();
+            journalFailed = true;
+        }
+
+        for (int fd : touched) {
+            ServerClient& client = clients[fd];
+            if (client.fd < 0) {
+                continue;
+            }
+            client.batch.clear();
+            if (!writeServerClient(client) ||
+                (client.closing && client.output.empty())) {
+                closeServerClient(epollFd, client);
+                continue;
+            }
+            // Stop reading from a client that does not read its answers.
+            bool pending = !client.output.empty();
+            bool read = serverClientCanRun(client);
+            if (pending != client.wantsWrite || read != client.wantsRead) {
+                watchServerClient(epollFd, client, read, pending);
+            }
+            if (read && client.input.find('\n') != string::npos) {
+                backlog.push_back(fd);
+            }
+        }
+        touched.clear();
+
+        if (journalFailed) {
+            cerr << "Stopping: the journal could not be written.\n";
+            break;
+        }
+    }
+
+    for (ServerClient& client : clients) {
+        if (client.fd >= 0) {
+            writeServerClient(client);
+            closeServerClient(epollFd, client);
+        }
+    }
+    ::close(epollFd);
+    ::close(listenFd);
+    unlink(socketPath.c_str());
+    cerr << "Server stopped.\n";
+    return journalFailed ? 1 : 0;
+}
+
+#else
+
+int runServer(const string& socketPath, Gradebook& book) {
+    (void)socketPath;
+    (void)book;
+    cerr << "Daemon mode needs Linux (epoll).\n";
+    return 1;
+}
+
+#endif
+
+#if defined(GPA_HAVE_UNIX_SOCKETS)
+
+GradebookClient::GradebookClient() : fd(-1), receivedPos(0) {}
+
+GradebookClient::~GradebookClient() {
+    close();
+}
+
+bool GradebookClient::connect(const string& socketPath, string& error) {
+    close();
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path)) {
+        error = "socket path is empty or too long";
+        return false;
+    }
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        error = string("could not create socket: ") + strerror(errno);
+        return false;
+    }
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address),
+                  sizeof(address)) != 0) {
+        error = string("could not connect to ") + socketPath + ": " +
+            strerror(errno);
+        close();
+        return false;
+    }
+    return true;
+}
+
+void GradebookClient::close() {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    received.clear();
+    receivedPos = 0;
+}
+
+bool GradebookClient::sendAll(const string& bytes) {
+    size_t done = 0;
+    while (done < bytes.size()) {
+        ssize_t sent = ::send(fd, bytes.data() + done, bytes.size() - done,
+                              MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+bool GradebookClient::readLine(string& line) {
+    while (true) {
+        size_t end = received.find('\n', receivedPos);
+        if (end != string::npos) {
+            line.assign(received, receivedPos, end - receivedPos);
+            receivedPos = end + 1;
+            if (receivedPos == received.size()) {
+                received.clear();
+                receivedPos = 0;
+            }
+            return true;
+        }
+
+        char chunk[16 * 1024];
+        ssize_t got = ::read(fd, chunk, sizeof(chunk));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        received.append(chunk, static_cast<size_t>(got));
+    }
+}
+
+bool GradebookClient::query(const string& command, string& answer) {
+    if (fd < 0 || command.find('\n') != string::npos) {
+        return false;
+    }
+    request = command;
+    request += '\n';
+    return sendAll(request) && readLine(answer);
+}
+
+bool GradebookClient::queryAll(const vector<string>& commands,
+                               vector<string>& answers) {
+    answers.clear();
+    if (fd < 0) {
+        return false;
+    }
+
+    // Send a whole window of commands in one write, then collect their
+    // answers, so the server can handle the window as one batch.
+    for (size_t first = 0; first < commands.size();
+         first += CLIENT_PIPELINE_DEPTH) {
+        size_t last = first + CLIENT_PIPELINE_DEPTH;
+        if (last > commands.size()) {
+            last = commands.size();
+        }
+
+        request.clear();
+        for (size_t i = first; i < last; ++i) {
+            if (commands[i].find('\n') != string::npos) {
+                return false;
+            }
+            request += commands[i];
+            request += '\n';
+        }
+        if (!sendAll(request)) {
+            return false;
+        }
+
+        // Empty and comment lines get no answer (see "SCRIPT MODE").
+        for (size_t i = first; i < last; ++i) {
+            size_t text = commands[i].find_first_not_of(" \t\r");
+            if (text == string::npos || commands[i][text] == '#') {
+                answers.push_back(string());
+                continue;
+            }
+            answers.push_back(string());
+            if (!readLine(answers.back())) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+#else
+
+GradebookClient::GradebookClient() : fd(-1), receivedPos(0) {}
+GradebookClient::~GradebookClient() {}
+
+bool GradebookClient::connect(const string& socketPath, string& error) {
+    (void)socketPath;
+    error = "Unix domain sockets are not available on this system";
+    return false;
+}
+
+void GradebookClient::close() {}
+bool GradebookClient::sendAll(const string&) { return false; }
+bool GradebookClient::readLine(string&) { return false; }
+bool GradebookClient::query(const string&, string&) { return false; }
+
+bool GradebookClient::queryAll(const vector<string>&, vector<string>& answers) {
+    answers.clear();
+    return false;
+}
+
+#endif
+
+// "--client socket [command ...]": sends the commands given on the command
+// line, or else every line of stdin, and prints one answer per command.
+// Returns 0 if every answer was OK, 2 if some were ERR, 1 if the
+// connection failed.
+int runClient(int argc, char* argv[]) {
+    if (argc < 3) {
+        cerr << "Usage: --client socket [command ...]\n";
+        return 1;
+    }
+
+    GradebookClient client;
+    string error;
+    if (!client.connect(argv[2], error)) {
+        cerr << "Could not connect: " << error << "\n";
+        return 1;
+    }
+
+    vector<string> commands;
+    for (int i = 3; i < argc; ++i) {
+        commands.push_back(argv[i]);
+    }
+    bool fromStdin = commands.empty();
+
+    vector<string> answers;
+    bool failed = false;
+    string line;
+    while (true) {
+        if (fromStdin) {
+            commands.clear();
+            while (commands.size() < CLIENT_PIPELINE_DEPTH && getline(cin, line)) {
+                commands.push_back(line);
+            }
+            if (commands.empty()) {
+                break;
+            }
+        }
+
+        if (!client.queryAll(commands, answers)) {
+            cerr << "Connection to the server was lost.\n";
+            return 1;
+        }
+        for (size_t i = 0; i < answers.size(); ++i) {
+            if (answers[i].empty()) {
+                continue;  // empty or comment line
+            }
+            cout << answers[i] << "\n";
+            if (answers[i].compare(0, 3, "ERR") == 0) {
+                failed = true;
+            }
+        }
+
+        if (!fromStdin) {
+            break;
+        }
+    }
+    cout.flush();
+    return failed ? 2 : 0;
+}
+
+// ============================================================================
+// CLASS RANK
+// ============================================================================
+// GpaRankIndex answers "where does this GPA stand in the class?" without
+// sorting. GPAs are rounded to 0.001 (GPAs are shown with two decimals, so
+// this never changes an answer) and each possible value is one bucket:
+//   * a Fenwick tree (binary indexed tree) over the buckets gives the number
+//     of students up to any bucket in O(log n), and can find the bucket that
+//     holds the nth student with one walk down the tree,
+//   * each bucket also lists its students, so top-K, honors and probation
+//     lists jump straight from one occupied bucket to the next.
+// Changing a student's GPA moves them between two buckets: two tree updates
+// and a swap-remove from the old bucket's list.
+//
+// "--rank students.csv" loads a cohort in the batch input format (see
+// "BATCH MODE") and then answers one query per line from stdin, in the same
+// style as script mode:
+//     RANK student                           -> OK rank of gpa percentile
+//     PERCENTILE gpa                         -> OK percentile
+//     ABOVE gpa                              -> OK count
+//     TOP k                                  -> OK count student gpa ...
+//     HONORS [min]                           -> OK count student gpa ...
+//                                               (GPA of min or more, 3.5)
+//     PROBATION [below]                      -> OK count student gpa ...
+//                                               (GPA under below, 2.0)
+//     EDIT student course number earned max -> OK gpa rank
+//     QUIT                                   -> OK
+// EDIT changes one assignment of one of the student's courses (numbered
+// from 1, in input order) and updates that student's rank right away.
+
+// Buckets of 0.001 from 0 up to 5 grade points (the highest any scale gives).
+const size_t RANK_BUCKETS = 5001;
+const uint16_t NOT_RANKED = 0xFFFF;
+
+const double HONORS_MIN_GPA = 3.5;
+const double PROBATION_GPA = 2.0;
+
+GpaRankIndex::GpaRankIndex() : count(0) {
+    reset(0);
+}
+
+void GpaRankIndex::reset(size_t students) {
+    tree.assign(RANK_BUCKETS + 1, 0);
+    members.assign(RANK_BUCKETS, vector<uint32_t>());
+    position.assign(students, 0);
+    bucket.assign(students, NOT_RANKED);
+    gpas.assign(students, 0.0);
+    count = 0;
+}
+
+size_t GpaRankIndex::bucketOf(double gpa) {
+    double scaled = floor(gpa * 1000.0 + 0.5);
+    if (!(scaled > 0.0)) {
+        return 0;
+    }
+    if (scaled >= RANK_BUCKETS - 1) {
+        return RANK_BUCKETS - 1;
+    }
+    return static_cast<size_t>(scaled);
+}
+
+// The tree is 1-based: tree[i] covers the buckets (i - lowbit(i), i].
+void GpaRankIndex::addToBucket(size_t b, int delta) {
+    for (size_t i = b + 1; i <= RANK_BUCKETS; i += i & (~i + 1)) {
+        tree[i] += delta;
+    }
+}
+
+size_t GpaRankIndex::countUpTo(size_t b) const {
+    size_t total = 0;
+    for (size_t i = b + 1; i > 0; i -= i & (~i + 1)) {
+        total += tree[i];
+    }
+    return total;
+}
+
+// Walks down the tree from the biggest power of two, skipping every block
+// that holds fewer students than are still needed.
+size_t GpaRankIndex::bucketOfNth(size_t nth) const {
+    size_t step = 1;
+    while (step * 2 <= RANK_BUCKETS) {
+        step *= 2;
+    }
+    size_t at = 0;
+    for (; step > 0; step /= 2) {
+        if (at + step <= RANK_BUCKETS && tree[at + step] < nth) {
+            at += step;
+            nth -= tree[at];
+        }
+    }
+    return at;  // tree index at + 1 is bucket "at"
+}
+
+bool GpaRankIndex::contains(size_t student) const {
+    return student < bucket.size() && bucket[student] != NOT_RANKED;
 }
 
-// Change course credit hours.
-void changeCourseCreditHours(vector<Course>& courses) {
-    if (courses.empty()) {
-        cout << "No courses available.\n";
+void GpaRankIndex::set(size_t student, double gpa) {
+    size_t b = bucketOf(gpa);
+    gpas[student] = gpa;
+    if (bucket[student] == b) {
         return;
     }
+    if (bucket[student] != NOT_RANKED) {
+        erase(student);
+    }
 
-    listCoursesSummary(courses);
-
-    int id = readIntInRange(
-        "Enter the ID of the course whose credit hours you want to change: ",
-        1, 1000000);
+    bucket[student] = static_cast<uint16_t>(b);
+    position[student] = static_cast<uint32_t>(members[b].size());
+    members[b].push_back(static_cast<uint32_t>(student));
+    addToBucket(b, 1);
+    count++;
+}
 
-    int index = findCourseIndexById(courses, id);
-    if (index == -1) {
-        cout << "No course found with that ID.\n";
+void GpaRankIndex::erase(size_t student) {
+    if (!contains(student)) {
         return;
     }
+    vector<uint32_t>& list = members[bucket[student]];
+    uint32_t moved = list.back();
+    list[position[student]] = moved;
+    position[moved] = position[student];
+    list.pop_back();
+
+    addToBucket(bucket[student], -1);
+    bucket[student] = NOT_RANKED;
+    count--;
+}
 
-    Course& c = courses[index];
+size_t GpaRankIndex::countAbove(double gpa) const {
+    return count - countUpTo(bucketOf(gpa));
+}
 
-    cout << "Current credit hours for " << c.name
-         << ": " << c.creditHours << "\n";
+size_t GpaRankIndex::countAtLeast(double gpa) const {
+    size_t b = bucketOf(gpa);
+    return b == 0 ? count : count - countUpTo(b - 1);
+}
 
-    double newCredits = readDoubleInRange(
-        "Enter new credit hours (0.5 to 6.0): ", 0.5, 6.0);
+size_t GpaRankIndex::countBelow(double gpa) const {
+    return count - countAtLeast(gpa);
+}
 
-    c.creditHours = newCredits;
-    cout << "Credit hours updated.\n";
+size_t GpaRankIndex::rankOf(size_t student) const {
+    return countAbove(gpas[student]) + 1;
 }
 
-// Edit an assignment's scores in a chosen course.
-void editAssignmentInCourse(vector<Course>& courses) {
-    if (courses.empty()) {
-        cout << "No courses available.\n";
-        return;
+double GpaRankIndex::percentileOf(double gpa) const {
+    if (count == 0) {
+        return 0.0;
     }
+    return 100.0 * countUpTo(bucketOf(gpa)) / count;
+}
 
-    listCoursesSummary(courses);
-
-    int id = readIntInRange(
-        "Enter the ID of the course containing the assignment: ",
-        1, 1000000);
+// Appends the students of one bucket, best exact GPA first.
+void GpaRankIndex::appendBucket(size_t b, vector<size_t>& students) const {
+    size_t first = students.size();
+    for (uint32_t student : members[b]) {
+        students.push_back(student);
+    }
+    sort(students.begin() + first, students.end(),
+         [this](size_t x, size_t y) {
+        return gpas[x] != gpas[y] ? gpas[x] > gpas[y] : x < y;
+    });
+}
 
-    int index = findCourseIndexById(courses, id);
-    if (index == -1) {
-        cout << "No course found with that ID.\n";
-        return;
+void GpaRankIndex::topStudents(size_t k, vector<size_t>& students) const {
+    students.clear();
+    if (k > count) {
+        k = count;
+    }
+    // The nth best student is the (count - n + 1)th lowest.
+    while (students.size() < k) {
+        appendBucket(bucketOfNth(count - students.size()), students);
     }
+    students.resize(k);
+}
 
-    Course& c = courses[index];
+void GpaRankIndex::studentsAtLeast(double gpa, vector<size_t>& students) const {
+    topStudents(countAtLeast(gpa), students);
+}
 
-    if (c.work.empty()) {
-        cout << "This course has no assignments to edit.\n";
-        return;
+void GpaRankIndex::studentsBelow(double gpa, vector<size_t>& students) const {
+    students.clear();
+    size_t below = countBelow(gpa);
+    size_t done = 0;
+    // Collect the buckets from the lowest up, then list them best first.
+    vector<size_t> buckets;
+    while (done < below) {
+        size_t b = bucketOfNth(done + 1);
+        buckets.push_back(b);
+        done += members[b].size();
     }
-
-    cout << "Assignments for course: " << c.name << "\n";
-    for (size_t i = 0; i < c.work.size(); ++i) {
-        const Assignment& a = c.work[i];
-        cout << (i + 1) << ". " << a.name
-             << " (earned " << a.earned << " / " << a.max << ")\n";
+    for (size_t i = buckets.size(); i > 0; --i) {
+        appendBucket(buckets[i - 1], students);
     }
+}
 
-    int choice = readIntInRange(
-        "Enter the number of the assignment to edit: ",
-        1, static_cast<int>(c.work.size()));
+namespace {
 
-    Assignment& a = c.work[choice - 1];
+// A loaded cohort plus its rank index. Students are found by id.
+struct RankedCohort {
+    vector<StudentRecord> students;
+    unordered_map<string, size_t> byId;
+    GpaRankIndex index;
+};
 
-    cout << "Editing assignment: " << a.name << "\n";
+} // namespace
 
-    // Let user either keep the name or change it
-    cout << "Current name: " << a.name << "\n";
-    cout << "Enter a new name, or just press Enter to keep it: ";
-    string newName;
-    getline(cin, newName);
-    if (!newName.empty()) {
-        a.name = newName;
+// Adds "count" students of a batch block to the cohort.
+static void addRankedStudents(RankedCohort& cohort,
+                              vector<StudentRecord>& block, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        if (cohort.byId.count(block[i].id) > 0) {
+            cerr << "student " << block[i].id
+                 << " is listed twice (rows must be grouped), later rows skipped\n";
+            continue;
+        }
+        cohort.byId[block[i].id] = cohort.students.size();
+        cohort.students.push_back(StudentRecord());
+        swap(cohort.students.back(), block[i]);
     }
+}
 
-    double newMax = readDoubleInRange(
-        "Enter NEW maximum points: ", 1.0, 10000.0);
-
-    double newEarned = readDoubleInRange(
-        "Enter NEW points earned: ", 0.0, newMax);
+// Appends "count student gpa ..." for a list of students. Student ids
+// are written as they are (script tokens cannot contain spaces anyway).
+static void appendRankedList(ReportBuffer& out, const RankedCohort& cohort,
+                             const vector<size_t>& list) {
+    out.appendInt(static_cast<long long>(list.size()));
+    for (size_t student : list) {
+        out.append(' ');
+        out.append(cohort.students[student].id);
+        out.append(' ');
+        out.appendFixed(cohort.index.gpaOf(student), 2);
+    }
+}
 
-    a.max = newMax;
-    a.earned = newEarned;
+// Runs one rank query; see the list above.
+static bool runRankCommand(RankedCohort& cohort, char* tokens[], int count,
+                           ReportBuffer& out, string& error, bool& stop) {
+    const char* command = tokens[0];
+    GpaRankIndex& index = cohort.index;
+    vector<size_t> list;
+    double value = 0.0;
+    int number = 0;
+
+    if (isScriptCommand(command, "RANK")) {
+        auto found = count == 2 ? cohort.byId.find(tokens[1])
+                                : cohort.byId.end();
+        if (found == cohort.byId.end()) {
+            error = count == 2 ? "no student with that id" : "usage: RANK student";
+            return false;
+        }
+        size_t student = found->second;
+        out.appendInt(static_cast<long long>(index.rankOf(student)));
+        out.append(' ');
+        out.appendInt(static_cast<long long>(index.size()));
+        out.append(' ');
+        out.appendFixed(index.gpaOf(student), 2);
+        out.append(' ');
+        out.appendFixed(index.percentileOf(index.gpaOf(student)), 1);
+    } else if (isScriptCommand(command, "PERCENTILE") ||
+               isScriptCommand(command, "ABOVE")) {
+        if (count != 2 || !parseScriptNumber(tokens[1], value)) {
+            error = "expected a GPA";
+            return false;
+        }
+        if (isScriptCommand(command, "ABOVE")) {
+            out.appendInt(static_cast<long long>(index.countAbove(value)));
+        } else {
+            out.appendFixed(index.percentileOf(value), 1);
+        }
+    } else if (isScriptCommand(command, "TOP")) {
+        if (count != 2 || !parseScriptInt(tokens[1], number) || number < 0) {
+            error = "usage: TOP k";
+            return false;
+        }
+        index.topStudents(static_cast<size_t>(number), list);
+        appendRankedList(out, cohort, list);
+    } else if (isScriptCommand(command, "HONORS") ||
+               isScriptCommand(command, "PROBATION")) {
+        bool honors = isScriptCommand(command, "HONORS");
+        value = honors ? HONORS_MIN_GPA : PROBATION_GPA;
+        if (count > 2 || (count == 2 && !parseScriptNumber(tokens[1], value))) {
+            error = "expected a GPA";
+            return false;
+        }
+        if (honors) {
+            index.studentsAtLeast(value, list);
+        } else {
+            index.studentsBelow(value, list);
+        }
+        appendRankedList(out, cohort, list);
+    } else if (isScriptCommand(command, "EDIT")) {
+        int courseNumber = 0;
+        double earned = 0.0;
+        double max = 0.0;
+        if (count != 6 || !parseScriptInt(tokens[2], courseNumber) ||
+            !parseScriptInt(tokens[3], number) ||
+            !parseScriptNumber(tokens[4], earned) ||
+            !parseScriptNumber(tokens[5], max)) {
+            error = "usage: EDIT student course number earned max";
+            return false;
+        }
+        auto found = cohort.byId.find(tokens[1]);
+        if (found == cohort.byId.end()) {
+            error = "no student with that id";
+            return false;
+        }
+        size_t student = found->second;
+        CourseStore& courses = cohort.students[student].courses;
+        if (courseNumber < 1 || static_cast<size_t>(courseNumber) > courses.size()) {
+            error = "no course with that number";
+            return false;
+        }
+        Course& c = courses[static_cast<size_t>(courseNumber) - 1];
+        if (number < 1 || static_cast<size_t>(number) > c.work.size()) {
+            error = "no assignment with that number";
+            return false;
+        }
+        if (!(max >= 1.0 && max <= 10000.0) ||
+            !(earned >= 0.0 && earned <= max)) {
+            error = "earned must be between 0 and max, max between 1 and 10000";
+            return false;
+        }
 
-    cout << "Assignment updated.\n";
+        size_t position = static_cast<size_t>(number) - 1;
+        Assignment a = c.work[position];
+        a.earned = earned;
+        a.max = max;
+        replaceWorkInCourse(c, position, a);
+
+        // Only this student's GPA changed: one O(log n) move in the index.
+        index.set(student, calculateOverallGPA(courses));
+        out.appendFixed(index.gpaOf(student), 2);
+        out.append(' ');
+        out.appendInt(static_cast<long long>(index.rankOf(student)));
+    } else if (isScriptCommand(command, "QUIT")) {
+        stop = true;
+    } else {
+        error = "unknown command";
+        return false;
+    }
+    return true;
 }
 
-// Delete an assignment from a course.
-void deleteAssignmentFromCourse(vector<Course>& courses) {
-    if (courses.empty()) {
-        cout << "No courses available.\n";
-        return;
+// Loads the cohort, ranks it, then answers queries until QUIT or the end of
+// the input. Returns 0, or 2 if some student rows were skipped.
+int runRankMode(istream& students, istream& queries, ostream& out,
+                unsigned threads) {
+    RankedCohort cohort;
+    char delimiter = 0;
+    long long badRows = readStudentBlocks(students, delimiter,
+        [&](vector<StudentRecord>& block, size_t count) {
+            parallelForRanges(count, threads, 16, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    for (Course& c : block[i].courses) {
+                        recalculateCourseTotals(c);
+                    }
+                }
+            });
+            addRankedStudents(cohort, block, count);
+        });
+
+    vector<double> gpas;
+    calculateCohortGPAs(cohort.students, threads, gpas);
+    cohort.index.reset(cohort.students.size());
+    for (size_t i = 0; i < gpas.size(); ++i) {
+        cohort.index.set(i, gpas[i]);
     }
 
-    listCoursesSummary(courses);
+    string line;
+    char* tokens[SCRIPT_MAX_TOKENS];
+    ReportBuffer answers;
+    ReportBuffer result;
+    string error;
+    bool stop = false;
+    while (!stop && getline(queries, line)) {
+        const char* splitError = nullptr;
+        int count = splitScriptLine(line, tokens, splitError);
+        if (count == 0) {
+            continue;  // empty line or comment
+        }
 
-    int id = readIntInRange(
-        "Enter the ID of the course containing the assignment to delete: ",
-        1, 1000000);
+        result.clear();
+        if (count < 0) {
+            answers.append("ERR ");
+            answers.append(splitError);
+        } else if (runRankCommand(cohort, tokens, count, result, error, stop)) {
+            answers.append(result.size() == 0 ? "OK" : "OK ");
+            answers.append(result.text());
+        } else {
+            answers.append("ERR ");
+            answers.append(error);
+        }
+        answers.append('\n');
 
-    int index = findCourseIndexById(courses, id);
-    if (index == -1) {
-        cout << "No course found with that ID.\n";
-        return;
+        if (answers.size() >= SCRIPT_FLUSH_BYTES ||
+            queries.rdbuf()->in_avail() <= 0) {
+            answers.writeTo(out);
+        }
     }
+    answers.writeTo(out);
+    return badRows == 0 ? 0 : 2;
+}
+
+// ============================================================================
+// METRICS
+// ============================================================================
+// Every call to the core operations (course percentage, GPA, what-if,
+// course lookup, each kind of change, report rendering and output) is
+// counted, and calls are timed into a latency histogram in the style of
+// HdrHistogram: each power of two of nanoseconds is split into 16 equal
+// buckets, so a value is known to within 1/16 (about 6%) from 1 ns up to
+// several hours, in a fixed table of METRIC_BUCKETS counters.
+//
+// Reading the clock twice costs more than a course lookup, so the fast
+// operations are only timed on one call in METRIC_SAMPLE_PERIOD (the call
+// count is always exact). Slower operations are timed on every call.
+//
+// Each thread records into its own shard, so timing a call never takes a
+// lock or shares a cache line with another thread. Only the owning thread
+// writes a shard, so a plain load + store is enough; readers just add the
+// shards together. A thread gives its shard back when it ends and the next
+// new thread reuses it (cohort mode starts threads per block).
+//
+// "--metrics text" or "--metrics json" prints the totals on stderr when the
+// program ends; script and daemon mode answer "METRICS" with the JSON form.
+// With -DGPA_NO_METRICS the timers compile to nothing.
+
+// Short names used in the reports (indexed by MetricOp).
+const char* const METRIC_NAMES[METRIC_COUNT] = {
+    "course_percentage", "overall_gpa", "whatif_add", "whatif_gpa",
+    "find_course", "add_course", "add_assignment", "rename_course",
+    "set_credit_hours", "edit_assignment", "delete_assignment",
+    "delete_course", "add_category", "edit_category", "insert_assignment",
+    "delete_category", "other_change",
+    "render_report", "write_output"
+};
 
-    Course& c = courses[index];
+// Calls per timed call, for each operation. Operations that take well
+// under a microsecond are sampled; the rest are timed every time.
+const uint32_t METRIC_SAMPLE_PERIOD[METRIC_COUNT] = {
+    64, 64, 16, 16, 64,               // percentage, GPA, what-if, lookup
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  // changes
+    1, 1, 1                           // other changes, rendering, output
+};
 
-    if (c.work.empty()) {
-        cout << "This course has no assignments to delete.\n";
-        return;
+// The metric for one kind of change (see applyMutation).
+MetricOp mutationMetric(MutationType type) {
+    if (type < MUTATION_ADD_COURSE || type > MUTATION_DELETE_CATEGORY) {
+        return METRIC_OTHER_CHANGE;
     }
+    return static_cast<MetricOp>(METRIC_ADD_COURSE + (type - MUTATION_ADD_COURSE));
+}
 
-    cout << "Assignments for course: " << c.name << "\n";
-    for (size_t i = 0; i < c.work.size(); ++i) {
-        const Assignment& a = c.work[i];
-        cout << (i + 1) << ". " << a.name
-             << " (earned " << a.earned << " / " << a.max << ")\n";
+#if defined(GPA_HAVE_METRICS)
+
+const unsigned METRIC_SUB_BITS = 4;  // 16 buckets per power of two
+const uint64_t METRIC_SUB_COUNT = 1u << METRIC_SUB_BITS;
+const size_t METRIC_BUCKETS = 40 * METRIC_SUB_COUNT;  // up to 2^43 ns
+
+namespace {
+
+struct MetricShard {
+    atomic<uint64_t> calls[METRIC_COUNT];
+    atomic<uint64_t> timed[METRIC_COUNT];
+    uint32_t untilSample[METRIC_COUNT];  // calls left before the next timed one
+    atomic<uint64_t> totalNs[METRIC_COUNT];
+    atomic<uint64_t> maxNs[METRIC_COUNT];
+    atomic<uint64_t> buckets[METRIC_COUNT][METRIC_BUCKETS];
+};
+
+// Shards are never freed, so the totals survive the threads that made them.
+struct MetricRegistry {
+    mutex lock;
+    vector<MetricShard*> shards;  // every shard ever made
+    vector<MetricShard*> unused;  // shards of threads that have ended
+};
+
+MetricRegistry& metricRegistry() {
+    static MetricRegistry* registry = new MetricRegistry();
+    return *registry;
+}
+
+// Hands the thread's shard back when the thread ends.
+struct MetricShardReturn {
+    MetricShard* shard = nullptr;
+    ~MetricShardReturn() {
+        if (shard != nullptr) {
+            MetricRegistry& registry = metricRegistry();
+            lock_guard<mutex> guard(registry.lock);
+            registry.unused.push_back(shard);
+        }
     }
+};
 
-    int choice = readIntInRange(
-        "Enter the number of the assignment to DELETE: ",
-        1, static_cast<int>(c.work.size()));
+thread_local MetricShard* threadShard = nullptr;
+thread_local MetricShardReturn threadShardReturn;
+
+MetricShard* newThreadShard() {
+    MetricRegistry& registry = metricRegistry();
+    MetricShard* shard = nullptr;
+    {
+        lock_guard<mutex> guard(registry.lock);
+        if (!registry.unused.empty()) {
+            shard = registry.unused.back();
+            registry.unused.pop_back();
+        } else {
+            shard = new MetricShard();  // () zeroes every counter
+            registry.shards.push_back(shard);
+        }
+    }
+    threadShardReturn.shard = shard;
+    threadShard = shard;
+    return shard;
+}
 
-    cout << "Are you sure you want to delete assignment '"
-         << c.work[choice - 1].name << "'? (1 = Yes, 0 = No): ";
-    int confirm;
-    cin >> confirm;
-    if (cin.fail()) {
-        cin.clear();
+// Only the owning thread writes, so no read-modify-write instruction is
+// needed; the atomics just make the readers' view well defined.
+inline void bumpMetric(atomic<uint64_t>& counter, uint64_t amount) {
+    counter.store(counter.load(memory_order_relaxed) + amount,
+                  memory_order_relaxed);
+}
+
+size_t metricBucket(uint64_t ns) {
+    if (ns < METRIC_SUB_COUNT) {
+        return static_cast<size_t>(ns);
     }
-    clearInputLine();
+    unsigned top = 63;
+    while ((ns >> top) == 0) {
+        top--;
+    }
+    size_t bucket = (top - METRIC_SUB_BITS + 1) * METRIC_SUB_COUNT +
+        ((ns >> (top - METRIC_SUB_BITS)) & (METRIC_SUB_COUNT - 1));
+    return bucket < METRIC_BUCKETS ? bucket : METRIC_BUCKETS - 1;
+}
 
-    if (confirm != 1) {
-        cout << "Deletion cancelled.\n";
-        return;
+// Highest value that falls in a bucket (what a percentile reports).
+uint64_t metricBucketLimit(size_t bucket) {
+    if (bucket < METRIC_SUB_COUNT) {
+        return bucket;
     }
+    unsigned shift = static_cast<unsigned>(bucket / METRIC_SUB_COUNT) - 1;
+    uint64_t low = (METRIC_SUB_COUNT + bucket % METRIC_SUB_COUNT) << shift;
+    return low + (uint64_t(1) << shift) - 1;
+}
 
-    c.work.erase(c.work.begin() + (choice - 1));
-    cout << "Assignment deleted.\n";
+// All shards added together, for one operation.
+struct MetricTotals {
+    uint64_t calls;
+    uint64_t timed;
+    uint64_t totalNs;
+    uint64_t maxNs;
+    vector<uint64_t> buckets;
+};
+
+void sumMetric(MetricOp op, MetricTotals& totals) {
+    totals.calls = 0;
+    totals.timed = 0;
+    totals.totalNs = 0;
+    totals.maxNs = 0;
+    totals.buckets.assign(METRIC_BUCKETS, 0);
+
+    MetricRegistry& registry = metricRegistry();
+    lock_guard<mutex> guard(registry.lock);
+    for (const MetricShard* shard : registry.shards) {
+        totals.calls += shard->calls[op].load(memory_order_relaxed);
+        totals.timed += shard->timed[op].load(memory_order_relaxed);
+        totals.totalNs += shard->totalNs[op].load(memory_order_relaxed);
+        uint64_t maxNs = shard->maxNs[op].load(memory_order_relaxed);
+        if (maxNs > totals.maxNs) {
+            totals.maxNs = maxNs;
+        }
+        for (size_t b = 0; b < METRIC_BUCKETS; ++b) {
+            totals.buckets[b] += shard->buckets[op][b].load(memory_order_relaxed);
+        }
+    }
 }
 
-// Delete a course completely.
-void deleteCourse(vector<Course>& courses) {
-    if (courses.empty()) {
-        cout << "No courses available.\n";
-        return;
+// Smallest bucket limit that at least "fraction" of the timed calls stay
+// under.
+uint64_t metricPercentile(const MetricTotals& totals, double fraction) {
+    uint64_t wanted = static_cast<uint64_t>(ceil(fraction * totals.timed));
+    uint64_t seen = 0;
+    for (size_t b = 0; b < METRIC_BUCKETS; ++b) {
+        seen += totals.buckets[b];
+        if (seen >= wanted && seen > 0) {
+            uint64_t limit = metricBucketLimit(b);
+            return limit < totals.maxNs ? limit : totals.maxNs;
+        }
     }
+    return totals.maxNs;
+}
 
-    listCoursesSummary(courses);
+double metricMean(const MetricTotals& totals) {
+    return totals.timed == 0 ? 0.0
+                             : static_cast<double>(totals.totalNs) / totals.timed;
+}
 
-    int id = readIntInRange(
-        "Enter the ID of the course to DELETE: ",
-        1, 1000000);
+} // namespace
 
-    int index = findCourseIndexById(courses, id);
-    if (index == -1) {
-        cout << "No course found with that ID.\n";
-        return;
+uint64_t metricClock() {
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Counts a call. Returns the start time if this call is to be timed,
+// otherwise 0.
+uint64_t startMetric(MetricOp op) {
+    MetricShard* shard = threadShard;
+    if (shard == nullptr) {
+        shard = newThreadShard();
+    }
+    bumpMetric(shard->calls[op], 1);
+    if (shard->untilSample[op] > 0) {
+        shard->untilSample[op]--;
+        return 0;
     }
+    shard->untilSample[op] = METRIC_SAMPLE_PERIOD[op] - 1;
+    return metricClock();
+}
 
-    const Course& c = courses[index];
+void recordMetric(MetricOp op, uint64_t nanoseconds) {
+    MetricShard* shard = threadShard;
+    bumpMetric(shard->timed[op], 1);
+    bumpMetric(shard->totalNs[op], nanoseconds);
+    if (nanoseconds > shard->maxNs[op].load(memory_order_relaxed)) {
+        shard->maxNs[op].store(nanoseconds, memory_order_relaxed);
+    }
+    bumpMetric(shard->buckets[op][metricBucket(nanoseconds)], 1);
+}
 
-    cout << "Are you sure you want to delete the entire course '"
-         << c.name << "' and all its assignments? (1 = Yes, 0 = No): ";
-    int confirm;
-    cin >> confirm;
-    if (cin.fail()) {
-        cin.clear();
+// One line per operation that was called at least once.
+void writeMetricsText(ostream& out) {
+    char line[160];
+    snprintf(line, sizeof(line), "%-18s %12s %10s %12s %10s %10s %10s %12s\n",
+             "operation", "calls", "timed", "mean_ns", "p50_ns", "p99_ns",
+             "p999_ns", "max_ns");
+    out << line;
+
+    MetricTotals totals;
+    for (int op = 0; op < METRIC_COUNT; ++op) {
+        sumMetric(static_cast<MetricOp>(op), totals);
+        if (totals.calls == 0) {
+            continue;
+        }
+        snprintf(line, sizeof(line),
+                 "%-18s %12llu %10llu %12.1f %10llu %10llu %10llu %12llu\n",
+                 METRIC_NAMES[op],
+                 static_cast<unsigned long long>(totals.calls),
+                 static_cast<unsigned long long>(totals.timed),
+                 metricMean(totals),
+                 static_cast<unsigned long long>(metricPercentile(totals, 0.50)),
+                 static_cast<unsigned long long>(metricPercentile(totals, 0.99)),
+                 static_cast<unsigned long long>(metricPercentile(totals, 0.999)),
+                 static_cast<unsigned long long>(totals.maxNs));
+        out << line;
     }
-    clearInputLine();
+}
 
-    if (confirm != 1) {
-        cout << "Course deletion cancelled.\n";
-        return;
+// The same as one line of JSON: {"metrics": [{"op": ..., ...}, ...]}.
+void appendMetricsJson(string& out) {
+    char item[320];
+    bool first = true;
+    out += "{\"metrics\": [";
+
+    MetricTotals totals;
+    for (int op = 0; op < METRIC_COUNT; ++op) {
+        sumMetric(static_cast<MetricOp>(op), totals);
+        if (totals.calls == 0) {
+            continue;
+        }
+        snprintf(item, sizeof(item),
+                 "%s{\"op\": \"%s\", \"calls\": %llu, \"timed\": %llu, "
+                 "\"mean_ns\": %.1f, \"p50_ns\": %llu, \"p90_ns\": %llu, "
+                 "\"p99_ns\": %llu, \"p999_ns\": %llu, \"max_ns\": %llu}",
+                 first ? "" : ", ", METRIC_NAMES[op],
+                 static_cast<unsigned long long>(totals.calls),
+                 static_cast<unsigned long long>(totals.timed),
+                 metricMean(totals),
+                 static_cast<unsigned long long>(metricPercentile(totals, 0.50)),
+                 static_cast<unsigned long long>(metricPercentile(totals, 0.90)),
+                 static_cast<unsigned long long>(metricPercentile(totals, 0.99)),
+                 static_cast<unsigned long long>(metricPercentile(totals, 0.999)),
+                 static_cast<unsigned long long>(totals.maxNs));
+        out += item;
+        first = false;
     }
+    out += "]}";
+}
 
-    courses.erase(courses.begin() + index);
-    cout << "Course deleted.\n";
+#else
+
+void writeMetricsText(ostream& out) {
+    out << "Metrics were left out of this build (GPA_NO_METRICS).\n";
+}
+
+void appendMetricsJson(string& out) {
+    out += "{\"metrics\": []}";
+}
+
+#endif
+
+// Handlers for atexit, used by "--metrics".
+void printMetricsTextAtExit() {
+    writeMetricsText(cerr);
+}
+
+void printMetricsJsonAtExit() {
+    string json;
+    appendMetricsJson(json);
+    cerr << json << "\n";
 }
 
 // ============================================================================
-// GRADE DISTRIBUTION REPORT
+// BENCHMARKS
 // ============================================================================
+// "--bench" builds seeded synthetic gradebooks at growing sizes and times
+// the core operations on them. Results are printed as JSON so they can be
+// saved and compared between builds. Options (all optional):
+//     --seed N                  random seed (default 42)
+//     --min-scale N             smallest size is 10^N courses (default 3)
+//     --max-scale N             largest size is 10^N courses (default 5)
+//     --courses-per-student N   courses per synthetic student (default 6)
+//     --assignments N           assignments per course (default 8)
+//     --name-length N           length of generated names (default 12)
+//     --threads N               threads for the cohort GPA (default: all)
+// Scales go from 1 to 7, courses per student up to 100, assignments up to
+// 1000 and names up to 1000 characters; anything else is refused. Sizes up
+// to 10^7 work but need several GB of memory.
+
+struct SyntheticConfig {
+    uint64_t seed;
+    size_t coursesPerStudent;
+    size_t assignmentsPerCourse;
+    size_t nameLength;
+};
 
-// Shows how many courses currently have A, B, C, D, or F.
-void showGradeDistribution(const vector<Course>& courses) {
-    if (courses.empty()) {
-        cout << "No courses available.\n";
-        return;
+// Random upper-case name of the configured length.
+static string syntheticName(mt19937_64& rng, size_t length) {
+    string name(length, 'A');
+    for (size_t i = 0; i < length; ++i) {
+        name[i] = static_cast<char>('A' + rng() % 26);
     }
+    return name;
+}
 
-    int countA = 0;
-    int countB = 0;
-    int countC = 0;
-    int countD = 0;
-    int countF = 0;
-
-    // We only consider courses that have at least one assignment.
-    for (const Course& c : courses) {
-        if (c.work.empty()) {
-            continue;
+// Fills "courses" with "count" random courses (ids 1..count).
+void generateSyntheticCourses(mt19937_64& rng, const SyntheticConfig& config,
+                              size_t count, CourseStore& courses) {
+    uniform_real_distribution<double> maxPoints(10.0, 200.0);
+    uniform_real_distribution<double> fraction(0.4, 1.0);
+    const double creditChoices[] = { 1.0, 3.0, 3.0, 4.0 };
+
+    courses.clear();
+    for (size_t i = 0; i < count; ++i) {
+        Course c;
+        c.id = static_cast<int>(i) + MIN_COURSE_ID;
+        c.name = syntheticName(rng, config.nameLength);
+        c.creditHours = creditChoices[rng() % 4];
+
+        for (size_t j = 0; j < config.assignmentsPerCourse; ++j) {
+            Assignment a;
+            a.name = syntheticName(rng, config.nameLength);
+            a.max = floor(maxPoints(rng));
+            a.earned = floor(a.max * fraction(rng));
+            addWorkToCourse(c, a);
         }
+        courses.insert(c);
+    }
+}
 
-        double percent = calculateCoursePercentage(c);
-        string letter = percentageToLetter(percent);
-
-        if (letter == "A") {
-            countA++;
-        } else if (letter == "B") {
-            countB++;
-        } else if (letter == "C") {
-            countC++;
-        } else if (letter == "D") {
-            countD++;
+// Builds a cohort with "totalCourses" courses spread over students.
+void generateSyntheticCohort(const SyntheticConfig& config, size_t totalCourses,
+                             vector<StudentRecord>& students) {
+    mt19937_64 rng(config.seed);
+    size_t perStudent = config.coursesPerStudent == 0 ? 1
+                                                      : config.coursesPerStudent;
+    size_t studentCount = (totalCourses + perStudent - 1) / perStudent;
+
+    students.assign(studentCount, StudentRecord());
+    size_t left = totalCourses;
+    for (size_t i = 0; i < studentCount; ++i) {
+        size_t count = left < perStudent ? left : perStudent;
+        students[i].id = "S" + to_string(i);
+        generateSyntheticCourses(rng, config, count, students[i].courses);
+        left -= count;
+    }
+}
+
+// Nanoseconds since an arbitrary start, for timing.
+static long long benchNow() {
+    return chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Appends one result object to the JSON results array.
+static void appendBenchResult(string& json, bool& first, const char* op,
+                              size_t scale, size_t operations,
+                              long long elapsedNs, double checksum) {
+    char line[256];
+    snprintf(line, sizeof(line),
+             "%s\n    {\"op\": \"%s\", \"scale\": %zu, \"ops\": %zu, "
+             "\"total_ns\": %lld, \"ns_per_op\": %.2f, \"checksum\": %.6f}",
+             first ? "" : ",", op, scale, operations, elapsedNs,
+             operations == 0 ? 0.0
+                             : static_cast<double>(elapsedNs) / operations,
+             checksum);
+    json += line;
+    first = false;
+}
+
+// Reads the whole number given for a benchmark option, which must lie
+// within low..high. Complains and returns false otherwise.
+static bool parseBenchOption(const char* option, const char* value,
+                             unsigned long long low, unsigned long long high,
+                             unsigned long long& result) {
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long requested = strtoull(value, &end, 10);
+    if (end == value || *end != '\0' || value[0] == '-' || errno == ERANGE ||
+        requested < low || requested > high) {
+        cerr << option << " needs a whole number between " << low << " and "
+             << high << ".\n";
+        return false;
+    }
+    result = requested;
+    return true;
+}
+
+// Runs every benchmark at every scale and prints the JSON report.
+int runBenchmarks(int argc, char* argv[]) {
+    SyntheticConfig config;
+    config.seed = 42;
+    config.coursesPerStudent = 6;
+    config.assignmentsPerCourse = 8;
+    config.nameLength = 12;
+    int minScale = 3;
+    int maxScale = 5;
+    unsigned threads = defaultThreadCount();
+
+    for (int i = 2; i < argc; i += 2) {
+        if (i + 1 >= argc) {
+            cerr << "Benchmark option " << argv[i] << " needs a value.\n";
+            return 1;
+        }
+        const char* option = argv[i];
+        const char* text = argv[i + 1];
+        unsigned long long value = 0;
+        if (strcmp(option, "--seed") == 0) {
+            if (!parseBenchOption(option, text, 0, UINT64_MAX, value)) {
+                return 1;
+            }
+            config.seed = static_cast<uint64_t>(value);
+        } else if (strcmp(option, "--min-scale") == 0) {
+            if (!parseBenchOption(option, text, 1, 7, value)) {
+                return 1;
+            }
+            minScale = static_cast<int>(value);
+        } else if (strcmp(option, "--max-scale") == 0) {
+            if (!parseBenchOption(option, text, 1, 7, value)) {
+                return 1;
+            }
+            maxScale = static_cast<int>(value);
+        } else if (strcmp(option, "--courses-per-student") == 0) {
+            if (!parseBenchOption(option, text, 1, 100, value)) {
+                return 1;
+            }
+            config.coursesPerStudent = static_cast<size_t>(value);
+        } else if (strcmp(option, "--assignments") == 0) {
+            if (!parseBenchOption(option, text, 1, 1000, value)) {
+                return 1;
+            }
+            config.assignmentsPerCourse = static_cast<size_t>(value);
+        } else if (strcmp(option, "--name-length") == 0) {
+            if (!parseBenchOption(option, text, 0, 1000, value)) {
+                return 1;
+            }
+            config.nameLength = static_cast<size_t>(value);
+        } else if (strcmp(option, "--threads") == 0) {
+            if (!parseThreadCount(argv[i + 1], threads)) {
+                return 1;
+            }
         } else {
-            countF++;
+            cerr << "Unknown benchmark option: " << argv[i] << "\n";
+            return 1;
         }
     }
+    if (minScale > maxScale) {
+        cerr << "--min-scale must not be above --max-scale.\n";
+        return 1;
+    }
+
+    string json;
+    char line[512];
+    snprintf(line, sizeof(line),
+             "{\n  \"benchmark\": \"gpa_calculator\",\n  \"seed\": %llu,\n"
+             "  \"threads\": %u,\n  \"courses_per_student\": %zu,\n"
+             "  \"assignments_per_course\": %zu,\n  \"name_length\": %zu,\n"
+             "  \"fixed_point\": %s,\n  \"results\": [",
+             static_cast<unsigned long long>(config.seed), threads,
+             config.coursesPerStudent, config.assignmentsPerCourse,
+             config.nameLength, fixedPointMode() ? "true" : "false");
+    json += line;
+    bool first = true;
+
+    size_t scale = 1;
+    for (int e = 0; e < minScale; ++e) {
+        scale *= 10;
+    }
 
-    int totalGradedCourses = countA + countB + countC + countD + countF;
+    for (int e = minScale; e <= maxScale; ++e, scale *= 10) {
+        vector<StudentRecord> students;
+        generateSyntheticCohort(config, scale, students);
+
+        // calculateCoursePercentage over every course.
+        double checksum = 0.0;
+        long long start = benchNow();
+        for (const StudentRecord& s : students) {
+            for (const Course& c : s.courses) {
+                checksum += calculateCoursePercentage(c);
+            }
+        }
+        appendBenchResult(json, first, "course_percentage", scale, scale,
+                          benchNow() - start, checksum);
+
+        // calculateOverallGPA for every student, one thread.
+        checksum = 0.0;
+        start = benchNow();
+        for (const StudentRecord& s : students) {
+            checksum += calculateOverallGPA(s.courses);
+        }
+        appendBenchResult(json, first, "overall_gpa", scale, students.size(),
+                          benchNow() - start, checksum);
+
+        // The same through the parallel cohort API.
+        vector<double> gpas;
+        start = benchNow();
+        calculateCohortGPAs(students, threads, gpas);
+        long long elapsed = benchNow() - start;
+        checksum = 0.0;
+        for (double g : gpas) {
+            checksum += g;
+        }
+        appendBenchResult(json, first, "cohort_gpa", scale, students.size(),
+                          elapsed, checksum);
+
+        // GpaRankIndex: every student's GPA changes once (as after an
+        // edit), then every student's rank is looked up.
+        GpaRankIndex ranks;
+        ranks.reset(gpas.size());
+        for (size_t i = 0; i < gpas.size(); ++i) {
+            ranks.set(i, gpas[i]);
+        }
+        start = benchNow();
+        for (size_t i = 0; i < gpas.size(); ++i) {
+            ranks.set(i, gpas[(i * 7919) % gpas.size()]);
+        }
+        appendBenchResult(json, first, "rank_update", scale, gpas.size(),
+                          benchNow() - start, static_cast<double>(ranks.size()));
 
-    if (totalGradedCourses == 0) {
-        cout << "No graded courses yet. Add assignments first.\n";
-        return;
+        checksum = 0.0;
+        start = benchNow();
+        for (size_t i = 0; i < gpas.size(); ++i) {
+            checksum += static_cast<double>(ranks.rankOf(i));
+        }
+        appendBenchResult(json, first, "rank_query", scale, gpas.size(),
+                          benchNow() - start, checksum);
+
+        // whatIfScenario's evaluation: one hypothetical per student.
+        checksum = 0.0;
+        start = benchNow();
+        for (const StudentRecord& s : students) {
+            WhatIfOverlay overlay(s.courses);
+            overlay.addHypothetical(s.courses.handleOf(MIN_COURSE_ID), 0,
+                                    85.0, 100.0);
+            checksum += overlay.overallGPA();
+        }
+        appendBenchResult(json, first, "whatif_eval", scale, students.size(),
+                          benchNow() - start, checksum);
+
+        // forecastGrades: "scale" simulated terms for the first student,
+        // with two pending assignments in each of their courses.
+        {
+            const CourseStore& courses = students[0].courses;
+            vector<PendingWork> pending;
+            for (const Course& c : courses) {
+                PendingWork work;
+                work.course = courses.handleOf(c.id);
+                work.category = 0;
+                int samples = 0;
+                fitPendingScores(courses, work.course, 0, work.mean,
+                                 work.spread, samples);
+                pending.push_back(work);
+                pending.push_back(work);
+            }
+            ForecastResult result;
+            start = benchNow();
+            forecastGrades(courses, pending, scale, threads, config.seed,
+                           result);
+            appendBenchResult(json, first, "forecast", scale, scale,
+                              benchNow() - start, result.meanGpa);
+        }
+
+        // showGradeDistribution's counting for every student.
+        checksum = 0.0;
+        start = benchNow();
+        for (const StudentRecord& s : students) {
+            GradeCounts counts = countGradeDistribution(s.courses);
+            checksum += counts.total + counts.counts[GRADE_A];
+        }
+        appendBenchResult(json, first, "grade_distribution", scale,
+                          students.size(), benchNow() - start, checksum);
+
+        // The same over the whole cohort, per term, on all threads. The
+        // synthetic courses get one of four terms first (not timed).
+        const char* const terms[] = {
+            "Fall 2024", "Spring 2025", "Summer 2025", "Fall 2025"
+        };
+        for (size_t i = 0; i < students.size(); ++i) {
+            PooledName term(terms[i % 4]);
+            for (Course& c : students[i].courses) {
+                c.term = term;
+            }
+        }
+        checksum = 0.0;
+        start = benchNow();
+        {
+            CohortDistribution distribution(GROUP_BY_TERM, 1.0, threads);
+            distribution.addStudents(students, students.size(), false);
+            vector<GroupDistribution> groups;
+            distribution.finish(groups);
+            for (const GroupDistribution& g : groups) {
+                checksum += g.courses + g.grades[GRADE_A] + g.bins[90];
+            }
+        }
+        appendBenchResult(json, first, "cohort_distribution", scale, scale,
+                          benchNow() - start, checksum);
+
+        // findCourseIndexById and deleteCourse on one big store. A store
+        // holds at most MAX_COURSE_ID courses, so larger scales are capped.
+        size_t storeSize = scale < static_cast<size_t>(MAX_COURSE_ID)
+                               ? scale : static_cast<size_t>(MAX_COURSE_ID);
+        students.clear();
+        students.shrink_to_fit();
+
+        mt19937_64 rng(config.seed + static_cast<uint64_t>(e));
+        CourseStore store;
+        generateSyntheticCourses(rng, config, storeSize, store);
+
+        vector<int> ids(storeSize);
+        for (size_t i = 0; i < storeSize; ++i) {
+            ids[i] = static_cast<int>(i) + MIN_COURSE_ID;
+        }
+        shuffle(ids.begin(), ids.end(), rng);
+
+        checksum = 0.0;
+        start = benchNow();
+        for (int id : ids) {
+            checksum += findCourseIndexById(store, id);
+        }
+        appendBenchResult(json, first, "find_course", storeSize, storeSize,
+                          benchNow() - start, checksum);
+
+        // Grade counts and the at-risk list from a Gradebook's GradeIndex,
+        // which applyMutation keeps up to date (building it is not timed).
+        Gradebook book;
+        book.courses = store;
+        book.grades.rebuild(book.courses);
+        book.nextCourseId = static_cast<int>(storeSize) + MIN_COURSE_ID;
+        checksum = 0.0;
+        start = benchNow();
+        for (size_t i = 0; i < storeSize; ++i) {
+            GradeCounts counts = book.grades.counts();
+            checksum += counts.total + counts.counts[GRADE_A];
+        }
+        appendBenchResult(json, first, "grade_index_counts", storeSize,
+                          storeSize, benchNow() - start, checksum);
+
+        vector<int> atRisk;
+        start = benchNow();
+        coursesWithGrade(book, GRADE_C, true, atRisk);
+        appendBenchResult(json, first, "grade_index_below_c", storeSize, 1,
+                          benchNow() - start,
+                          static_cast<double>(atRisk.size()));
+
+        string error;
+        checksum = 0.0;
+        start = benchNow();
+        for (int id : ids) {
+            checksum += applyMutation(book, makeDeleteCourse(id), error) ? 1 : 0;
+        }
+        appendBenchResult(json, first, "delete_course", storeSize, storeSize,
+                          benchNow() - start, checksum);
     }
 
-    cout << "==========================================\n";
-    cout << "         GRADE DISTRIBUTION REPORT\n";
-    cout << "==========================================\n";
-    cout << "Total graded courses: " << totalGradedCourses << "\n";
-    cout << "A: " << countA << "\n";
-    cout << "B: " << countB << "\n";
-    cout << "C: " << countC << "\n";
-    cout << "D: " << countD << "\n";
-    cout << "F: " << countF << "\n";
-    cout << "==========================================\n";
+    json += "\n  ]\n}\n";
+    cout << json;
+    return 0;
 }